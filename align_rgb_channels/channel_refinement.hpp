@@ -0,0 +1,204 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+// Channels aligned onto green and cropped to the area all three cover with image content
+struct RefinedChannels {
+    // Crop in green coordinates
+    cv::Rect interior;
+    // Channel to green transforms after refinement, identity for green
+    std::array<cv::Matx33d, 3> transforms{ cv::Matx33d::eye(), cv::Matx33d::eye(), cv::Matx33d::eye() };
+    // ECC correlation with green over the interior, before and after refinement
+    std::array<double, 3> ecc_before{ 1.0, 1.0, 1.0 };
+    std::array<double, 3> ecc_after{ 1.0, 1.0, 1.0 };
+    // Cropped BGR result
+    cv::Mat merged;
+};
+
+// Second stage after a coarse channel alignment. The interior is the largest axis-aligned rectangle inside
+// all three warp footprints, shrunk further where row / column means of any warped channel stand out from
+// the center (black frame and bright film edge of the plate). Blue and red are then refined against green
+// with ECC over a pyramid of the interior only, so neither warp borders nor plate borders enter the fit.
+class ChannelRefiner {
+public:
+    explicit ChannelRefiner(int min_size = 64,
+        int iterations = 30,
+        double epsilon = 1e-4,
+        double max_border = 0.12
+    ) :
+        min_size_(min_size),
+        iterations_(iterations),
+        epsilon_(epsilon),
+        max_border_(max_border) {}
+
+    // `channels` are blue, green, red, `transforms` map each of them onto green
+    RefinedChannels refine(const std::array<cv::Mat, 3>& channels, const std::array<cv::Matx33d, 3>& transforms) const {
+        const cv::Size size{ channels[1].size() };
+        RefinedChannels result;
+        result.transforms = transforms;
+
+        std::array<cv::Mat, 3> warped;
+        cv::Mat footprint(size, CV_8UC1, cv::Scalar::all(255));
+        for (int k : { 0, 2 }) {
+            cv::warpPerspective(channels[k], warped[k], cv::Mat(transforms[k]), size);
+            cv::Mat covered;
+            cv::warpPerspective(cv::Mat(channels[k].size(), CV_8UC1, cv::Scalar::all(255)), covered,
+                cv::Mat(transforms[k]), size, cv::INTER_NEAREST);
+            footprint &= covered;
+        }
+        warped[1] = channels[1];
+        // Interpolation next to the footprint edge still mixes in the black border
+        cv::erode(footprint, footprint, cv::Mat{}, cv::Point(-1, -1), 2);
+
+        cv::Rect covered{ inscribedRect(footprint) };
+        if (covered.width < min_size_ or covered.height < min_size_) {
+            covered = cv::Rect{ 0, 0, size.width, size.height };
+        }
+        result.interior = trimBorders(warped, covered);
+        if (result.interior.width < min_size_ or result.interior.height < min_size_) {
+            result.interior = covered;
+        }
+
+        cv::Mat green;
+        channels[1](result.interior).convertTo(green, CV_32F);
+        std::array<cv::Mat, 3> aligned{ cv::Mat{}, channels[1](result.interior).clone(), cv::Mat{} };
+        for (int k : { 0, 2 }) {
+            cv::Mat channel;
+            channels[k].convertTo(channel, CV_32F);
+            // ECC warps map template (interior) pixels onto the input channel
+            const cv::Matx33d initial{ transforms[k].inv() * translate(result.interior.x, result.interior.y) };
+            result.ecc_before[k] = correlation(green, channel, initial);
+            const cv::Matx33d refined{ refineEcc(green, channel, initial) };
+            result.ecc_after[k] = correlation(green, channel, refined);
+            // Keep the coarse alignment if the refinement didn't help
+            const cv::Matx33d warp{ result.ecc_after[k] >= result.ecc_before[k] ? refined : initial };
+            result.ecc_after[k] = std::max(result.ecc_after[k], result.ecc_before[k]);
+            result.transforms[k] = translate(result.interior.x, result.interior.y) * warp.inv();
+            cv::warpPerspective(channels[k], aligned[k], cv::Mat(warp), result.interior.size(),
+                cv::INTER_LINEAR | cv::WARP_INVERSE_MAP);
+        }
+        cv::merge(aligned.data(), aligned.size(), result.merged);
+        return result;
+    }
+
+private:
+    // Configuration variables
+    int min_size_{};
+    int iterations_{};
+    double epsilon_{};
+    double max_border_{};
+
+    static cv::Matx33d translate(double dx, double dy) {
+        return { 1, 0, dx, 0, 1, dy, 0, 0, 1 };
+    }
+
+    // Starts from the bounding box and moves in the edge with the largest share of uncovered pixels
+    static cv::Rect inscribedRect(const cv::Mat& mask) {
+        cv::Rect r{ cv::boundingRect(mask) };
+        while (r.width > 1 and r.height > 1) {
+            const std::array<double, 4> invalid{
+                1.0 - cv::countNonZero(mask(cv::Rect(r.x, r.y, r.width, 1))) / static_cast<double>(r.width),
+                1.0 - cv::countNonZero(mask(cv::Rect(r.x, r.br().y - 1, r.width, 1))) / static_cast<double>(r.width),
+                1.0 - cv::countNonZero(mask(cv::Rect(r.x, r.y, 1, r.height))) / static_cast<double>(r.height),
+                1.0 - cv::countNonZero(mask(cv::Rect(r.br().x - 1, r.y, 1, r.height))) / static_cast<double>(r.height) };
+            const auto worst{ std::ranges::max_element(invalid) };
+            if (*worst == 0.0) {
+                break;
+            }
+            switch (worst - invalid.begin()) {
+            case 0: ++r.y; --r.height; break;
+            case 1: --r.height; break;
+            case 2: ++r.x; --r.width; break;
+            default: --r.width; break;
+            }
+        }
+        return r;
+    }
+
+    // Moves every side of `r` inward past rows / columns whose mean is an outlier against the central half
+    cv::Rect trimBorders(const std::array<cv::Mat, 3>& warped, cv::Rect r) const {
+        int top{ 0 }, bottom{ 0 }, left{ 0 }, right{ 0 };
+        for (const auto& channel : warped) {
+            cv::Mat rows, cols;
+            cv::reduce(channel(r), rows, 1, cv::REDUCE_AVG, CV_64F);
+            cv::reduce(channel(r), cols, 0, cv::REDUCE_AVG, CV_64F);
+            const auto row_means{ rows.reshape(1, 1) };
+            top = std::max(top, borderWidth(row_means, false));
+            bottom = std::max(bottom, borderWidth(row_means, true));
+            left = std::max(left, borderWidth(cols, false));
+            right = std::max(right, borderWidth(cols, true));
+        }
+        return { r.x + left, r.y + top, std::max(0, r.width - left - right), std::max(0, r.height - top - bottom) };
+    }
+
+    // Leading (or trailing) entries of a 1 x n profile more than 3 sigma away from the central half
+    int borderWidth(const cv::Mat& profile, bool from_end) const {
+        const int n{ profile.cols };
+        const cv::Mat center{ profile(cv::Rect(n / 4, 0, std::max(1, n / 2), 1)) };
+        cv::Scalar mean, stddev;
+        cv::meanStdDev(center, mean, stddev);
+        // Flat centers would make any texture an outlier
+        const double tolerance{ std::max(3.0 * stddev[0], 8.0) };
+        const int limit{ static_cast<int>(max_border_ * n) };
+        int width{ 0 };
+        while (width < limit) {
+            const double v{ profile.at<double>(0, from_end ? n - 1 - width : width) };
+            if (std::abs(v - mean[0]) <= tolerance) {
+                break;
+            }
+            ++width;
+        }
+        return width;
+    }
+
+    static double correlation(const cv::Mat& templ, const cv::Mat& input, const cv::Matx33d& warp) {
+        cv::Mat warped;
+        cv::warpPerspective(input, warped, cv::Mat(warp), templ.size(), cv::INTER_LINEAR | cv::WARP_INVERSE_MAP);
+        return cv::computeECC(templ, warped);
+    }
+
+    // Coarse to fine: levels halve until the interior is about `min_size`, every level starts from the
+    // previous estimate, so the fine levels only need a few iterations
+    cv::Matx33d refineEcc(const cv::Mat& templ, const cv::Mat& input, const cv::Matx33d& initial) const {
+        std::vector<cv::Mat> templ_pyramid{ templ }, input_pyramid{ input };
+        while (std::min(templ_pyramid.back().cols, templ_pyramid.back().rows) >= 2 * min_size_) {
+            cv::Mat t, i;
+            cv::pyrDown(templ_pyramid.back(), t);
+            cv::pyrDown(input_pyramid.back(), i);
+            templ_pyramid.push_back(t);
+            input_pyramid.push_back(i);
+        }
+
+        const cv::TermCriteria criteria{ cv::TermCriteria::COUNT + cv::TermCriteria::EPS, iterations_, epsilon_ };
+        const double coarsest{ std::pow(2.0, static_cast<double>(templ_pyramid.size() - 1)) };
+        const cv::Matx33d to_coarsest{ 1.0 / coarsest, 0, 0, 0, 1.0 / coarsest, 0, 0, 0, 1 };
+        cv::Matx33d warp{ to_coarsest * initial * to_coarsest.inv() };
+        const cv::Matx33d up{ 2, 0, 0, 0, 2, 0, 0, 0, 1 };
+        for (int level{ static_cast<int>(templ_pyramid.size()) - 1 }; level >= 0; --level) {
+            cv::Mat estimate;
+            cv::Mat(warp).convertTo(estimate, CV_32F);
+            try {
+                cv::findTransformECC(templ_pyramid[level], input_pyramid[level], estimate, cv::MOTION_HOMOGRAPHY,
+                    criteria, cv::noArray(), 5);
+                estimate.convertTo(estimate, CV_64F);
+                warp = cv::Matx33d(reinterpret_cast<const double*>(estimate.data));
+            }
+            catch (const cv::Exception&) {
+                // No convergence on this level, carry the previous estimate down
+            }
+            if (level > 0) {
+                warp = up * warp * up.inv();
+            }
+        }
+        return warp;
+    }
+};
@@ -0,0 +1,207 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <array>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#include "feature_pipeline.hpp"
+#include "robust_homography.hpp"
+#include "stage_timer.hpp"
+#include "warp_perspective.hpp"
+
+// Blue, green and red exposures stacked top to bottom, the last one takes the leftover rows
+inline std::array<cv::Mat, 3> splitPlate(const cv::Mat& img) {
+    const int channel_height{ img.rows / 3 };
+    const int last_channel_height{ img.rows - 2 * channel_height };
+    return { img(cv::Rect(0, 0, img.cols, channel_height)),
+        img(cv::Rect(0, channel_height, img.cols, channel_height)),
+        img(cv::Rect(0, 2 * channel_height, img.cols, last_channel_height)) };
+}
+
+// SIFT on every channel, one KD-tree over green searched by blue and red, Lowe's ratio test, robust homography
+using ChannelPipeline = playground::FeaturePipeline<playground::SiftDetector, playground::KdTreeMatcher,
+    playground::LoweRatio, playground::RobustHomography>;
+
+class FeatureMatching {
+public:
+    FeatureMatching(
+        const std::filesystem::path& src_path,
+        int max_features = 1000,
+        int min_mach_count = 10,
+        int trees_number = 5,
+        int number_of_checks = 5,
+        float lowe_ratio = 0.95f,
+        float ransac_threshold = 5.0f,
+        bool tiled_warp = false,
+        playground::RobustEstimator estimator = playground::RobustEstimator::Ransac,
+        bool tiled_features = true,
+        bool concurrent = true
+    ) :
+        tiled_warp_(tiled_warp),
+        concurrent_(concurrent),
+        pipeline_(playground::SiftDetector{ max_features, tiled_features },
+            playground::KdTreeMatcher{ trees_number, number_of_checks },
+            playground::LoweRatio{ lowe_ratio },
+            playground::RobustHomography{ estimator, ransac_threshold },
+            min_mach_count) {
+        cv::Mat img{ cv::imread(src_path.string(), cv::IMREAD_GRAYSCALE) };
+
+        splitImage(img);
+
+        process();
+    }
+
+    cv::Mat drawMatches(bool use_mask = true,
+        const cv::DrawMatchesFlags& flag = cv::DrawMatchesFlags::NOT_DRAW_SINGLE_POINTS) {
+        cv::Mat output;
+        cv::Mat mask{};
+
+        if (use_mask) {
+            mask = blue_match_.inlier_mask;
+        }
+        cv::drawMatches(
+            blue_,
+            blue_match_.keypoints,
+            green_,
+            pipeline_.trainKeypoints(),
+            blue_match_.matches,
+            output,
+            cv::Scalar::all(-1),
+            cv::Scalar::all(-1),
+            mask,
+            flag
+        );
+
+        return output;
+    }
+
+    cv::Mat warpPerspective() {
+        cv::Mat out;
+        warp(blue_, out, blue_match_.homography);
+        return out;
+    }
+
+    const auto& getHomographyStatsBg() const { return blue_match_.stats; }
+    const auto& getHomographyStatsRg() const { return red_match_.stats; }
+    const auto& getTimer() const { return timer_; }
+    const auto& getHomographyBg() const { return blue_match_.homography; }
+    const auto& getHomographyRg() const { return red_match_.homography; }
+
+    cv::Mat warpedImages() {
+        std::vector<cv::Mat> v{ blue_warped_, green_, red_warped_ };
+        cv::Mat out;
+        cv::merge(v, out);
+        return out;
+    }
+private:
+    // Matrices for images
+    cv::Mat blue_;
+    cv::Mat red_;
+    cv::Mat green_;
+
+    cv::Mat blue_warped_;
+    cv::Mat red_warped_;
+
+    std::vector<cv::Mat> channels_{ 3 };
+
+    // Configuration variables
+    bool tiled_warp_{};
+    bool concurrent_{};
+
+    // Green is the train side, blue and red are matched against it
+    ChannelPipeline pipeline_;
+    playground::FeatureMatch blue_match_;
+    playground::FeatureMatch red_match_;
+
+    // Per-stage latency
+    playground::StageTimer timer_;
+
+    void process() {
+        {
+            auto t{ timer_.measure("features") };
+            findKeyPointsAndDescriptors();
+        }
+        {
+            auto t{ timer_.measure("matching") };
+            matchFeatures();
+        }
+        {
+            auto t{ timer_.measure("homography") };
+            findHomography();
+        }
+        if (blue_match_.homography.empty() or red_match_.homography.empty()) {
+            return;
+        }
+        auto t{ timer_.measure("warp") };
+        warpPerspectives();
+    }
+
+    void splitImage(const cv::Mat& img) {
+        const auto channels{ splitPlate(img) };
+        blue_ = channels_[0] = channels[0];
+        green_ = channels_[1] = channels[1];
+        red_ = channels_[2] = channels[2];
+    }
+
+    void findKeyPointsAndDescriptors() {
+        std::vector<cv::KeyPoint> green_kp;
+        cv::Mat green_descriptors;
+        if (!concurrent_) {
+            pipeline_.detect(blue_, blue_match_.keypoints, blue_match_.descriptors);
+            pipeline_.detect(green_, green_kp, green_descriptors);
+            pipeline_.detect(red_, red_match_.keypoints, red_match_.descriptors);
+        }
+        else {
+            // Blue and red on their own threads, green on this one. Tiles of each channel still go to the
+            // OpenCV pool, which runs a busy pool's nested work on the calling thread.
+            std::jthread blue{ [this] { pipeline_.detect(blue_, blue_match_.keypoints, blue_match_.descriptors); } };
+            std::jthread red{ [this] { pipeline_.detect(red_, red_match_.keypoints, red_match_.descriptors); } };
+            pipeline_.detect(green_, green_kp, green_descriptors);
+        }
+        // Builds the KD-tree over green once, for both pairs
+        pipeline_.setTrain(std::move(green_kp), std::move(green_descriptors));
+    }
+
+    void matchFeatures() {
+        if (!concurrent_) {
+            pipeline_.match(blue_match_);
+            pipeline_.match(red_match_);
+            return;
+        }
+        // Searches only read the tree, every call keeps its own result set
+        std::jthread blue{ [this] { pipeline_.match(blue_match_); } };
+        pipeline_.match(red_match_);
+    }
+
+    void findHomography() {
+        // Good matches are sorted by distance, which is the order PROSAC expects
+        if (!concurrent_) {
+            pipeline_.estimate(blue_match_);
+            pipeline_.estimate(red_match_);
+            return;
+        }
+        // The pairs share nothing, every fit writes its own homography, mask and stats
+        std::jthread blue{ [this] { pipeline_.estimate(blue_match_); } };
+        pipeline_.estimate(red_match_);
+    }
+
+    void warp(const cv::Mat& src, cv::Mat& dst, const cv::Mat& homography) {
+        if (tiled_warp_) {
+            playground::warpPerspective(src, dst, homography, green_.size());
+            return;
+        }
+        cv::warpPerspective(src, dst, homography, green_.size());
+    }
+
+    void warpPerspectives() {
+        warp(blue_, blue_warped_, blue_match_.homography);
+        warp(red_, red_warped_, red_match_.homography);
+    }
+};
@@ -7,224 +7,147 @@
 #include <opencv2/opencv.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/photo.hpp>
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <filesystem>
 #include <print>
 #include <ranges>
+#include <string>
+#include <thread>
+
+#include "channel_refinement.hpp"
+#include "feature_matching.hpp"
+#include "phase_alignment.hpp"
+#include "robust_homography.hpp"
+#include "stage_timer.hpp"
+#include "tiled_plate.hpp"
+#include "warp_perspective.hpp"
+
+// Aligns blue and red onto green with pyramid phase correlation. Returns false when either channel
+// correlates below `min_response`.
+bool alignWithPhaseCorrelation(const cv::Mat& img, const PhaseCorrelationAligner& aligner,
+    std::array<cv::Matx33d, 3>& transforms, double min_response = 0.05) {
+    const auto [blue, green, red] = splitPlate(img);
+    const auto blue_to_green{ aligner.align(blue, green) };
+    const auto red_to_green{ aligner.align(red, green) };
+    std::println("Phase correlation response: blue {:.3f}, red {:.3f}", blue_to_green.response, red_to_green.response);
+    transforms = { blue_to_green.transform, cv::Matx33d::eye(), red_to_green.transform };
+    return blue_to_green.response >= min_response and red_to_green.response >= min_response;
+}
+
+// Crops to the common interior, refines blue and red with pyramid ECC and shows the result
+void showRefined(const cv::Mat& img, const std::array<cv::Matx33d, 3>& transforms) {
+    auto start{ std::chrono::steady_clock::now() };
+    const auto refined{ ChannelRefiner{}.refine(splitPlate(img), transforms) };
+    std::println("Crop + ECC refinement: {:.2f} ms, interior {}x{} at ({}, {})",
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+        refined.interior.width, refined.interior.height, refined.interior.x, refined.interior.y);
+    std::println("ECC over the interior: blue {:.4f} -> {:.4f}, red {:.4f} -> {:.4f}",
+        refined.ecc_before[0], refined.ecc_after[0], refined.ecc_before[2], refined.ecc_after[2]);
+
+    cv::imshow("Warped", refined.merged);
+    cv::waitKey(0);
+    cv::destroyAllWindows();
+}
 
-class FeatureMatching {
-public:
-    FeatureMatching(
-        const std::filesystem::path& src_path,
-        int max_features = 1000,
-        int min_mach_count = 10,
-        int trees_number = 5,
-        int number_of_checks = 5,
-        float lowe_ratio = 0.95f,
-        float ransac_threshold = 5.0f
-    ) :
-        max_features_(max_features),
-        min_match_count_(min_mach_count),
-        trees_number_(trees_number),
-        number_of_checks_(number_of_checks),
-        lowe_ratio_(lowe_ratio),
-        ransac_threshold_(ransac_threshold) {
-        cv::Mat img{ cv::imread(src_path.string(), cv::IMREAD_GRAYSCALE) };
-
-        splitImage(img);
-
-        process();
+int main(int argc, char** argv) {
+    std::filesystem::path path1{ "../data/images/emir.png" };
+    if (!std::filesystem::exists(path1)) {
+        std::cerr << std::format("Can't find file at given location: {}", path1.string());
+        return EXIT_FAILURE;
     }
 
-    cv::Mat drawMatches(bool use_mask = true,
-        const cv::DrawMatchesFlags& flag = cv::DrawMatchesFlags::NOT_DRAW_SINGLE_POINTS) {
-        cv::Mat output;
-        cv::Mat mask{};
+    const std::string usage{ std::format("Usage: align_rgb_channels [phase | logpolar | latency [runs] | {} | "
+        "plate <scan> [output.ppm] [budget MB]]\n"
+        "  plate streams a 16-bit P5 PGM scan, TIFF / PNG scans are decoded whole by PlateSource and count against the budget\n",
+        playground::robustEstimatorNames()) };
 
-        if (use_mask) {
-            mask = mask_;
+    // "plate <scan> [output.ppm] [budget MB]": high-resolution 16-bit scan, aligned on a proxy and merged tile by tile
+    if (argc > 1 and std::string_view{ argv[1] } == "plate") {
+        if (argc < 3) {
+            std::cerr << "plate needs the path of the scan\n" << usage;
+            return EXIT_FAILURE;
         }
-        cv::drawMatches(
-            blue_,
-            kp1_,
-            green_,
-            kp2_,
-            good_matches_bg_,
-            output,
-            cv::Scalar::all(-1),
-            cv::Scalar::all(-1),
-            mask,
-            flag
-        );
-
-        return output;
-    }
-
-    cv::Mat warpPerspective() {
-        cv::Mat out;
-        cv::warpPerspective(blue_, out, homography_bg_, green_.size());
-        return out;
-    }
-
-    cv::Mat warpedImages() {
-        std::vector<cv::Mat> v{ blue_warped_, green_, red_warped_ };
-        cv::Mat out;
-        cv::merge(v, out);
-        return out;
-    }
-private:
-    // Matrices for images
-    cv::Mat blue_;
-    cv::Mat red_;
-    cv::Mat green_;
-
-    cv::Mat blue_warped_;
-    cv::Mat red_warped_;
-
-    std::vector<cv::Mat> channels_{ 3 };
-
-    // Matrices for descriptors
-    cv::Mat descriptors1_;
-    cv::Mat descriptors2_;
-    cv::Mat descriptors3_;
-
-    // Vectors for keypoints
-    std::vector<cv::KeyPoint> kp1_;
-    std::vector<cv::KeyPoint> kp2_;
-    std::vector<cv::KeyPoint> kp3_;
-
-    // Matrices for homography and mask
-    cv::Mat homography_bg_;
-    cv::Mat homography_rg_;
-    cv::Mat mask_;
-
-    // Vectors for homography
-    std::vector<cv::Point2f> src_bg_pts_;
-    std::vector<cv::Point2f> dst_bg_pts_;
-
-    std::vector<cv::Point2f> src_rg_pts_;
-    std::vector<cv::Point2f> dst_rg_pts_;
-
-    // Vectors for matches and for good matches
-    std::vector<std::vector<cv::DMatch>> matches_bg_;
-    std::vector<cv::DMatch> good_matches_bg_;
-
-    std::vector<std::vector<cv::DMatch>> matches_rg_;
-    std::vector<cv::DMatch> good_matches_rg_;
-
-    // Configuration variables
-    int max_features_{};
-    int min_match_count_{};
-    int trees_number_{};
-    int number_of_checks_{};
-    float lowe_ratio_{};
-    float ransac_threshold_{};
-
-    void process() {
-        findKeyPointsAndDescriptors();
-        matchFeatures();
-        findGoodMatches();
-        auto check{ fillSrcDst() };
-        if (!check) {
-            return;
+        const std::filesystem::path output{ argc > 3 ? argv[3] : "aligned.ppm" };
+        size_t budget_mb{ 256 };
+        if (argc > 4) {
+            try {
+                budget_mb = std::stoul(argv[4]);
+            }
+            catch (std::exception&) {
+                std::cerr << std::format("Invalid budget: {}\n", argv[4]) << usage;
+                return EXIT_FAILURE;
+            }
         }
-        findHomography();
-        warpPerspectives();
-    }
-
-    void splitImage(const cv::Mat& img) {
-        int width = img.cols;
-        int height = img.rows;
-
-        int channel_height = height / 3;
-        int last_channel_height = height - 2 * channel_height;
-
-        blue_ = channels_[0] = img(cv::Rect(0, 0, width, channel_height));
-        green_ = channels_[1] = img(cv::Rect(0, channel_height, width, channel_height));
-        red_ = channels_[2] = img(cv::Rect(0, 2 * channel_height, width, last_channel_height));
-    }
-
-    void findKeyPointsAndDescriptors() {
-        cv::Ptr<cv::SIFT> sift{ cv::SIFT::create(max_features_) };
-        sift->detectAndCompute(blue_, cv::Mat{}, kp1_, descriptors1_);
-        sift->detectAndCompute(green_, cv::Mat{}, kp2_, descriptors2_);
-        sift->detectAndCompute(red_, cv::Mat{}, kp3_, descriptors3_);
+        try {
+            TiledPlateAligner aligner{ budget_mb << 20 };
+            aligner.run(argv[2], output);
+            aligner.getTimer().print();
+        }
+        catch (std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return EXIT_FAILURE;
+        }
+        std::println("Written to: {}", output.string());
+        return 0;
     }
 
-    void matchFeatures() {
-        descriptors1_.convertTo(descriptors1_, CV_32F);
-        descriptors2_.convertTo(descriptors2_, CV_32F);
-        descriptors3_.convertTo(descriptors3_, CV_32F);
-
-        cv::FlannBasedMatcher macher{
-          new cv::flann::KDTreeIndexParams(trees_number_),
-          new cv::flann::SearchParams(number_of_checks_)
-        };
-        macher.knnMatch(descriptors1_, descriptors2_, matches_bg_, 2);
-        macher.knnMatch(descriptors3_, descriptors2_, matches_rg_, 2);
+    // Default: phase correlation, "logpolar" adds rotation / scale, an estimator name selects the feature path
+    const std::string_view mode{ argc > 1 ? argv[1] : "phase" };
+    if (mode == "phase" or mode == "logpolar") {
+        cv::Mat img{ cv::imread(path1.string(), cv::IMREAD_GRAYSCALE) };
+        auto start{ std::chrono::steady_clock::now() };
+        std::array<cv::Matx33d, 3> transforms;
+        const bool done{ alignWithPhaseCorrelation(img, PhaseCorrelationAligner{ mode == "logpolar" }, transforms) };
+        std::println("Phase correlation: {:.2f} ms",
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        if (done) {
+            showRefined(img, transforms);
+            return 0;
+        }
+        std::println("Channels don't correlate, falling back to feature matching");
     }
 
-    void findGoodMatches() {
-        good_matches_bg_ = matches_bg_ |
-            std::views::filter([this](const auto& e) {return e[0].distance < lowe_ratio_ * e[1].distance; }) |
-            std::views::transform([](const auto& e) {return e[0]; }) |
-            std::ranges::to<std::vector>();
-
-        good_matches_rg_ = matches_rg_ |
-            std::views::filter([this](const auto& e) {return e[0].distance < lowe_ratio_ * e[1].distance; }) |
-            std::views::transform([](const auto& e) {return e[0]; }) |
-            std::ranges::to<std::vector>();
-
-        std::ranges::sort(good_matches_bg_, std::less{});
-        std::ranges::sort(good_matches_rg_, std::less{});
+    // "latency": stage breakdown of the feature path, channels one after another vs concurrently
+    if (mode == "latency") {
+        const int runs{ argc > 2 ? std::stoi(argv[2]) : 5 };
+        for (bool concurrent : { false, true }) {
+            playground::StageTimer timer;
+            for (int i{ 0 }; i < runs; ++i) {
+                FeatureMatching f{ path1, 1000, 10, 5, 5, 0.95f, 5.0f, false,
+                    playground::RobustEstimator::Ransac, true, concurrent };
+                for (const auto stage : { "features", "matching", "homography", "warp" }) {
+                    for (double ms : f.getTimer().samples(stage)) {
+                        timer.add(stage, ms);
+                    }
+                }
+            }
+            std::println("{}:", concurrent ? "Concurrent" : "Sequential");
+            timer.print();
+        }
+        return 0;
     }
 
-    bool fillSrcDst() {
-        if (good_matches_bg_.size() < min_match_count_) {
-            return false;
+    playground::RobustEstimator estimator{ playground::RobustEstimator::Ransac };
+    if (mode != "phase" and mode != "logpolar") {
+        try {
+            estimator = playground::parseRobustEstimator(mode);
         }
-
-        if (good_matches_rg_.size() < min_match_count_) {
-            return false;
+        catch (std::exception& e) {
+            std::cerr << e.what() << '\n' << usage;
+            return EXIT_FAILURE;
         }
-
-        src_bg_pts_.reserve(good_matches_bg_.size());
-        dst_bg_pts_.reserve(good_matches_bg_.size());
-
-        std::ranges::for_each(good_matches_bg_, [this](const auto& e) {
-            src_bg_pts_.emplace_back(kp1_[e.queryIdx].pt);
-            dst_bg_pts_.emplace_back(kp2_[e.trainIdx].pt);
-            });
-
-        src_rg_pts_.reserve(good_matches_rg_.size());
-        dst_rg_pts_.reserve(good_matches_rg_.size());
-
-        std::ranges::for_each(good_matches_rg_, [this](const auto& e) {
-            src_rg_pts_.emplace_back(kp3_[e.queryIdx].pt);
-            dst_rg_pts_.emplace_back(kp2_[e.trainIdx].pt);
-            });
-
-        return true;
     }
-
-    void findHomography() {
-        homography_bg_ = cv::findHomography(src_bg_pts_, dst_bg_pts_, cv::RANSAC, ransac_threshold_, mask_);
-        homography_rg_ = cv::findHomography(src_rg_pts_, dst_rg_pts_, cv::RANSAC, ransac_threshold_, mask_);
+    FeatureMatching f{ path1, 1000, 10, 5, 5, 0.95f, 5.0f, false, estimator };
+    f.getHomographyStatsBg().print(estimator, "blue -> green");
+    f.getHomographyStatsRg().print(estimator, "red -> green");
+    f.getTimer().print();
+    if (!f.getHomographyBg().empty() and !f.getHomographyRg().empty()) {
+        showRefined(cv::imread(path1.string(), cv::IMREAD_GRAYSCALE),
+            { cv::Matx33d(f.getHomographyBg()), cv::Matx33d::eye(), cv::Matx33d(f.getHomographyRg()) });
+        return 0;
     }
-
-    void warpPerspectives() {
-        cv::warpPerspective(blue_, blue_warped_, homography_bg_, green_.size());
-        cv::warpPerspective(red_, red_warped_, homography_rg_, green_.size());
-    }
-};
-
-int main() {
-    std::filesystem::path path1{ "../data/images/emir.png" };
-    if (!std::filesystem::exists(path1)) {
-        std::cerr << std::format("Can't find file at given location: {}", path1.string());
-        return EXIT_FAILURE;
-    }
-
-    FeatureMatching f{ path1 };
     auto img = f.warpedImages();
 
     cv::imshow("Warped", img);
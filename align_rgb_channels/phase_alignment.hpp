@@ -0,0 +1,185 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Transform from a channel to the reference channel and the phase correlation peak that supports it
+struct ChannelAlignment {
+    cv::Matx33d transform{ cv::Matx33d::eye() };
+    double response{};
+};
+
+// Aligns plate channels that differ by a translation, optionally with a small rotation and scale.
+// The translation is found by phase correlation of gradient magnitude maps (channels of a plate have
+// different intensities but the same edges) on the coarsest pyramid level and refined level by level
+// on a centered crop, where only a residual of a pixel or two is left. Rotation and scale come from
+// phase correlation of log-polar magnitude spectra on the coarsest level.
+class PhaseCorrelationAligner {
+public:
+    explicit PhaseCorrelationAligner(bool rotation_scale = false,
+        int coarse_size = 256,
+        int crop_size = 512
+    ) :
+        rotation_scale_(rotation_scale),
+        coarse_size_(coarse_size),
+        crop_size_(crop_size) {}
+
+    // The response is the weakest peak over all levels, close to 0 when the channels don't correlate
+    ChannelAlignment align(const cv::Mat& channel, const cv::Mat& reference) const {
+        std::vector<cv::Mat> channel_pyramid, reference_pyramid;
+        buildPyramid(channel, channel_pyramid);
+        buildPyramid(reference, reference_pyramid);
+
+        ChannelAlignment result;
+        result.response = 1.0;
+
+        // Coarsest level: the whole translation, with the rotation / scale estimate only if it correlates better
+        const auto& coarse_channel{ channel_pyramid.back() };
+        const auto& coarse_reference{ reference_pyramid.back() };
+        cv::Matx33d transform{ refineTranslation(coarse_channel, coarse_reference, cv::Matx33d::eye(),
+            coarse_reference.size(), result.response) };
+        if (rotation_scale_) {
+            double response{ 1.0 };
+            const cv::Matx33d rotated{ refineTranslation(coarse_channel, coarse_reference,
+                rotationScale(coarse_channel, coarse_reference), coarse_reference.size(), response) };
+            if (response > result.response) {
+                transform = rotated;
+                result.response = response;
+            }
+        }
+
+        // Finer levels: the translation doubles, the residual comes from a centered crop
+        for (int level{ static_cast<int>(channel_pyramid.size()) - 2 }; level >= 0; --level) {
+            transform = rescale(transform, 2.0);
+            const cv::Size crop{ std::min(crop_size_, reference_pyramid[level].cols),
+                std::min(crop_size_, reference_pyramid[level].rows) };
+            transform = refineTranslation(channel_pyramid[level], reference_pyramid[level], transform, crop, result.response);
+        }
+
+        result.transform = transform;
+        return result;
+    }
+
+private:
+    bool rotation_scale_{};
+    int coarse_size_{};
+    int crop_size_{};
+
+    void buildPyramid(const cv::Mat& img, std::vector<cv::Mat>& pyramid) const {
+        pyramid.clear();
+        cv::Mat level;
+        img.convertTo(level, CV_32F);
+        pyramid.push_back(level);
+        while (std::max(pyramid.back().cols, pyramid.back().rows) > coarse_size_) {
+            cv::Mat down;
+            cv::pyrDown(pyramid.back(), down);
+            pyramid.push_back(down);
+        }
+    }
+
+    static cv::Mat edges(const cv::Mat& img) {
+        cv::Mat grad_x, grad_y, magnitude;
+        cv::Sobel(img, grad_x, CV_32F, 1, 0);
+        cv::Sobel(img, grad_y, CV_32F, 0, 1);
+        cv::magnitude(grad_x, grad_y, magnitude);
+        return magnitude;
+    }
+
+    static cv::Matx33d rescale(const cv::Matx33d& transform, double factor) {
+        const cv::Matx33d s{ factor, 0, 0, 0, factor, 0, 0, 0, 1 };
+        return s * transform * s.inv();
+    }
+
+    // Compares a centered `crop` of the reference with the same region of the channel warped by
+    // `transform`, and moves the transform by the remaining shift
+    static cv::Matx33d refineTranslation(const cv::Mat& channel, const cv::Mat& reference, const cv::Matx33d& transform,
+        cv::Size crop, double& response) {
+        const cv::Rect roi{ (reference.cols - crop.width) / 2, (reference.rows - crop.height) / 2, crop.width, crop.height };
+
+        // Channel pixels landing on the crop: shift the output origin to the crop corner
+        const cv::Matx33d to_crop{ 1, 0, -static_cast<double>(roi.x), 0, 1, -static_cast<double>(roi.y), 0, 0, 1 };
+        cv::Mat warped;
+        cv::warpPerspective(channel, warped, cv::Mat(to_crop * transform), crop, cv::INTER_LINEAR, cv::BORDER_REFLECT);
+
+        cv::Mat window;
+        cv::createHanningWindow(window, crop, CV_32F);
+        double peak{};
+        const cv::Point2d shift{ cv::phaseCorrelate(edges(reference(roi)), edges(warped), window, &peak) };
+        response = std::min(response, peak);
+
+        // warped(x) ~ reference(x - shift), so the channel has to move back by the shift
+        const cv::Matx33d correction{ 1, 0, -shift.x, 0, 1, -shift.y, 0, 0, 1 };
+        return correction * transform;
+    }
+
+    // log(1 + |FFT|) of the windowed image, quadrants swapped so the DC term is in the center
+    static cv::Mat logMagnitude(const cv::Mat& img) {
+        cv::Mat window, windowed, spectrum;
+        cv::createHanningWindow(window, img.size(), CV_32F);
+        cv::multiply(edges(img), window, windowed);
+        cv::dft(windowed, spectrum, cv::DFT_COMPLEX_OUTPUT);
+
+        std::vector<cv::Mat> planes;
+        cv::split(spectrum, planes);
+        cv::Mat magnitude;
+        cv::magnitude(planes[0], planes[1], magnitude);
+        magnitude += cv::Scalar::all(1.0);
+        cv::log(magnitude, magnitude);
+
+        magnitude = magnitude(cv::Rect(0, 0, magnitude.cols & -2, magnitude.rows & -2));
+        const int cx{ magnitude.cols / 2 };
+        const int cy{ magnitude.rows / 2 };
+        cv::Mat q0{ magnitude(cv::Rect(0, 0, cx, cy)) }, q1{ magnitude(cv::Rect(cx, 0, cx, cy)) };
+        cv::Mat q2{ magnitude(cv::Rect(0, cy, cx, cy)) }, q3{ magnitude(cv::Rect(cx, cy, cx, cy)) };
+        cv::Mat tmp;
+        q0.copyTo(tmp); q3.copyTo(q0); tmp.copyTo(q3);
+        q1.copyTo(tmp); q2.copyTo(q1); tmp.copyTo(q2);
+        return magnitude;
+    }
+
+    // The magnitude spectrum ignores translation, in log-polar coordinates rotation and scale become shifts
+    cv::Matx33d rotationScale(const cv::Mat& channel, const cv::Mat& reference) const {
+        // Spectra have to be the same size, plate channels can differ by a row or two
+        const cv::Rect common{ 0, 0, std::min(channel.cols, reference.cols), std::min(channel.rows, reference.rows) };
+        const cv::Mat channel_spectrum{ logMagnitude(channel(common)) };
+        const cv::Mat reference_spectrum{ logMagnitude(reference(common)) };
+        const cv::Point2f center{ channel_spectrum.cols / 2.0f, channel_spectrum.rows / 2.0f };
+        const double max_radius{ std::min(center.x, center.y) };
+        const cv::Size polar_size{ channel_spectrum.cols, channel_spectrum.rows };
+
+        cv::Mat channel_polar, reference_polar;
+        cv::warpPolar(channel_spectrum, channel_polar, polar_size, center, max_radius, cv::WARP_POLAR_LOG | cv::INTER_LINEAR);
+        cv::warpPolar(reference_spectrum, reference_polar, polar_size, center, max_radius, cv::WARP_POLAR_LOG | cv::INTER_LINEAR);
+
+        // Columns are log radius, rows are angle over the full circle
+        const cv::Point2d shift{ cv::phaseCorrelate(reference_polar, channel_polar) };
+        const double log_base{ std::exp(std::log(max_radius) / polar_size.width) };
+        // A channel scaled by s has its spectrum scaled by 1 / s, undoing it scales by log_base^shift
+        const double scale{ std::pow(log_base, shift.x) };
+        // The spectrum is symmetric, so only angles within +-90 degrees are distinguishable
+        double angle{ 360.0 * shift.y / polar_size.height };
+        if (angle > 90.0) {
+            angle -= 180.0;
+        }
+        if (angle < -90.0) {
+            angle += 180.0;
+        }
+
+        const cv::Point2f image_center{ channel.cols / 2.0f, channel.rows / 2.0f };
+        const cv::Mat affine{ cv::getRotationMatrix2D(image_center, angle, scale) };
+        cv::Matx33d transform{ cv::Matx33d::eye() };
+        for (int r{ 0 }; r < 2; ++r) {
+            for (int c{ 0 }; c < 3; ++c) {
+                transform(r, c) = affine.at<double>(r, c);
+            }
+        }
+        return transform;
+    }
+};
@@ -0,0 +1,321 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "phase_alignment.hpp"
+#include "stage_timer.hpp"
+
+// 16-bit grayscale plate that hands out regions on demand. A binary PGM (P5) is memory-mapped and only the
+// pages a region touches are read, any other format (16-bit TIFF, PNG) is decoded once by cv::imread.
+class PlateSource {
+public:
+    explicit PlateSource(const std::filesystem::path& path) {
+        if (isPgm(path)) {
+            mapping_ = std::make_unique<playground::MappedFile>(path);
+            parsePgmHeader();
+            return;
+        }
+        decoded_ = cv::imread(path.string(), cv::IMREAD_ANYDEPTH | cv::IMREAD_GRAYSCALE);
+        if (decoded_.empty()) {
+            throw std::runtime_error(std::format("Can't load a plate from: {}", path.string()));
+        }
+        // 8-bit scans are stretched to the 16-bit range, so the rest of the pipeline sees one depth
+        if (decoded_.depth() != CV_16U) {
+            decoded_.convertTo(decoded_, CV_16U, decoded_.depth() == CV_8U ? 257.0 : 1.0);
+        }
+        size_ = decoded_.size();
+    }
+
+    cv::Size size() const { return size_; }
+    bool mapped() const { return mapping_ != nullptr; }
+    // Bytes held by the source itself, the mapping is paged in by the OS and isn't counted
+    size_t residentBytes() const { return decoded_.total() * decoded_.elemSize(); }
+
+    // CV_16UC1 copy of `roi`, which has to lie inside the plate
+    cv::Mat region(const cv::Rect& roi) const {
+        if (!mapping_) {
+            return decoded_(roi).clone();
+        }
+        cv::Mat out(roi.size(), CV_16UC1);
+        for (int y{ 0 }; y < roi.height; ++y) {
+            const uchar* src{ pixels_ + (static_cast<size_t>(roi.y + y) * size_.width + roi.x) * bytes_per_pixel_ };
+            auto* dst{ out.ptr<ushort>(y) };
+            for (int x{ 0 }; x < roi.width; ++x) {
+                // PGM samples are big-endian, 8-bit ones are stretched like decoded scans
+                dst[x] = bytes_per_pixel_ == 2
+                    ? static_cast<ushort>(src[2 * x] << 8 | src[2 * x + 1])
+                    : static_cast<ushort>(src[x] * 257);
+            }
+        }
+        return out;
+    }
+
+private:
+    std::unique_ptr<playground::MappedFile> mapping_;
+    cv::Mat decoded_;
+    cv::Size size_;
+    const uchar* pixels_{ nullptr };
+    int bytes_per_pixel_{ 2 };
+
+    static bool isPgm(const std::filesystem::path& path) {
+        std::ifstream file{ path, std::ios::binary };
+        char magic[2]{};
+        return file.read(magic, 2) && magic[0] == 'P' && magic[1] == '5';
+    }
+
+    // "P5 <width> <height> <maxval>" separated by whitespace and # comments, then a single whitespace byte
+    void parsePgmHeader() {
+        const uchar* p{ mapping_->data() + 2 };
+        const uchar* end{ mapping_->data() + mapping_->size() };
+        auto next = [&] {
+            while (p < end && (std::isspace(*p) || *p == '#')) {
+                if (*p == '#') {
+                    while (p < end && *p != '\n') {
+                        ++p;
+                    }
+                }
+                else {
+                    ++p;
+                }
+            }
+            int value{ 0 };
+            while (p < end && std::isdigit(*p)) {
+                value = value * 10 + (*p++ - '0');
+            }
+            return value;
+        };
+        size_.width = next();
+        size_.height = next();
+        const int max_value{ next() };
+        ++p;
+        bytes_per_pixel_ = max_value > 255 ? 2 : 1;
+        pixels_ = p;
+        const auto expected{ static_cast<size_t>(size_.area()) * bytes_per_pixel_ };
+        if (size_.empty() or max_value <= 0 or static_cast<size_t>(end - p) < expected) {
+            throw std::runtime_error("Malformed PGM plate");
+        }
+    }
+};
+
+// Aligns a high-resolution plate without holding it, its channels or the color result in memory.
+// Alignment is estimated with PhaseCorrelationAligner on a proxy of about `proxy_width` px, built from
+// horizontal bands, and scaled back to the full resolution. The output is then produced in bands of tiles:
+// tiles of a band are warped and merged in parallel, each one reading only the source pixels it needs,
+// and every finished band is appended to a 16-bit binary PPM, which doesn't need the whole image to be written.
+// The band height follows from `memory_budget`.
+class TiledPlateAligner {
+public:
+    explicit TiledPlateAligner(size_t memory_budget = size_t{ 256 } << 20,
+        int tile_size = 512,
+        int proxy_width = 1024,
+        bool rotation_scale = false
+    ) :
+        memory_budget_(memory_budget),
+        tile_size_(tile_size),
+        proxy_width_(proxy_width),
+        rotation_scale_(rotation_scale) {}
+
+    void run(const std::filesystem::path& input, const std::filesystem::path& output) {
+        const PlateSource plate{ [&] {
+            auto t{ timer_.measure("open") };
+            return PlateSource{ input };
+        }() };
+        const cv::Size size{ plate.size() };
+        channel_height_ = size.height / 3;
+        // Green sets the output size, blue and red are mapped onto it
+        output_size_ = cv::Size{ size.width, channel_height_ };
+
+        {
+            auto t{ timer_.measure("proxy alignment") };
+            estimateAlignment(plate);
+        }
+
+        const int band_rows{ bandTileRows(plate) };
+        const int bands{ (output_size_.height + band_rows * tile_size_ - 1) / (band_rows * tile_size_) };
+        std::ofstream file{ output, std::ios::binary };
+        if (!file) {
+            throw std::runtime_error(std::format("Can't write to: {}", output.string()));
+        }
+        file << std::format("P6\n{} {}\n65535\n", output_size_.width, output_size_.height);
+
+        for (int band{ 0 }; band < bands; ++band) {
+            const int y0{ band * band_rows * tile_size_ };
+            const int y1{ std::min(output_size_.height, y0 + band_rows * tile_size_) };
+            cv::Mat rgb(y1 - y0, output_size_.width, CV_16UC3);
+            {
+                auto t{ timer_.measure("warp + merge band") };
+                processBand(plate, y0, rgb);
+            }
+            auto t{ timer_.measure("write band") };
+            writeBand(file, rgb);
+        }
+
+        std::println("Plate {}x{} ({}), proxy scale 1/{}, tile {} px, {} tile rows per band, {} bands",
+            size.width, size.height, plate.mapped() ? "mapped PGM" : "decoded", proxy_factor_, tile_size_, band_rows, bands);
+        std::println("Working set: {:.1f} MB of {:.1f} MB budget", working_set_ / 1048576.0, memory_budget_ / 1048576.0);
+        std::println("Proxy phase correlation response: blue {:.3f}, red {:.3f}", responses_[0], responses_[2]);
+    }
+
+    const auto& getTimer() const { return timer_; }
+    // Channel to green transforms at full resolution, identity for green
+    const auto& getTransforms() const { return transforms_; }
+
+private:
+    // Configuration variables
+    size_t memory_budget_{};
+    int tile_size_{};
+    int proxy_width_{};
+    bool rotation_scale_{};
+
+    // Plate layout and alignment
+    int channel_height_{};
+    cv::Size output_size_;
+    int proxy_factor_{ 1 };
+    std::array<cv::Matx33d, 3> transforms_{ cv::Matx33d::eye(), cv::Matx33d::eye(), cv::Matx33d::eye() };
+    std::array<double, 3> responses_{ 1.0, 1.0, 1.0 };
+    size_t working_set_{};
+
+    playground::StageTimer timer_;
+
+    // The proxy is an integer downscale, so proxy pixels cover whole source pixels and bands add up exactly
+    void estimateAlignment(const PlateSource& plate) {
+        const cv::Size size{ plate.size() };
+        proxy_factor_ = std::max(1, (size.width + proxy_width_ - 1) / proxy_width_);
+        const int f{ proxy_factor_ };
+        const cv::Size proxy_size{ size.width / f, size.height / f };
+
+        cv::Mat proxy(proxy_size, CV_8UC1);
+        const int band_height{ 64 * f };
+        for (int y{ 0 }; y < proxy_size.height * f; y += band_height) {
+            const int h{ std::min(band_height, proxy_size.height * f - y) };
+            cv::Mat band{ plate.region(cv::Rect(0, y, proxy_size.width * f, h)) }, small;
+            cv::resize(band, small, cv::Size(proxy_size.width, h / f), 0.0, 0.0, cv::INTER_AREA);
+            small.convertTo(proxy(cv::Rect(0, y / f, proxy_size.width, h / f)), CV_8U, 1.0 / 257.0);
+        }
+
+        const int proxy_channel_height{ proxy.rows / 3 };
+        std::array<cv::Mat, 3> channels;
+        for (int k{ 0 }; k < 3; ++k) {
+            const int rows{ k < 2 ? proxy_channel_height : proxy.rows - 2 * proxy_channel_height };
+            channels[k] = proxy(cv::Rect(0, k * proxy_channel_height, proxy.cols, rows));
+        }
+
+        const PhaseCorrelationAligner aligner{ rotation_scale_ };
+        const cv::Matx33d s{ static_cast<double>(f), 0, 0, 0, static_cast<double>(f), 0, 0, 0, 1 };
+        for (int k : { 0, 2 }) {
+            const auto alignment{ aligner.align(channels[k], channels[1]) };
+            responses_[k] = alignment.response;
+            // Full-res channel row y lands on proxy channel row (y + d) / f, where d is the difference between
+            // the full-res channel origin and f times the proxy one
+            transforms_[k] = translate(0.0, -originOffset(1, proxy_channel_height))
+                * s * alignment.transform * s.inv()
+                * translate(0.0, originOffset(k, proxy_channel_height));
+        }
+    }
+
+    double originOffset(int channel, int proxy_channel_height) const {
+        return static_cast<double>(channel * channel_height_ - proxy_factor_ * channel * proxy_channel_height);
+    }
+
+    static cv::Matx33d translate(double dx, double dy) {
+        return { 1, 0, dx, 0, 1, dy, 0, 0, 1 };
+    }
+
+    // Tile rows per band so that the band plus the tiles in flight fit the budget. Throws when even one
+    // tile row per band doesn't fit.
+    int bandTileRows(const PlateSource& plate) {
+        const auto threads{ static_cast<size_t>(std::max(1, cv::getNumThreads())) };
+        const auto tile{ static_cast<size_t>(tile_size_) };
+        // Per tile: two source regions with a margin for the rotation, their warps, green and the merged tile
+        const size_t tile_bytes{ 2 * (2 * tile * tile * 2) + 2 * tile * tile * 2 + tile * tile * 2 + tile * tile * 6 };
+        const size_t fixed{ plate.residentBytes() + threads * tile_bytes };
+        // Output band: 16-bit RGB plus the byte-swapped row being written
+        const size_t row_bytes{ static_cast<size_t>(output_size_.width) * tile * 6 };
+        const size_t minimum{ fixed + row_bytes + static_cast<size_t>(output_size_.width) * 6 };
+        if (minimum > memory_budget_) {
+            throw std::runtime_error(std::format("Memory budget of {:.1f} MB is below the minimum of {:.1f} MB for this plate{}",
+                memory_budget_ / 1048576.0, minimum / 1048576.0,
+                plate.residentBytes() > 0 ? " (the decoded plate alone takes part of it, a P5 PGM is streamed instead)" : ""));
+        }
+        const auto rows{ std::max<size_t>(1, (memory_budget_ - fixed - static_cast<size_t>(output_size_.width) * 6) / row_bytes) };
+        const int max_rows{ (output_size_.height + tile_size_ - 1) / tile_size_ };
+        const int band_rows{ static_cast<int>(std::min<size_t>(rows, max_rows)) };
+        working_set_ = fixed + band_rows * row_bytes + static_cast<size_t>(output_size_.width) * 6;
+        return band_rows;
+    }
+
+    void processBand(const PlateSource& plate, int y0, cv::Mat& rgb) const {
+        const int cols{ (output_size_.width + tile_size_ - 1) / tile_size_ };
+        const int rows{ (rgb.rows + tile_size_ - 1) / tile_size_ };
+        cv::parallel_for_(cv::Range(0, cols * rows), [&](const cv::Range& range) {
+            for (int t{ range.start }; t < range.end; ++t) {
+                const cv::Rect local{ (t % cols) * tile_size_, (t / cols) * tile_size_,
+                    std::min(tile_size_, rgb.cols - (t % cols) * tile_size_),
+                    std::min(tile_size_, rgb.rows - (t / cols) * tile_size_) };
+                const cv::Rect tile{ local + cv::Point(0, y0) };
+                // PPM is RGB, so red goes first
+                const std::array<cv::Mat, 3> planes{ warpChannel(plate, 2, tile), warpChannel(plate, 1, tile),
+                    warpChannel(plate, 0, tile) };
+                cv::Mat merged{ rgb(local) };
+                cv::merge(planes.data(), planes.size(), merged);
+            }
+        });
+    }
+
+    // `tile` of the output in green coordinates, rendered from channel `k` of the plate
+    cv::Mat warpChannel(const PlateSource& plate, int k, const cv::Rect& tile) const {
+        const int rows{ k < 2 ? channel_height_ : plate.size().height - 2 * channel_height_ };
+        const cv::Rect channel{ 0, k * channel_height_, plate.size().width, rows };
+        if (k == 1) {
+            return plate.region(tile + channel.tl());
+        }
+
+        // Source footprint of the tile: its corners mapped back, grown by the interpolation support
+        const cv::Matx33d inverse{ transforms_[k].inv() };
+        std::vector<cv::Point2f> corners{ cv::Point2f(tile.tl()), cv::Point2f(tile.br().x, tile.y),
+            cv::Point2f(tile.br()), cv::Point2f(tile.x, tile.br().y) }, source;
+        cv::perspectiveTransform(corners, source, cv::Mat(inverse));
+        const cv::Rect footprint{ (cv::boundingRect(source) + cv::Size(4, 4) - cv::Point(2, 2))
+            & cv::Rect(0, 0, channel.width, channel.height) };
+
+        cv::Mat warped(tile.size(), CV_16UC1, cv::Scalar::all(0));
+        if (footprint.empty()) {
+            return warped;
+        }
+        const cv::Mat src{ plate.region(footprint + channel.tl()) };
+        const cv::Matx33d local{ translate(-tile.x, -tile.y) * transforms_[k] * translate(footprint.x, footprint.y) };
+        cv::warpPerspective(src, warped, cv::Mat(local), tile.size(), cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+        return warped;
+    }
+
+    // Binary PPM with maxval > 255 stores big-endian samples
+    static void writeBand(std::ofstream& file, const cv::Mat& rgb) {
+        std::vector<uchar> row(static_cast<size_t>(rgb.cols) * 6);
+        for (int y{ 0 }; y < rgb.rows; ++y) {
+            const auto* src{ rgb.ptr<ushort>(y) };
+            for (int i{ 0 }; i < rgb.cols * 3; ++i) {
+                row[2 * i] = static_cast<uchar>(src[i] >> 8);
+                row[2 * i + 1] = static_cast<uchar>(src[i] & 0xff);
+            }
+            file.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+        }
+    }
+};
@@ -0,0 +1,118 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <print>
+#include <vector>
+
+#include "hamming_matcher.hpp"
+
+// Median wall time in milliseconds
+double measure(const std::function<void()>& fn, int runs) {
+    fn();
+    std::vector<double> times;
+    times.reserve(runs);
+    for (int i{ 0 }; i < runs; ++i) {
+        auto start{ std::chrono::steady_clock::now() };
+        fn();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::ranges::nth_element(times, times.begin() + times.size() / 2);
+    return times[times.size() / 2];
+}
+
+// ORB descriptors from the bundled images, topped up with random rows when there are not enough of them
+cv::Mat collectDescriptors(const std::vector<std::filesystem::path>& paths, int count) {
+    cv::Ptr<cv::ORB> orb{ cv::ORB::create(count) };
+    cv::Mat all;
+    for (const auto& path : paths) {
+        if (all.rows >= count) {
+            break;
+        }
+        cv::Mat img{ cv::imread(path.string(), cv::IMREAD_GRAYSCALE) };
+        if (img.empty()) {
+            continue;
+        }
+        std::vector<cv::KeyPoint> kp;
+        cv::Mat descriptors;
+        orb->detectAndCompute(img, cv::Mat{}, kp, descriptors);
+        all.push_back(descriptors);
+    }
+
+    if (all.rows < count) {
+        cv::Mat random(count - all.rows, 32, CV_8U);
+        cv::randu(random, cv::Scalar::all(0), cv::Scalar::all(256));
+        all.push_back(random);
+    }
+    return all.rowRange(0, count).clone();
+}
+
+int main(int argc, char** argv) {
+    std::filesystem::path images{ argc > 1 ? argv[1] : "../data/images" };
+    const int runs{ argc > 2 ? std::stoi(argv[2]) : 5 };
+
+    const std::vector<std::filesystem::path> query_images{
+        images / "book_scene.png", images / "scanned-form.png", images / "times-square.png" };
+    const std::vector<std::filesystem::path> train_images{
+        images / "book.png", images / "form.png", images / "first-image.png" };
+
+    std::println("Hamming kernel: {}", playground::HammingMatcher::kernelName());
+    std::println("{:>6} | {:>10} {:>10} {:>7} | {:>10} {:>10} {:>7} | {:>10} {:>10} {:>7} | {:>9} {:>9} | {:>6}",
+        "N", "cv match", "ours", "speedup", "cv knn2", "ours", "speedup", "cv cross", "ours", "speedup",
+        "sort 15%", "select", "agree");
+
+    for (int n : { 5000, 10000, 20000, 50000 }) {
+        cv::Mat query{ collectDescriptors(query_images, n) };
+        cv::Mat train{ collectDescriptors(train_images, n) };
+
+        cv::BFMatcher bf{ cv::NORM_HAMMING };
+        cv::BFMatcher bf_cross{ cv::NORM_HAMMING, true };
+        std::vector<cv::DMatch> cv_matches, our_matches;
+        std::vector<std::vector<cv::DMatch>> cv_knn, our_knn;
+
+        double cv_match{ measure([&] { bf.match(query, train, cv_matches); }, runs) };
+        double our_match{ measure([&] { playground::HammingMatcher::match(query, train, our_matches); }, runs) };
+
+        double cv_knn_ms{ measure([&] { bf.knnMatch(query, train, cv_knn, 2); }, runs) };
+        double our_knn_ms{ measure([&] { playground::HammingMatcher::knnMatch(query, train, our_knn, 2); }, runs) };
+
+        std::vector<cv::DMatch> cross;
+        double cv_cross{ measure([&] { bf_cross.match(query, train, cross); }, runs) };
+        double our_cross{ measure([&] { playground::HammingMatcher::match(query, train, cross, true); }, runs) };
+
+        // Top 15% selection as in ImageRegistration: full sort vs nth_element + sort of the kept part
+        std::vector<cv::DMatch> work;
+        double sort_ms{ measure([&] {
+            work = cv_matches;
+            std::ranges::sort(work, std::less{});
+            work.resize(static_cast<size_t>(work.size() * 0.15f));
+        }, runs) };
+        double select_ms{ measure([&] {
+            work = cv_matches;
+            playground::HammingMatcher::keepBest(work, 0.15f);
+        }, runs) };
+
+        // Ties may pick a different train row, so compare distances
+        size_t agree{ 0 };
+        for (size_t i{ 0 }; i < std::min(cv_matches.size(), our_matches.size()); ++i) {
+            agree += cv_matches[i].distance == our_matches[i].distance;
+        }
+
+        std::println("{:>6} | {:>10.2f} {:>10.2f} {:>6.2f}x | {:>10.2f} {:>10.2f} {:>6.2f}x | {:>10.2f} {:>10.2f} {:>6.2f}x | {:>9.3f} {:>9.3f} | {:>5.1f}%",
+            n,
+            cv_match, our_match, cv_match / our_match,
+            cv_knn_ms, our_knn_ms, cv_knn_ms / our_knn_ms,
+            cv_cross, our_cross, cv_cross / our_cross,
+            sort_ms, select_ms,
+            100.0 * agree / std::max<size_t>(cv_matches.size(), 1));
+    }
+
+    return 0;
+}
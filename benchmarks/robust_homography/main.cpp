@@ -0,0 +1,164 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <print>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "robust_homography.hpp"
+#include "stage_timer.hpp"
+
+// Correspondences ordered by descriptor distance, as the demos hand them to the estimator
+struct MatchSet {
+    std::string name;
+    cv::Size src_size;
+    std::vector<cv::Point2f> src;
+    std::vector<cv::Point2f> dst;
+    double threshold;
+};
+
+MatchSet ratioMatches(std::string name, const cv::Mat& src, const cv::Mat& dst, const cv::Ptr<cv::Feature2D>& detector,
+    int norm, float lowe_ratio, double threshold) {
+    std::vector<cv::KeyPoint> kp1, kp2;
+    cv::Mat d1, d2;
+    detector->detectAndCompute(src, cv::Mat{}, kp1, d1);
+    detector->detectAndCompute(dst, cv::Mat{}, kp2, d2);
+
+    std::vector<std::vector<cv::DMatch>> knn;
+    cv::BFMatcher{ norm }.knnMatch(d1, d2, knn, 2);
+    std::vector<cv::DMatch> good;
+    for (const auto& e : knn) {
+        if (e.size() == 2 && e[0].distance < lowe_ratio * e[1].distance) {
+            good.push_back(e[0]);
+        }
+    }
+    std::ranges::sort(good, std::less{});
+
+    MatchSet set{ std::move(name), src.size(), {}, {}, threshold };
+    for (const auto& m : good) {
+        set.src.push_back(kp1[m.queryIdx].pt);
+        set.dst.push_back(kp2[m.trainIdx].pt);
+    }
+    return set;
+}
+
+// The pairs used by find_known_objects, image_registration and align_rgb_channels
+std::vector<MatchSet> loadPairs(const std::filesystem::path& images) {
+    std::vector<MatchSet> sets;
+    auto orb{ cv::ORB::create(1000) };
+
+    cv::Mat book{ cv::imread((images / "book.png").string(), cv::IMREAD_GRAYSCALE) };
+    cv::Mat scene{ cv::imread((images / "book_scene.png").string(), cv::IMREAD_GRAYSCALE) };
+    if (!book.empty() && !scene.empty()) {
+        sets.push_back(ratioMatches("book", book, scene, orb, cv::NORM_HAMMING, 0.9f, 5.0));
+    }
+
+    cv::Mat scan{ cv::imread((images / "scanned-form.png").string(), cv::IMREAD_GRAYSCALE) };
+    cv::Mat form{ cv::imread((images / "form.png").string(), cv::IMREAD_GRAYSCALE) };
+    if (!scan.empty() && !form.empty()) {
+        sets.push_back(ratioMatches("form", scan, form, orb, cv::NORM_HAMMING, 0.9f, 3.0));
+    }
+
+    cv::Mat plate{ cv::imread((images / "emir.png").string(), cv::IMREAD_GRAYSCALE) };
+    if (!plate.empty()) {
+        const int h{ plate.rows / 3 };
+        sets.push_back(ratioMatches("plate b->g", plate(cv::Rect(0, 0, plate.cols, h)), plate(cv::Rect(0, h, plate.cols, h)),
+            cv::SIFT::create(1000), cv::NORM_L2, 0.95f, 5.0));
+    }
+    return sets;
+}
+
+// Low-inlier variant: random correspondences inserted at random positions until they make up `outliers`
+MatchSet contaminate(const MatchSet& set, cv::Size dst_size, double outliers, std::mt19937& rng) {
+    MatchSet out{ std::format("{} +{:.0f}%", set.name, 100.0 * outliers), set.src_size, set.src, set.dst, set.threshold };
+    const auto extra{ static_cast<size_t>(set.src.size() * outliers / (1.0 - outliers)) };
+    std::uniform_real_distribution<float> sx(0.0f, static_cast<float>(set.src_size.width));
+    std::uniform_real_distribution<float> sy(0.0f, static_cast<float>(set.src_size.height));
+    std::uniform_real_distribution<float> dx(0.0f, static_cast<float>(dst_size.width));
+    std::uniform_real_distribution<float> dy(0.0f, static_cast<float>(dst_size.height));
+    for (size_t i{ 0 }; i < extra; ++i) {
+        std::uniform_int_distribution<size_t> at(0, out.src.size());
+        const auto pos{ static_cast<std::ptrdiff_t>(at(rng)) };
+        out.src.insert(out.src.begin() + pos, cv::Point2f{ sx(rng), sy(rng) });
+        out.dst.insert(out.dst.begin() + pos, cv::Point2f{ dx(rng), dy(rng) });
+    }
+    return out;
+}
+
+// Mean distance between the source corners mapped by two homographies
+double cornerError(const cv::Mat& h, const cv::Mat& reference, cv::Size size) {
+    if (h.empty() or reference.empty()) {
+        return -1.0;
+    }
+    const auto w{ static_cast<float>(size.width) };
+    const auto ht{ static_cast<float>(size.height) };
+    std::vector<cv::Point2f> corners{ {0.0f, 0.0f}, {w, 0.0f}, {w, ht}, {0.0f, ht} }, a, b;
+    cv::perspectiveTransform(corners, a, h);
+    cv::perspectiveTransform(corners, b, reference);
+    double sum{ 0.0 };
+    for (size_t i{ 0 }; i < corners.size(); ++i) {
+        sum += cv::norm(a[i] - b[i]);
+    }
+    return sum / static_cast<double>(corners.size());
+}
+
+int main(int argc, char** argv) {
+    std::filesystem::path images{ argc > 1 ? argv[1] : "../data/images" };
+    const int runs{ argc > 2 ? std::stoi(argv[2]) : 20 };
+
+    auto pairs{ loadPairs(images) };
+    if (pairs.empty()) {
+        std::cerr << std::format("Can't load benchmark images from: {}\n", images.string());
+        return EXIT_FAILURE;
+    }
+
+    std::println("{:<18} {:>6} | {:<9} {:>9} {:>9} {:>7} {:>8} {:>10}",
+        "case", "points", "estimator", "p50 ms", "p95 ms", "~iters", "inliers", "corner px");
+
+    std::mt19937 rng{ 0x5eed };
+    for (const auto& pair : pairs) {
+        if (pair.src.size() < 4) {
+            continue;
+        }
+        // Reference: exhaustive USAC_ACCURATE on the uncontaminated pair
+        cv::Mat reference_mask;
+        const cv::Mat reference{ playground::findHomography(pair.src, pair.dst, playground::RobustEstimator::Accurate,
+            pair.threshold, reference_mask, nullptr, 100000, 0.9999) };
+
+        // Destination extent of the matched points is enough for uniform outliers
+        const cv::Rect extent{ cv::boundingRect(pair.dst) };
+        const cv::Size dst_size{ extent.x + extent.width, extent.y + extent.height };
+        std::vector<MatchSet> sets{ pair };
+        for (double outliers : { 0.7, 0.9 }) {
+            sets.push_back(contaminate(pair, dst_size, outliers, rng));
+        }
+
+        for (const auto& set : sets) {
+            for (const auto& [name, estimator] : playground::robust_estimators) {
+                std::vector<double> times;
+                playground::HomographyStats stats;
+                cv::Mat mask, h;
+                for (int i{ 0 }; i < runs; ++i) {
+                    h = playground::findHomography(set.src, set.dst, estimator, set.threshold, mask, &stats);
+                    times.push_back(stats.ms);
+                }
+                std::println("{:<18} {:>6} | {:<9} {:>9.3f} {:>9.3f} {:>7} {:>7.1f}% {:>10.2f}",
+                    set.name, set.src.size(), name,
+                    playground::StageTimer::percentile(times, 0.5),
+                    playground::StageTimer::percentile(times, 0.95),
+                    stats.iteration_bound,
+                    100.0 * stats.inlier_ratio,
+                    cornerError(h, reference, set.src_size));
+            }
+        }
+    }
+
+    return 0;
+}
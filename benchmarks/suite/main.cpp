@@ -0,0 +1,569 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "coin_detection.hpp"
+#include "feature_matching.hpp"
+#include "find_known_objects.hpp"
+#include "homography.hpp"
+#include "image_inpainting.hpp"
+#include "image_registration.hpp"
+#include "process_memory.hpp"
+#include "screen_matting.hpp"
+#include "stage_timer.hpp"
+#include "stitcher.hpp"
+#include "tenengrad.hpp"
+
+// === Allocation counting ===
+
+// Every operator new of the process (STL containers, keypoints, matches, OpenCV's own C++ objects).
+// Array and nothrow forms end up here through their default implementations.
+namespace {
+std::atomic<uint64_t> heap_allocation_count{ 0 };
+std::atomic<uint64_t> heap_allocated_bytes{ 0 };
+
+void* countedAlloc(std::size_t size, std::size_t alignment) {
+    heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    heap_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (size == 0) {
+        size = 1;
+    }
+#if defined(_MSC_VER)
+    void* p{ alignment > alignof(std::max_align_t) ? _aligned_malloc(size, alignment) : std::malloc(size) };
+#else
+    void* p{ alignment > alignof(std::max_align_t)
+        ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment) : std::malloc(size) };
+#endif
+    if (!p) {
+        throw std::bad_alloc{};
+    }
+    return p;
+}
+
+void countedFree(void* p, std::size_t alignment) noexcept {
+#if defined(_MSC_VER)
+    if (alignment > alignof(std::max_align_t)) {
+        _aligned_free(p);
+        return;
+    }
+#endif
+    (void)alignment;
+    std::free(p);
+}
+} // namespace
+
+void* operator new(std::size_t size) { return countedAlloc(size, alignof(std::max_align_t)); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return countedAlloc(size, static_cast<std::size_t>(alignment)); }
+void operator delete(void* p) noexcept { countedFree(p, alignof(std::max_align_t)); }
+void operator delete(void* p, std::size_t) noexcept { countedFree(p, alignof(std::max_align_t)); }
+void operator delete(void* p, std::align_val_t alignment) noexcept { countedFree(p, static_cast<std::size_t>(alignment)); }
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept {
+    countedFree(p, static_cast<std::size_t>(alignment));
+}
+
+// cv::Mat buffers don't go through operator new, they are counted by wrapping the default MatAllocator.
+// Only allocations that own their data count, headers over user memory are free.
+class CountingMatAllocator : public cv::MatAllocator {
+public:
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag flags,
+        cv::UMatUsageFlags usage) const override {
+        cv::UMatData* u{ base_->allocate(dims, sizes, type, data, step, flags, usage) };
+        if (u and !data) {
+            allocations_.fetch_add(1, std::memory_order_relaxed);
+            bytes_.fetch_add(u->size, std::memory_order_relaxed);
+        }
+        return u;
+    }
+
+    bool allocate(cv::UMatData* data, cv::AccessFlag flags, cv::UMatUsageFlags usage) const override {
+        return base_->allocate(data, flags, usage);
+    }
+
+    void deallocate(cv::UMatData* data) const override {
+        base_->deallocate(data);
+    }
+
+    uint64_t allocations() const { return allocations_.load(std::memory_order_relaxed); }
+    uint64_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+
+private:
+    cv::MatAllocator* base_{ cv::Mat::getStdAllocator() };
+    mutable std::atomic<uint64_t> allocations_{ 0 };
+    mutable std::atomic<uint64_t> bytes_{ 0 };
+};
+
+CountingMatAllocator mat_allocator;
+
+struct AllocationCounters {
+    uint64_t heap_allocations{};
+    uint64_t heap_bytes{};
+    uint64_t mat_allocations{};
+    uint64_t mat_bytes{};
+
+    static AllocationCounters now() {
+        return { heap_allocation_count.load(std::memory_order_relaxed), heap_allocated_bytes.load(std::memory_order_relaxed),
+            mat_allocator.allocations(), mat_allocator.bytes() };
+    }
+};
+
+// === Harness ===
+
+// One measured operation. `reset` runs untimed before every iteration, for cases that consume their input.
+struct Case {
+    std::string name;
+    // Micro: one function on decoded inputs. Macro: a demo class end to end, decoding included.
+    bool macro{};
+    // Input megapixels per iteration, 0 when throughput in pixels doesn't apply
+    double megapixels{};
+    std::function<void()> run;
+    std::function<void()> reset{};
+};
+
+struct Result {
+    std::string name;
+    bool macro{};
+    int iterations{};
+    double p50_ms{};
+    double p90_ms{};
+    double p99_ms{};
+    double mean_ms{};
+    double min_ms{};
+    double ops_per_second{};
+    double megapixels_per_second{};
+    // Per iteration
+    double heap_allocations{};
+    double heap_bytes{};
+    double mat_allocations{};
+    double mat_bytes{};
+    double peak_rss_mb{};
+};
+
+Result measure(const Case& c, int iterations, int warmup) {
+    for (int i{ 0 }; i < warmup; ++i) {
+        if (c.reset) {
+            c.reset();
+        }
+        c.run();
+    }
+
+    std::vector<double> times;
+    times.reserve(iterations);
+    AllocationCounters total;
+    playground::resetPeakMemory();
+    for (int i{ 0 }; i < iterations; ++i) {
+        if (c.reset) {
+            c.reset();
+        }
+        const auto before{ AllocationCounters::now() };
+        const auto start{ std::chrono::steady_clock::now() };
+        c.run();
+        const auto end{ std::chrono::steady_clock::now() };
+        const auto after{ AllocationCounters::now() };
+        times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        total.heap_allocations += after.heap_allocations - before.heap_allocations;
+        total.heap_bytes += after.heap_bytes - before.heap_bytes;
+        total.mat_allocations += after.mat_allocations - before.mat_allocations;
+        total.mat_bytes += after.mat_bytes - before.mat_bytes;
+    }
+
+    Result r{ c.name, c.macro, iterations };
+    double sum{ 0.0 };
+    for (double t : times) {
+        sum += t;
+    }
+    const double n{ static_cast<double>(iterations) };
+    r.p50_ms = playground::StageTimer::percentile(times, 0.5);
+    r.p90_ms = playground::StageTimer::percentile(times, 0.9);
+    r.p99_ms = playground::StageTimer::percentile(times, 0.99);
+    r.mean_ms = sum / n;
+    r.min_ms = std::ranges::min(times);
+    r.ops_per_second = 1000.0 / r.mean_ms;
+    r.megapixels_per_second = c.megapixels * r.ops_per_second;
+    r.heap_allocations = static_cast<double>(total.heap_allocations) / n;
+    r.heap_bytes = static_cast<double>(total.heap_bytes) / n;
+    r.mat_allocations = static_cast<double>(total.mat_allocations) / n;
+    r.mat_bytes = static_cast<double>(total.mat_bytes) / n;
+    r.peak_rss_mb = static_cast<double>(playground::memoryUsage().peak) / 1048576.0;
+    return r;
+}
+
+cv::Mat load(const std::filesystem::path& path, int flags = cv::IMREAD_COLOR) {
+    cv::Mat img{ cv::imread(path.string(), flags) };
+    if (img.empty()) {
+        throw std::runtime_error(std::format("Can't load an image from: {}", path.string()));
+    }
+    return img;
+}
+
+double megapixels(cv::Size size) {
+    return static_cast<double>(size.area()) / 1e6;
+}
+
+// Keeps results of the measured calls observable
+double sink{};
+
+// === Cases ===
+
+// Focus measure of one frame: the demo's central ROI (20% x 20%) and the whole image
+std::vector<Case> tenengradCases(const std::filesystem::path& data) {
+    cv::Mat gray{ load(data / "images/flower-garden.png", cv::IMREAD_GRAYSCALE) };
+    const cv::Point middle{ gray.cols / 2, gray.rows / 2 };
+    const int dx{ gray.cols / 10 };
+    const int dy{ gray.rows / 10 };
+    cv::Mat roi{ gray(cv::Range(middle.y - dy, middle.y + dy), cv::Range(middle.x - dx, middle.x + dx)).clone() };
+    return {
+        { "calculateTenengradFocus roi", false, megapixels(roi.size()), [roi] { sink += calculateTenengradFocus(roi); } },
+        { "calculateTenengradFocus full", false, megapixels(gray.size()), [gray] { sink += calculateTenengradFocus(gray); } }
+    };
+}
+
+// Every morphology of the coin demo on its thresholded coins, 7x7 ellipse, 2 iterations
+std::vector<Case> morphCases(const std::filesystem::path& data) {
+    auto cd{ std::make_shared<CoinDetection>() };
+    cd->src = load(data / "images/CoinsA.png");
+    cv::cvtColor(cd->src, cd->gray, cv::COLOR_BGR2GRAY);
+    cd->threshold_min_value = 150;
+    thresholdImage(*cd);
+    cd->kernel_morph_type = cv::MORPH_ELLIPSE;
+    cd->kernel_size = 7;
+    cd->number_of_iterations = 2;
+
+    std::vector<Case> cases;
+    const std::vector<std::string_view> names{ "erode", "dilate", "close", "open" };
+    for (int type{ 0 }; type < static_cast<int>(names.size()); ++type) {
+        cases.push_back({ std::format("morphImage {}", names[type]), false, megapixels(cd->gray.size()),
+            [cd, type] {
+                cd->morph_type = type;
+                morphImage(*cd);
+            } });
+    }
+    return cases;
+}
+
+// Both inpainting methods over scratches drawn the way the demo's mouse callback draws them
+std::vector<Case> inpaintingCases(const std::filesystem::path& data) {
+    auto ii{ std::make_shared<ImageInpainting>((data / "images/Lincoln.png").string()) };
+    cv::Mat scratched{ ii->getImg().clone() };
+    const cv::Size size{ scratched.size() };
+    cv::RNG rng{ 0x5eed };
+    for (int i{ 0 }; i < 12; ++i) {
+        const cv::Point a{ rng.uniform(0, size.width), rng.uniform(0, size.height) };
+        const cv::Point b{ rng.uniform(0, size.width), rng.uniform(0, size.height) };
+        cv::line(ii->getMask(), a, b, cv::Scalar::all(255), 3, cv::LINE_8);
+        cv::line(scratched, a, b, cv::Scalar::all(255), 3, cv::LINE_8);
+    }
+    ii->setImg(scratched);
+    return {
+        { "ImageInpainting::process ns", false, megapixels(size), [ii] { sink += ii->process(cv::INPAINT_NS).cols; } },
+        { "ImageInpainting::process telea", false, megapixels(size),
+            [ii] { sink += ii->process(cv::INPAINT_TELEA).cols; } }
+    };
+}
+
+// One green screen frame per iteration: Lab conversion, colour mask and compositing, as in the demo loop.
+// The frame is synthetic (a subject on a flat green backdrop), the backdrop colours are picked at the corners.
+std::vector<Case> mattingCases(const std::filesystem::path& data) {
+    cv::Mat subject{ load(data / "images/girl.png") };
+    cv::Mat frame(720, 1280, CV_8UC3, cv::Scalar(64, 177, 0));
+    const double scale{ std::min(0.8 * frame.rows / subject.rows, 0.8 * frame.cols / subject.cols) };
+    cv::resize(subject, subject, {}, scale, scale, cv::INTER_AREA);
+    subject.copyTo(frame(cv::Rect((frame.cols - subject.cols) / 2, (frame.rows - subject.rows) / 2, subject.cols,
+        subject.rows)));
+
+    auto sm{ std::make_shared<ScreenMatting>(data / "images/IF4.png") };
+    if (sm->getBackground().empty()) {
+        throw std::runtime_error(std::format("Can't load an image from: {}", (data / "images/IF4.png").string()));
+    }
+    frame.copyTo(sm->getImg());
+    sm->convertToLab();
+    for (const cv::Point p : { cv::Point{ 5, 5 }, cv::Point{ frame.cols - 6, 5 }, cv::Point{ 5, frame.rows - 6 },
+             cv::Point{ frame.cols - 6, frame.rows - 6 } }) {
+        sm->setPoints(p);
+    }
+    sm->blur_idx = 2;
+    sm->erode_idx = 1;
+    return { { "ScreenMatting::process", false, megapixels(frame.size()),
+        [sm] {
+            sm->convertToLab();
+            sm->setMask();
+            sm->process();
+        },
+        [sm, frame] { frame.copyTo(sm->getImg()); } } };
+}
+
+// The book cover onto a quad of the Times Square photo: full warp and quad-only compositing
+std::vector<Case> homographyCases(const std::filesystem::path& data) {
+    const auto src{ data / "images/first-image.png" };
+    const auto dst{ data / "images/times-square.png" };
+    auto make = [&] {
+        auto h{ std::make_shared<Homography>(src, dst) };
+        if (h->getSrc().empty() or h->getDst().empty()) {
+            throw std::runtime_error(std::format("Can't load {} or {}", src.string(), dst.string()));
+        }
+        const cv::Size size{ h->getDst().size() };
+        for (const auto& [x, y] : { std::pair{ 0.30, 0.20 }, std::pair{ 0.62, 0.25 }, std::pair{ 0.60, 0.70 },
+                 std::pair{ 0.28, 0.66 } }) {
+            h->setDstPoints({ static_cast<int>(x * size.width), static_cast<int>(y * size.height) });
+        }
+        return h;
+    };
+    auto warp{ make() };
+    auto composite{ make() };
+    const double mp{ megapixels(warp->getDst().size()) };
+    return {
+        { "Homography::process warp", false, mp, [warp] { warp->process(); } },
+        { "Homography::process composite", false, mp, [composite] { composite->process(true); } }
+    };
+}
+
+// The three FeaturePipeline compositions with the demos' parameters, train side indexed once and the
+// FeatureMatch reused, so this is the steady state of a repeated query
+std::vector<Case> featurePipelineCases(const std::filesystem::path& data) {
+    std::vector<Case> cases;
+
+    auto objects{ std::make_shared<ObjectPipeline>(playground::OrbDetector{ 1000, true }, playground::LshMatcher{ 8, 16 },
+        playground::LoweRatio{ 0.9f }, playground::RobustHomography{ playground::RobustEstimator::Ransac, 5.0 }, 10) };
+    objects->setTrain(load(data / "images/book_scene.png", cv::IMREAD_GRAYSCALE));
+    cv::Mat book{ load(data / "images/book.png", cv::IMREAD_GRAYSCALE) };
+    auto book_match{ std::make_shared<playground::FeatureMatch>() };
+    cases.push_back({ "FeaturePipeline orb+lsh+ratio (objects)", false, megapixels(book.size()),
+        [objects, book, book_match] { sink += objects->process(book, *book_match); } });
+
+    auto channels{ std::make_shared<ChannelPipeline>(playground::SiftDetector{ 1000, true },
+        playground::KdTreeMatcher{ 5, 5 }, playground::LoweRatio{ 0.95f },
+        playground::RobustHomography{ playground::RobustEstimator::Ransac, 5.0 }, 10) };
+    const auto plate{ splitPlate(load(data / "images/emir.png", cv::IMREAD_GRAYSCALE)) };
+    channels->setTrain(plate[1]);
+    cv::Mat blue{ plate[0].clone() };
+    auto blue_match{ std::make_shared<playground::FeatureMatch>() };
+    cases.push_back({ "FeaturePipeline sift+kdtree+ratio (channels)", false, megapixels(blue.size()),
+        [channels, blue, blue_match] { sink += channels->process(blue, *blue_match); } });
+
+    auto registration{ std::make_shared<RegistrationFeatures>(playground::OrbDetector{ 500, true },
+        playground::NamedMatcher{}, playground::KeepBest{ 0.15f },
+        playground::RobustHomography{ playground::RobustEstimator::Ransac, 3.0 }, 4) };
+    registration->setTrain(load(data / "images/form.png", cv::IMREAD_GRAYSCALE));
+    cv::Mat scan{ load(data / "images/scanned-form.png", cv::IMREAD_GRAYSCALE) };
+    auto scan_match{ std::make_shared<playground::FeatureMatch>() };
+    cases.push_back({ "FeaturePipeline orb+hamming+best (registration)", false, megapixels(scan.size()),
+        [registration, scan, scan_match] { sink += registration->process(scan, *scan_match); } });
+
+    return cases;
+}
+
+// The demo classes as their main() runs them: decode, features, matching, homography and warp
+std::vector<Case> featureDemoCases(const std::filesystem::path& data) {
+    const auto images{ data / "images" };
+    const double book_mp{ megapixels(load(images / "book.png").size()) + megapixels(load(images / "book_scene.png").size()) };
+    const double plate_mp{ megapixels(load(images / "emir.png", cv::IMREAD_GRAYSCALE).size()) };
+    const double form_mp{ megapixels(load(images / "scanned-form.png").size()) + megapixels(load(images / "form.png").size()) };
+    return {
+        { "FindKnownObjects", true, book_mp, [images] {
+            FindKnownObjects o{ images / "book.png", images / "book_scene.png", 1000, 10, 8, 16, 0.9f, 5.0f };
+            sink += o.getHomographyStats().inlier_ratio;
+        } },
+        { "FeatureMatching", true, plate_mp, [images] {
+            FeatureMatching f{ images / "emir.png", 1000, 10, 5, 5, 0.95f, 5.0f, false };
+            sink += f.getHomographyBg().empty();
+        } },
+        { "ImageRegistration", true, form_mp, [images] {
+            ImageRegistration ir{ images / "scanned-form.png", images / "form.png", 500, 0.15f, "BruteForce-Hamming" };
+            sink += ir.getWarped().cols;
+        } }
+    };
+}
+
+// Full stitch of the bundled scene without the registration cache, so every iteration registers from scratch
+std::vector<Case> stitcherCases(const std::filesystem::path& data) {
+    auto stitcher{ std::make_shared<Stitcher>(Stitcher::sequence(data / "images/scene", {}), PanoramaSettings{},
+        std::filesystem::path{}) };
+    stitcher->setVerbose(false);
+    double mp{ 0.0 };
+    for (const auto& image : stitcher->getImages()) {
+        mp += megapixels(image.full_size);
+    }
+    return { { "Stitcher::createStitcher", true, mp, [stitcher] {
+        const auto pano{ stitcher->createStitcher() };
+        sink += pano ? pano->cols : 0;
+    } } };
+}
+
+// === Output ===
+
+void print(const std::vector<Result>& results) {
+    std::println("{:<48} {:>5} {:>6} {:>9} {:>9} {:>9} {:>9} {:>8} {:>8} {:>9} {:>9} {:>8} {:>9} {:>8}",
+        "case", "kind", "iters", "p50 ms", "p90 ms", "p99 ms", "mean ms", "ops/s", "MP/s",
+        "new/op", "new KB/op", "mats/op", "mat MB/op", "peak MB");
+    for (const auto& r : results) {
+        std::println("{:<48} {:>5} {:>6} {:>9.3f} {:>9.3f} {:>9.3f} {:>9.3f} {:>8.1f} {:>8.1f} {:>9.1f} {:>9.1f} {:>8.1f} {:>9.2f} {:>8.1f}",
+            r.name, r.macro ? "macro" : "micro", r.iterations, r.p50_ms, r.p90_ms, r.p99_ms, r.mean_ms,
+            r.ops_per_second, r.megapixels_per_second, r.heap_allocations, r.heap_bytes / 1024.0,
+            r.mat_allocations, r.mat_bytes / 1048576.0, r.peak_rss_mb);
+    }
+}
+
+// JSON through cv::FileStorage, read back by `bench compare`
+void writeJson(const std::vector<Result>& results, const std::filesystem::path& path, int runs) {
+    cv::FileStorage fs{ path.string(), cv::FileStorage::WRITE | cv::FileStorage::FORMAT_JSON };
+    if (!fs.isOpened()) {
+        throw std::runtime_error(std::format("Can't write results to: {}", path.string()));
+    }
+    fs << "opencv" << CV_VERSION;
+    fs << "threads" << cv::getNumThreads();
+    fs << "runs" << runs;
+    fs << "timestamp" << std::format("{:%FT%TZ}", std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now()));
+    fs << "cases" << "[";
+    for (const auto& r : results) {
+        fs << "{";
+        fs << "name" << r.name;
+        fs << "kind" << (r.macro ? "macro" : "micro");
+        fs << "iterations" << r.iterations;
+        fs << "p50_ms" << r.p50_ms;
+        fs << "p90_ms" << r.p90_ms;
+        fs << "p99_ms" << r.p99_ms;
+        fs << "mean_ms" << r.mean_ms;
+        fs << "min_ms" << r.min_ms;
+        fs << "ops_per_second" << r.ops_per_second;
+        fs << "megapixels_per_second" << r.megapixels_per_second;
+        fs << "heap_allocations" << r.heap_allocations;
+        fs << "heap_bytes" << r.heap_bytes;
+        fs << "mat_allocations" << r.mat_allocations;
+        fs << "mat_bytes" << r.mat_bytes;
+        fs << "peak_rss_mb" << r.peak_rss_mb;
+        fs << "}";
+    }
+    fs << "]";
+}
+
+std::vector<Result> readJson(const std::filesystem::path& path) {
+    cv::FileStorage fs{ path.string(), cv::FileStorage::READ | cv::FileStorage::FORMAT_JSON };
+    if (!fs.isOpened()) {
+        throw std::runtime_error(std::format("Can't read results from: {}", path.string()));
+    }
+    std::vector<Result> results;
+    for (const auto& node : fs["cases"]) {
+        Result r;
+        node["name"] >> r.name;
+        r.macro = static_cast<std::string>(node["kind"]) == "macro";
+        r.iterations = static_cast<int>(node["iterations"]);
+        r.p50_ms = static_cast<double>(node["p50_ms"]);
+        r.p90_ms = static_cast<double>(node["p90_ms"]);
+        r.heap_allocations = static_cast<double>(node["heap_allocations"]);
+        r.mat_allocations = static_cast<double>(node["mat_allocations"]);
+        results.push_back(std::move(r));
+    }
+    return results;
+}
+
+// Cases of `current` whose median latency or allocations per iteration grew by more than `tolerance`
+// over `baseline`. Returns the number of regressions, so the exit code can gate a CI job.
+int compare(const std::filesystem::path& baseline_path, const std::filesystem::path& current_path, double tolerance) {
+    const auto baseline{ readJson(baseline_path) };
+    const auto current{ readJson(current_path) };
+    auto grew = [tolerance](double before, double after) { return after > before * (1.0 + tolerance) + 0.5e-3; };
+
+    std::println("{:<48} {:>10} {:>10} {:>8} {:>10} {:>10} {:>10} {:>10}  {}",
+        "case", "base p50", "p50", "change", "base new", "new", "base mats", "mats", "");
+    int regressions{ 0 };
+    for (const auto& r : current) {
+        auto it{ std::ranges::find(baseline, r.name, &Result::name) };
+        if (it == baseline.end()) {
+            std::println("{:<48} {:>10} {:>10.3f}", r.name, "-", r.p50_ms);
+            continue;
+        }
+        const bool slower{ grew(it->p50_ms, r.p50_ms) };
+        // Allocation counts are deterministic, any growth beyond the tolerance is a regression
+        const bool allocates{ grew(it->heap_allocations, r.heap_allocations) or grew(it->mat_allocations, r.mat_allocations) };
+        regressions += slower or allocates;
+        std::println("{:<48} {:>10.3f} {:>10.3f} {:>7.1f}% {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f}  {}",
+            r.name, it->p50_ms, r.p50_ms, 100.0 * (r.p50_ms / it->p50_ms - 1.0),
+            it->heap_allocations, r.heap_allocations, it->mat_allocations, r.mat_allocations,
+            slower ? "SLOWER" : allocates ? "MORE ALLOCATIONS" : "");
+    }
+    std::println("{} regression(s) at {:.0f}% tolerance", regressions, 100.0 * tolerance);
+    return regressions;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string_view{ argv[1] } == "compare") {
+        if (argc < 4) {
+            std::cerr << "Usage: bench compare <baseline.json> <current.json> [tolerance = 0.10]\n";
+            return EXIT_FAILURE;
+        }
+        try {
+            return compare(argv[2], argv[3], argc > 4 ? std::stod(argv[4]) : 0.10) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    const std::filesystem::path data{ argc > 1 ? argv[1] : "../data" };
+    const int runs{ argc > 2 ? std::stoi(argv[2]) : 50 };
+    const std::filesystem::path output{ argc > 3 ? argv[3] : "bench.json" };
+    const std::string filter{ argc > 4 ? argv[4] : "" };
+
+    // Same sequence of cv::theRNG() on every run, synthetic inputs use their own seeded cv::RNG
+    cv::setRNGSeed(0x5eed);
+    cv::Mat::setDefaultAllocator(&mat_allocator);
+
+    std::vector<Case> cases;
+    const std::vector<std::pair<std::string_view, std::function<std::vector<Case>(const std::filesystem::path&)>>> groups{
+        { "tenengrad_focus", tenengradCases },
+        { "coin_detection", morphCases },
+        { "image_inpainting", inpaintingCases },
+        { "screen_matting", mattingCases },
+        { "homography_warp", homographyCases },
+        { "feature_pipeline", featurePipelineCases },
+        { "feature demos", featureDemoCases },
+        { "panorama_stitching", stitcherCases }
+    };
+    for (const auto& [group, make] : groups) {
+        try {
+            for (auto& c : make(data)) {
+                if (filter.empty() or c.name.find(filter) != std::string::npos) {
+                    cases.push_back(std::move(c));
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << std::format("Skipping {}: {}\n", group, e.what());
+        }
+    }
+
+    // ImageRegistration prints every homography it finds
+    auto* cout_buffer{ std::cout.rdbuf(nullptr) };
+    std::vector<Result> results;
+    for (const auto& c : cases) {
+        const int iterations{ c.macro ? std::max(3, runs / 10) : runs };
+        results.push_back(measure(c, iterations, c.macro ? 1 : 3));
+        std::cerr << std::format("{}: p50 {:.3f} ms\n", c.name, results.back().p50_ms);
+    }
+    std::cout.rdbuf(cout_buffer);
+
+    print(results);
+    writeJson(results, output, runs);
+    std::println("Results written to {}", output.string());
+    return 0;
+}
@@ -0,0 +1,186 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <print>
+#include <tuple>
+#include <vector>
+
+#include "homography.hpp"
+#include "warp_perspective.hpp"
+
+struct WarpCase {
+    std::string name;
+    cv::Mat src;
+    cv::Mat homography;
+    cv::Size dsize;
+};
+
+// Quad given as fractions of the image size, clockwise from top-left
+cv::Mat quadToQuad(cv::Size src_size, const std::array<cv::Point2f, 4>& src_quad,
+    cv::Size dst_size, const std::array<cv::Point2f, 4>& dst_quad) {
+    std::vector<cv::Point2f> src_pts, dst_pts;
+    for (size_t i{ 0 }; i < 4; ++i) {
+        src_pts.emplace_back(src_quad[i].x * src_size.width, src_quad[i].y * src_size.height);
+        dst_pts.emplace_back(dst_quad[i].x * dst_size.width, dst_quad[i].y * dst_size.height);
+    }
+    return cv::getPerspectiveTransform(src_pts, dst_pts);
+}
+
+// Same warp expressed for images resized by `scale`: S * H * S^-1
+WarpCase rescale(const WarpCase& c, double scale) {
+    WarpCase out{ std::format("{} x{}", c.name, scale), {}, {}, {} };
+    cv::resize(c.src, out.src, {}, scale, scale, cv::INTER_AREA);
+    cv::Matx33d s{ scale, 0, 0, 0, scale, 0, 0, 0, 1 };
+    out.homography = cv::Mat(s * cv::Matx33d(c.homography) * s.inv());
+    out.dsize = { cvRound(c.dsize.width * scale), cvRound(c.dsize.height * scale) };
+    return out;
+}
+
+std::vector<WarpCase> loadCases(const std::filesystem::path& images) {
+    const std::array<cv::Point2f, 4> full{ { {0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f} } };
+    std::vector<WarpCase> cases;
+
+    // homography_warp: poster projected onto a billboard, full-frame warp
+    cv::Mat poster{ cv::imread((images / "first-image.png").string()) };
+    cv::Mat square{ cv::imread((images / "times-square.png").string()) };
+    if (!poster.empty() && !square.empty()) {
+        cases.push_back({ "billboard", poster,
+            quadToQuad(poster.size(), full, square.size(),
+                { { {0.30f, 0.18f}, {0.52f, 0.24f}, {0.51f, 0.58f}, {0.29f, 0.62f} } }),
+            square.size() });
+    }
+
+    // image_registration: scanned page rectified onto the template
+    cv::Mat scan{ cv::imread((images / "scanned-form.png").string()) };
+    cv::Mat form{ cv::imread((images / "form.png").string()) };
+    if (!scan.empty() && !form.empty()) {
+        cases.push_back({ "document", scan,
+            quadToQuad(scan.size(), { { {0.08f, 0.05f}, {0.93f, 0.09f}, {0.97f, 0.95f}, {0.04f, 0.92f} } },
+                form.size(), full),
+            form.size() });
+    }
+
+    // align_rgb_channels: plate channel, small rotation, scale and shift (affine)
+    cv::Mat plate{ cv::imread((images / "emir.png").string(), cv::IMREAD_GRAYSCALE) };
+    if (!plate.empty()) {
+        cv::Mat channel{ plate(cv::Rect(0, 0, plate.cols, plate.rows / 3)).clone() };
+        cv::Mat affine{ cv::getRotationMatrix2D({ channel.cols / 2.0f, channel.rows / 2.0f }, 0.4, 1.01) };
+        affine.at<double>(0, 2) += 6.0;
+        affine.at<double>(1, 2) -= 3.0;
+        cv::Mat h{ cv::Mat::eye(3, 3, CV_64F) };
+        affine.copyTo(h(cv::Rect(0, 0, 3, 2)));
+        cases.push_back({ "plate", channel, h, channel.size() });
+    }
+
+    return cases;
+}
+
+// Median wall time in milliseconds
+double measure(const std::function<void()>& fn, int runs) {
+    fn();
+    std::vector<double> times;
+    times.reserve(runs);
+    for (int i{ 0 }; i < runs; ++i) {
+        auto start{ std::chrono::steady_clock::now() };
+        fn();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::ranges::nth_element(times, times.begin() + times.size() / 2);
+    return times[times.size() / 2];
+}
+
+double meanAbsDiff(const cv::Mat& a, const cv::Mat& b) {
+    return cv::norm(a, b, cv::NORM_L1) / static_cast<double>(a.total() * a.channels());
+}
+
+// compositeIntoQuad with the tiled warp against cv::warpPerspective, over a white canvas and only along the quad
+// edge, where the anti-aliased coverage blends in warped pixels sampled outside of the source. Mean absolute
+// difference per channel in that band; a black border there shows up as a dark fringe and a large difference.
+double quadEdgeDiff(const WarpCase& c) {
+    const float w{ static_cast<float>(c.src.cols - 1) };
+    const float h{ static_cast<float>(c.src.rows - 1) };
+    std::vector<cv::Point2f> quad;
+    cv::perspectiveTransform(std::vector<cv::Point2f>{ {0.0f, 0.0f}, {w, 0.0f}, {w, h}, {0.0f, h} }, quad, c.homography);
+
+    const cv::Mat canvas(c.dsize, CV_8UC3, cv::Scalar::all(255));
+    cv::Mat reference{ canvas.clone() };
+    cv::Mat ours{ canvas.clone() };
+    cv::Mat warped, coverage;
+    compositeIntoQuad(c.src, reference, c.homography, quad, warped, coverage, false);
+    compositeIntoQuad(c.src, ours, c.homography, quad, warped, coverage, true);
+
+    std::vector<cv::Point> outline;
+    for (const auto& p : quad) {
+        outline.emplace_back(cvRound(p.x), cvRound(p.y));
+    }
+    cv::Mat band{ cv::Mat::zeros(c.dsize, CV_8UC1) };
+    cv::polylines(band, outline, true, cv::Scalar::all(255), 3);
+    const int pixels{ cv::countNonZero(band) };
+    if (pixels == 0) {
+        return 0.0;
+    }
+    return cv::norm(reference, ours, cv::NORM_L1, band) / static_cast<double>(pixels * 3);
+}
+
+int main(int argc, char** argv) {
+    std::filesystem::path images{ argc > 1 ? argv[1] : "../data/images" };
+    const int runs{ argc > 2 ? std::stoi(argv[2]) : 20 };
+
+    auto base_cases{ loadCases(images) };
+    if (base_cases.empty()) {
+        std::cerr << std::format("Can't load benchmark images from: {}\n", images.string());
+        return EXIT_FAILURE;
+    }
+
+    std::println("{:<18} {:>11} {:>7} | {:>9} {:>9} {:>7} {:>6} | {:>9} {:>9} {:>7} {:>6}",
+        "case", "output", "type", "cv lin", "ours lin", "speedup", "diff", "cv cub", "ours cub", "speedup", "diff");
+
+    for (const auto& base : base_cases) {
+        for (double scale : { 0.5, 1.0, 2.0 }) {
+            auto c{ rescale(base, scale) };
+            cv::Mat reference, ours;
+
+            auto run = [&](int cv_flag, playground::WarpInterpolation interpolation) {
+                double cv_ms{ measure([&] { cv::warpPerspective(c.src, reference, c.homography, c.dsize, cv_flag); }, runs) };
+                double our_ms{ measure([&] { playground::warpPerspective(c.src, ours, c.homography, c.dsize, interpolation); }, runs) };
+                return std::tuple{ cv_ms, our_ms, meanAbsDiff(reference, ours) };
+            };
+
+            auto [cv_lin, our_lin, diff_lin] = run(cv::INTER_LINEAR, playground::WarpInterpolation::Linear);
+            auto [cv_cub, our_cub, diff_cub] = run(cv::INTER_CUBIC, playground::WarpInterpolation::Cubic);
+
+            std::println("{:<18} {:>11} {:>7} | {:>9.3f} {:>9.3f} {:>6.2f}x {:>6.3f} | {:>9.3f} {:>9.3f} {:>6.2f}x {:>6.3f}",
+                c.name, std::format("{}x{}", c.dsize.width, c.dsize.height), std::format("8UC{}", c.src.channels()),
+                cv_lin, our_lin, cv_lin / our_lin, diff_lin,
+                cv_cub, our_cub, cv_cub / our_cub, diff_cub);
+        }
+    }
+
+    // Quad compositing of homography_warp: both warp paths must agree on the quad edge
+    constexpr double edge_tolerance{ 1.0 };
+    bool edges_match{ true };
+    std::println("\n{:<18} {:>11} {:>10}", "quad edge", "output", "diff");
+    for (const auto& base : base_cases) {
+        if (base.src.channels() != 3) {
+            continue;
+        }
+        for (double scale : { 0.5, 1.0, 2.0 }) {
+            auto c{ rescale(base, scale) };
+            const double diff{ quadEdgeDiff(c) };
+            edges_match = edges_match and diff <= edge_tolerance;
+            std::println("{:<18} {:>11} {:>10.3f}{}", c.name, std::format("{}x{}", c.dsize.width, c.dsize.height),
+                diff, diff <= edge_tolerance ? "" : "  MISMATCH");
+        }
+    }
+
+    return edges_match ? 0 : 1;
+}
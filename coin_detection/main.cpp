@@ -10,55 +10,7 @@
 #include <stdexcept>
 #include <vector>
 
-struct CoinDetection {
-    cv::Mat src, gray;
-    std::vector<cv::Mat> split;
-
-    // Window name
-    const std::string image_window{ "Processed Image" };
-    const std::string thresh_window{ "Threshold Controls" };
-    const std::string morph_window{ "Morphology Controls" };
-
-    // Type of operations
-    /*
-     * 1. Thresholding
-     * 2. Morphological Operations
-     * 3. Blob Detection
-     * 4. Contour Detection
-     * 5. Connected Component Analysis
-     */
-
-     // Threshold
-    cv::Mat thresholded;
-    int threshold_type{ 0 };
-    int threshold_steps{ 4 };
-    int threshold_min_value{ 0 };
-    int threshold_max_value{ 255 };
-    int steps{ 255 };
-    std::string number_threshold_types{ "Threshold Types" };
-    std::string min_thresh{ "Threshold Min Value" };
-    std::string max_thresh{ "Threshold Max Value" };
-
-    // Morphological Operations
-    cv::Mat morphed;
-    int morph_type{ 0 };
-    int morph_steps{ 3 };
-    int kernel_morph_type{ 0 };
-    int kernel_morph_steps{ 2 };
-    int kernel_multiplier{ 0 };
-    int kernel_multiplier_steps{ 10 };
-    int kernel_size{ 3 + kernel_multiplier * 2 };
-    int number_of_iterations{ 1 };
-    int how_many_iterations{ 20 };
-    std::string number_morph_types{ "Morph Types" };
-    std::string number_kernel_morph_types{ "Kernel Types" };
-    std::string number_kernel_steps{ "Kernel Steps" };
-    std::string numer_of_iterations{ "Number of iterations" };
-};
-
-void thresholdImage(CoinDetection& cd) {
-    cv::threshold(cd.gray, cd.thresholded, cd.threshold_min_value, cd.threshold_max_value, cd.threshold_type);
-}
+#include "coin_detection.hpp"
 
 void ProcessThreshold(int, void* data) {
     auto* cd = static_cast<CoinDetection*>(data);
@@ -66,22 +18,6 @@ void ProcessThreshold(int, void* data) {
     cv::imshow(cd->thresh_window, cd->thresholded);
 }
 
-void morphImage(CoinDetection& cd) {
-    auto element{ cv::getStructuringElement(cd.kernel_morph_type, cv::Size(cd.kernel_size, cd.kernel_size)) };
-    if (cd.morph_type == 0) {
-        cv::erode(cd.thresholded, cd.morphed, element, cv::Point(-1, -1), cd.number_of_iterations);
-    }
-    else if (cd.morph_type == 1) {
-        cv::dilate(cd.thresholded, cd.morphed, element, cv::Point(-1, -1), cd.number_of_iterations);
-    }
-    else if (cd.morph_type == 2) {
-        cv::morphologyEx(cd.thresholded, cd.morphed, cv::MORPH_CLOSE, element, cv::Point(-1, -1), cd.number_of_iterations);
-    }
-    else if (cd.morph_type == 3) {
-        cv::morphologyEx(cd.thresholded, cd.morphed, cv::MORPH_OPEN, element, cv::Point(-1, -1), cd.number_of_iterations);
-    }
-}
-
 void ProcessMorph(int, void* data) {
     auto* cd = static_cast<CoinDetection*>(data);
     morphImage(*cd);
@@ -0,0 +1,67 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace playground {
+
+// Bounded multi-producer multi-consumer queue connecting pipeline stages. A full queue blocks the producer,
+// so a slow stage throttles the ones before it instead of letting frames pile up in memory.
+template <typename T>
+class BlockingQueue {
+public:
+    explicit BlockingQueue(size_t capacity) : capacity_(capacity) {}
+
+    BlockingQueue(const BlockingQueue&) = delete;
+    BlockingQueue& operator=(const BlockingQueue&) = delete;
+
+    // Blocks while the queue is full, returns false if it was closed
+    bool push(T value) {
+        std::unique_lock lock{ mutex_ };
+        not_full_.wait(lock, [this] { return closed_ || queue_.size() < capacity_; });
+        if (closed_) {
+            return false;
+        }
+        queue_.push_back(std::move(value));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Blocks while the queue is empty, returns nothing once it is closed and drained
+    std::optional<T> pop() {
+        std::unique_lock lock{ mutex_ };
+        not_empty_.wait(lock, [this] { return closed_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return std::nullopt;
+        }
+        T value{ std::move(queue_.front()) };
+        queue_.pop_front();
+        not_full_.notify_one();
+        return value;
+    }
+
+    // Wakes everybody up, pending items can still be popped
+    void close() {
+        std::lock_guard lock{ mutex_ };
+        closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    std::deque<T> queue_;
+    size_t capacity_{};
+    bool closed_{ false };
+};
+
+} // namespace playground
@@ -0,0 +1,292 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// x86-64 kernels are compiled for their instruction sets with target attributes and picked at run time,
+// so a default (baseline x86-64) build still uses popcnt / AVX2 / AVX-512 where the CPU has them
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PLAYGROUND_HAMMING_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace playground {
+
+namespace detail {
+
+// Hamming distances from `query` to `rows` consecutive train rows `step` bytes apart
+using HammingRows = void (*)(const uchar* query, const uchar* train, size_t step, int rows, int bytes, int* distances);
+using HammingPair = int (*)(const uchar* a, const uchar* b, int bytes);
+
+// Portable kernel, std::popcount on 64-bit words
+inline int hammingScalar(const uchar* a, const uchar* b, int bytes) {
+    int distance{ 0 };
+    int i{ 0 };
+    for (; i + 8 <= bytes; i += 8) {
+        uint64_t wa, wb;
+        std::memcpy(&wa, a + i, 8);
+        std::memcpy(&wb, b + i, 8);
+        distance += std::popcount(wa ^ wb);
+    }
+    for (; i < bytes; ++i) {
+        distance += std::popcount(static_cast<unsigned>(a[i] ^ b[i]));
+    }
+    return distance;
+}
+
+inline void hammingRowsScalar(const uchar* query, const uchar* train, size_t step, int rows, int bytes, int* distances) {
+    for (int r{ 0 }; r < rows; ++r) {
+        distances[r] = hammingScalar(query, train + r * step, bytes);
+    }
+}
+
+#if PLAYGROUND_HAMMING_DISPATCH
+// 64-bit words with the popcnt instruction, also the tail of the vector kernels
+__attribute__((target("popcnt"))) inline int hammingPopcnt(const uchar* a, const uchar* b, int bytes, int i = 0) {
+    int distance{ 0 };
+    for (; i + 8 <= bytes; i += 8) {
+        uint64_t wa, wb;
+        std::memcpy(&wa, a + i, 8);
+        std::memcpy(&wb, b + i, 8);
+        distance += static_cast<int>(_mm_popcnt_u64(wa ^ wb));
+    }
+    for (; i < bytes; ++i) {
+        distance += _mm_popcnt_u32(static_cast<unsigned>(a[i] ^ b[i]));
+    }
+    return distance;
+}
+
+// Nibble lookup popcount (Mula et al.), summed with SAD into four 64-bit lanes
+__attribute__((target("avx2,popcnt"))) inline int popcountAvx2(__m256i v) {
+    const __m256i lookup{ _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4) };
+    const __m256i low_mask{ _mm256_set1_epi8(0x0f) };
+    const __m256i lo{ _mm256_and_si256(v, low_mask) };
+    const __m256i hi{ _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask) };
+    const __m256i counts{ _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi)) };
+    const __m256i sad{ _mm256_sad_epu8(counts, _mm256_setzero_si256()) };
+    const __m128i sum{ _mm_add_epi64(_mm256_castsi256_si128(sad), _mm256_extracti128_si256(sad, 1)) };
+    return static_cast<int>(_mm_cvtsi128_si64(sum) + _mm_extract_epi64(sum, 1));
+}
+
+__attribute__((target("avx2,popcnt"))) inline int hammingAvx2(const uchar* a, const uchar* b, int bytes) {
+    int distance{ 0 };
+    int i{ 0 };
+    for (; i + 32 <= bytes; i += 32) {
+        const __m256i va{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)) };
+        const __m256i vb{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)) };
+        distance += popcountAvx2(_mm256_xor_si256(va, vb));
+    }
+    return distance + hammingPopcnt(a, b, bytes, i);
+}
+
+__attribute__((target("avx512f,avx512vl,avx512vpopcntdq,avx2,popcnt"))) inline int hammingAvx512(const uchar* a, const uchar* b, int bytes) {
+    int distance{ 0 };
+    int i{ 0 };
+    for (; i + 32 <= bytes; i += 32) {
+        const __m256i va{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)) };
+        const __m256i vb{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)) };
+        const __m256i counts{ _mm256_popcnt_epi64(_mm256_xor_si256(va, vb)) };
+        const __m128i sum{ _mm_add_epi64(_mm256_castsi256_si128(counts), _mm256_extracti128_si256(counts, 1)) };
+        distance += static_cast<int>(_mm_cvtsi128_si64(sum) + _mm_extract_epi64(sum, 1));
+    }
+    return distance + hammingPopcnt(a, b, bytes, i);
+}
+
+// Row loops carry the target too, so the per-pair kernel is inlined into them
+__attribute__((target("popcnt"))) inline void hammingRowsPopcnt(const uchar* query, const uchar* train, size_t step,
+    int rows, int bytes, int* distances) {
+    for (int r{ 0 }; r < rows; ++r) {
+        distances[r] = hammingPopcnt(query, train + r * step, bytes);
+    }
+}
+
+__attribute__((target("avx2,popcnt"))) inline void hammingRowsAvx2(const uchar* query, const uchar* train, size_t step,
+    int rows, int bytes, int* distances) {
+    for (int r{ 0 }; r < rows; ++r) {
+        distances[r] = hammingAvx2(query, train + r * step, bytes);
+    }
+}
+
+__attribute__((target("avx512f,avx512vl,avx512vpopcntdq,avx2,popcnt"))) inline void hammingRowsAvx512(const uchar* query,
+    const uchar* train, size_t step, int rows, int bytes, int* distances) {
+    for (int r{ 0 }; r < rows; ++r) {
+        distances[r] = hammingAvx512(query, train + r * step, bytes);
+    }
+}
+#endif
+
+struct HammingKernel {
+    const char* name;
+    HammingPair pair;
+    HammingRows rows;
+};
+
+// Best kernel the CPU supports, picked on first use
+inline const HammingKernel& hammingKernel() {
+    static const HammingKernel kernel{ [] {
+#if PLAYGROUND_HAMMING_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512vpopcntdq") && __builtin_cpu_supports("avx512vl")) {
+            return HammingKernel{ "avx512-vpopcntdq", hammingAvx512, hammingRowsAvx512 };
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+            return HammingKernel{ "avx2", hammingAvx2, hammingRowsAvx2 };
+        }
+        if (__builtin_cpu_supports("popcnt")) {
+            return HammingKernel{ "popcnt", [](const uchar* a, const uchar* b, int bytes) { return hammingPopcnt(a, b, bytes); },
+                hammingRowsPopcnt };
+        }
+#endif
+        return HammingKernel{ "scalar", hammingScalar, hammingRowsScalar };
+    }() };
+    return kernel;
+}
+
+// Hamming distance between two binary descriptors of `bytes` length
+inline int hammingDistance(const uchar* a, const uchar* b, int bytes) {
+    return hammingKernel().pair(a, b, bytes);
+}
+
+// Train rows per block: 256 ORB descriptors = 8 KB, stays in L1 while a block of queries runs over it
+inline constexpr int train_block{ 256 };
+inline constexpr int query_block{ 32 };
+
+// Keeps the k smallest distances of one query, sorted ascending
+struct BestK {
+    std::vector<int> distance;
+    std::vector<int> index;
+
+    explicit BestK(int k) : distance(k, INT_MAX), index(k, -1) {}
+
+    void push(int d, int idx) {
+        const int k{ static_cast<int>(distance.size()) };
+        if (d >= distance[k - 1]) {
+            return;
+        }
+        int pos{ k - 1 };
+        while (pos > 0 && distance[pos - 1] > d) {
+            distance[pos] = distance[pos - 1];
+            index[pos] = index[pos - 1];
+            --pos;
+        }
+        distance[pos] = d;
+        index[pos] = idx;
+    }
+};
+
+} // namespace detail
+
+// Brute-force matcher for binary descriptors (ORB, BRISK, AKAZE...) with popcount Hamming distance.
+// Query and train rows are processed in blocks for cache reuse and query blocks run in parallel.
+// AVX-512 VPOPCNTDQ, AVX2 or popcnt are picked at run time from what the CPU supports, std::popcount otherwise.
+class HammingMatcher {
+public:
+    // k nearest train rows for every query row, sorted by distance
+    static void knnMatch(const cv::Mat& query, const cv::Mat& train,
+        std::vector<std::vector<cv::DMatch>>& matches, int k) {
+        if (query.empty()) {
+            matches.clear();
+            return;
+        }
+        check(query, train);
+        matches.assign(query.rows, {});
+        if (train.empty() || k <= 0) {
+            return;
+        }
+        k = std::min(k, train.rows);
+
+        const int blocks{ (query.rows + detail::query_block - 1) / detail::query_block };
+        const auto rows_kernel{ detail::hammingKernel().rows };
+        cv::parallel_for_(cv::Range(0, blocks), [&](const cv::Range& range) {
+            std::vector<int> distances(detail::train_block);
+            for (int b{ range.start }; b < range.end; ++b) {
+                const int q0{ b * detail::query_block };
+                const int q1{ std::min(q0 + detail::query_block, query.rows) };
+                std::vector<detail::BestK> best(q1 - q0, detail::BestK{ k });
+
+                for (int t0{ 0 }; t0 < train.rows; t0 += detail::train_block) {
+                    const int t1{ std::min(t0 + detail::train_block, train.rows) };
+                    for (int q{ q0 }; q < q1; ++q) {
+                        rows_kernel(query.ptr<uchar>(q), train.ptr<uchar>(t0), train.step, t1 - t0, query.cols, distances.data());
+                        auto& state{ best[q - q0] };
+                        for (int t{ t0 }; t < t1; ++t) {
+                            state.push(distances[t - t0], t);
+                        }
+                    }
+                }
+
+                for (int q{ q0 }; q < q1; ++q) {
+                    const auto& state{ best[q - q0] };
+                    auto& out{ matches[q] };
+                    out.reserve(k);
+                    for (int i{ 0 }; i < k && state.index[i] >= 0; ++i) {
+                        out.emplace_back(q, state.index[i], static_cast<float>(state.distance[i]));
+                    }
+                }
+            }
+        });
+    }
+
+    // Best train row for every query row. With cross_check only pairs that are mutual best matches are kept.
+    static void match(const cv::Mat& query, const cv::Mat& train, std::vector<cv::DMatch>& matches,
+        bool cross_check = false) {
+        std::vector<std::vector<cv::DMatch>> knn;
+        knnMatch(query, train, knn, 1);
+
+        std::vector<int> reverse;
+        if (cross_check) {
+            std::vector<std::vector<cv::DMatch>> back;
+            knnMatch(train, query, back, 1);
+            reverse.assign(train.rows, -1);
+            for (const auto& m : back) {
+                if (!m.empty()) {
+                    reverse[m[0].queryIdx] = m[0].trainIdx;
+                }
+            }
+        }
+
+        matches.clear();
+        matches.reserve(knn.size());
+        for (const auto& m : knn) {
+            if (m.empty()) {
+                continue;
+            }
+            if (cross_check && reverse[m[0].trainIdx] != m[0].queryIdx) {
+                continue;
+            }
+            matches.push_back(m[0]);
+        }
+    }
+
+    // Kernel the distances run on: "avx512-vpopcntdq", "avx2", "popcnt" or "scalar"
+    static const char* kernelName() { return detail::hammingKernel().name; }
+
+    // Keeps the best `fraction` of matches, sorted by distance. Only the kept part gets sorted.
+    static void keepBest(std::vector<cv::DMatch>& matches, float fraction) {
+        const auto take{ std::min(matches.size(), static_cast<size_t>(matches.size() * fraction)) };
+        std::ranges::nth_element(matches, matches.begin() + take, std::less{});
+        matches.resize(take);
+        std::ranges::sort(matches, std::less{});
+    }
+
+private:
+    static void check(const cv::Mat& query, const cv::Mat& train) {
+        if (query.type() != CV_8U || (!train.empty() && (train.type() != CV_8U || train.cols != query.cols))) {
+            throw std::runtime_error("HammingMatcher requires CV_8U descriptors of equal length!\n");
+        }
+    }
+};
+
+} // namespace playground
@@ -0,0 +1,157 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "hamming_matcher.hpp"
+
+namespace playground {
+
+// Multi-probe LSH index over binary descriptors. Every table hashes a descriptor by sampling `key_bits`
+// of its bits, a query visits its own bucket and all buckets within `probe_radius` bit flips of it.
+// Candidates are verified with the popcount Hamming distance from hamming_matcher.hpp.
+// The index keeps a reference to the descriptors, so they must outlive it.
+class LshIndex {
+public:
+    explicit LshIndex(const cv::Mat& descriptors,
+        int tables = 8,
+        int key_bits = 16,
+        int probe_radius = 1,
+        unsigned seed = 0x5eed
+    ) :
+        descriptors_(descriptors),
+        key_bits_(key_bits),
+        probe_radius_(probe_radius) {
+        if (!descriptors_.empty() && descriptors_.type() != CV_8U) {
+            throw std::runtime_error("LshIndex requires CV_8U descriptors!\n");
+        }
+        if (key_bits_ < 1 || key_bits_ > 24 || probe_radius_ < 0 || probe_radius_ > 2) {
+            throw std::runtime_error("LshIndex supports 1-24 key bits and a probe radius of 0-2!\n");
+        }
+        if (descriptors_.empty()) {
+            return;
+        }
+
+        std::mt19937 rng{ seed };
+        std::vector<int> all_bits(descriptors_.cols * 8);
+        std::iota(all_bits.begin(), all_bits.end(), 0);
+        key_bits_ = std::min(key_bits_, static_cast<int>(all_bits.size()));
+
+        const size_t buckets{ size_t{ 1 } << key_bits_ };
+        std::vector<uint32_t> keys(descriptors_.rows);
+        tables_.resize(tables);
+        for (auto& table : tables_) {
+            std::ranges::shuffle(all_bits, rng);
+            table.bits.assign(all_bits.begin(), all_bits.begin() + key_bits_);
+
+            // Buckets stored as one index array with per-bucket offsets
+            table.offsets.assign(buckets + 1, 0);
+            for (int r{ 0 }; r < descriptors_.rows; ++r) {
+                keys[r] = key(table, descriptors_.ptr<uchar>(r));
+                ++table.offsets[keys[r] + 1];
+            }
+            std::partial_sum(table.offsets.begin(), table.offsets.end(), table.offsets.begin());
+
+            table.indices.resize(descriptors_.rows);
+            std::vector<int> fill(table.offsets.begin(), table.offsets.end() - 1);
+            for (int r{ 0 }; r < descriptors_.rows; ++r) {
+                table.indices[fill[keys[r]]++] = r;
+            }
+        }
+    }
+
+    // Up to k approximate nearest neighbours for every query row, sorted by distance
+    void knnMatch(const cv::Mat& query, std::vector<std::vector<cv::DMatch>>& matches, int k) const {
+        matches.assign(query.rows, {});
+        if (query.empty() || descriptors_.empty() || k <= 0) {
+            return;
+        }
+        if (query.type() != CV_8U || query.cols != descriptors_.cols) {
+            throw std::runtime_error("LshIndex query descriptors don't match the index!\n");
+        }
+
+        cv::parallel_for_(cv::Range(0, query.rows), [&](const cv::Range& range) {
+            // Generation stamps avoid clearing the visited set for every query
+            std::vector<uint32_t> visited(descriptors_.rows, 0);
+            uint32_t stamp{ 0 };
+            std::vector<uint32_t> probes;
+
+            for (int q{ range.start }; q < range.end; ++q) {
+                const uchar* qd{ query.ptr<uchar>(q) };
+                detail::BestK best{ k };
+                ++stamp;
+
+                for (const auto& table : tables_) {
+                    probeKeys(key(table, qd), probes);
+                    for (uint32_t probe : probes) {
+                        for (int i{ table.offsets[probe] }; i < table.offsets[probe + 1]; ++i) {
+                            const int t{ table.indices[i] };
+                            if (visited[t] == stamp) {
+                                continue;
+                            }
+                            visited[t] = stamp;
+                            best.push(detail::hammingDistance(qd, descriptors_.ptr<uchar>(t), descriptors_.cols), t);
+                        }
+                    }
+                }
+
+                auto& out{ matches[q] };
+                for (int i{ 0 }; i < k && best.index[i] >= 0; ++i) {
+                    out.emplace_back(q, best.index[i], static_cast<float>(best.distance[i]));
+                }
+            }
+        });
+    }
+
+    int size() const { return descriptors_.rows; }
+
+private:
+    struct Table {
+        std::vector<int> bits;
+        std::vector<int> offsets;
+        std::vector<int> indices;
+    };
+
+    cv::Mat descriptors_;
+    std::vector<Table> tables_;
+    int key_bits_{};
+    int probe_radius_{};
+
+    static uint32_t key(const Table& table, const uchar* descriptor) {
+        uint32_t k{ 0 };
+        for (size_t j{ 0 }; j < table.bits.size(); ++j) {
+            const int bit{ table.bits[j] };
+            k |= static_cast<uint32_t>((descriptor[bit >> 3] >> (bit & 7)) & 1) << j;
+        }
+        return k;
+    }
+
+    void probeKeys(uint32_t k, std::vector<uint32_t>& probes) const {
+        probes.clear();
+        probes.push_back(k);
+        if (probe_radius_ >= 1) {
+            for (int i{ 0 }; i < key_bits_; ++i) {
+                probes.push_back(k ^ (1u << i));
+            }
+        }
+        if (probe_radius_ >= 2) {
+            for (int i{ 0 }; i < key_bits_; ++i) {
+                for (int j{ i + 1 }; j < key_bits_; ++j) {
+                    probes.push_back(k ^ (1u << i) ^ (1u << j));
+                }
+            }
+        }
+    }
+};
+
+} // namespace playground
@@ -0,0 +1,77 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <filesystem>
+#include <format>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <fstream>
+#include <iterator>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace playground {
+
+// Read-only view of a whole file, memory-mapped where the platform allows it
+class MappedFile {
+public:
+    explicit MappedFile(const std::filesystem::path& path) {
+#if defined(_WIN32)
+        std::ifstream file{ path, std::ios::binary };
+        if (!file) {
+            throw std::runtime_error(std::format("Can't open file: {}", path.string()));
+        }
+        buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+        data_ = reinterpret_cast<const uchar*>(buffer_.data());
+        size_ = buffer_.size();
+#else
+        int fd{ ::open(path.c_str(), O_RDONLY) };
+        if (fd < 0) {
+            throw std::runtime_error(std::format("Can't open file: {}", path.string()));
+        }
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 or st.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error(std::format("Can't read file: {}", path.string()));
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* mapped{ ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0) };
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            throw std::runtime_error(std::format("Can't map file: {}", path.string()));
+        }
+        data_ = static_cast<const uchar*>(mapped);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#if !defined(_WIN32)
+        ::munmap(const_cast<uchar*>(data_), size_);
+#endif
+    }
+
+    const uchar* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+#if defined(_WIN32)
+    std::vector<char> buffer_;
+#endif
+    const uchar* data_{ nullptr };
+    size_t size_{};
+};
+
+} // namespace playground
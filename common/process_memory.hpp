@@ -0,0 +1,46 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+
+namespace playground {
+
+// Resident set size of this process in bytes, now and at its peak (VmRSS / VmHWM from /proc/self/status).
+// Both are 0 where /proc isn't available.
+struct MemoryUsage {
+    size_t current{};
+    size_t peak{};
+};
+
+inline MemoryUsage memoryUsage() {
+    MemoryUsage usage;
+#if defined(__linux__)
+    std::ifstream status{ "/proc/self/status" };
+    std::string key;
+    size_t kb{};
+    while (status >> key) {
+        if (key == "VmRSS:" and status >> kb) {
+            usage.current = kb * 1024;
+        }
+        else if (key == "VmHWM:" and status >> kb) {
+            usage.peak = kb * 1024;
+        }
+    }
+#endif
+    return usage;
+}
+
+// Restarts the peak at the current RSS, so the next peak belongs to the work done after this call.
+// Linux only (clear_refs "5"), elsewhere the peak keeps covering the whole process.
+inline void resetPeakMemory() {
+#if defined(__linux__)
+    std::ofstream{ "/proc/self/clear_refs" } << "5";
+#endif
+}
+
+} // namespace playground
@@ -0,0 +1,125 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/calib3d.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace playground {
+
+enum class RobustEstimator {
+    // Classic RANSAC, cv::RANSAC
+    Ransac,
+    // USAC with MAGSAC++ scoring, no hard inlier threshold to tune
+    Magsac,
+    // USAC with PROSAC sampling: points must be ordered best match first (e.g. by descriptor distance)
+    Prosac,
+    // USAC with local optimization (GC-RANSAC) and SPRT
+    Accurate
+};
+
+inline constexpr std::array<std::pair<std::string_view, RobustEstimator>, 4> robust_estimators{ {
+    { "ransac", RobustEstimator::Ransac },
+    { "magsac", RobustEstimator::Magsac },
+    { "prosac", RobustEstimator::Prosac },
+    { "accurate", RobustEstimator::Accurate },
+} };
+
+inline std::string_view toString(RobustEstimator estimator) {
+    return std::ranges::find(robust_estimators, estimator, &std::pair<std::string_view, RobustEstimator>::second)->first;
+}
+
+// Estimator names joined by `separator`, for error messages and usage lines
+inline std::string robustEstimatorNames(std::string_view separator = " | ") {
+    std::string names;
+    for (const auto& [name, estimator] : robust_estimators) {
+        if (!names.empty()) {
+            names += separator;
+        }
+        names += name;
+    }
+    return names;
+}
+
+inline RobustEstimator parseRobustEstimator(std::string_view name) {
+    auto it{ std::ranges::find(robust_estimators, name, &std::pair<std::string_view, RobustEstimator>::first) };
+    if (it == robust_estimators.end()) {
+        throw std::runtime_error(std::format("Unknown estimator: {} ({})", name, robustEstimatorNames(", ")));
+    }
+    return it->second;
+}
+
+inline int toOpenCvMethod(RobustEstimator estimator) {
+    switch (estimator) {
+    case RobustEstimator::Magsac:
+        return cv::USAC_MAGSAC;
+    case RobustEstimator::Prosac:
+        return cv::USAC_PROSAC;
+    case RobustEstimator::Accurate:
+        return cv::USAC_ACCURATE;
+    default:
+        return cv::RANSAC;
+    }
+}
+
+// Telemetry of one robust fit
+struct HomographyStats {
+    // OpenCV doesn't expose the iterations it ran. This is the adaptive stopping bound
+    // log(1 - confidence) / log(1 - w^4) for the final inlier ratio w, capped at max_iters,
+    // which is where both RANSAC and USAC terminate.
+    int iteration_bound{};
+    double inlier_ratio{};
+    double ms{};
+
+    void print(RobustEstimator estimator, std::string_view label = "homography") const {
+        std::println("{} [{}]: ~{} iterations (adaptive bound), {:.1f}% inliers, {:.3f} ms",
+            label, toString(estimator), iteration_bound, 100.0 * inlier_ratio, ms);
+    }
+};
+
+inline int adaptiveIterations(double inlier_ratio, double confidence, int max_iters) {
+    const double all_inliers{ std::pow(inlier_ratio, 4.0) };
+    if (all_inliers >= 1.0) {
+        return 1;
+    }
+    if (all_inliers <= 0.0) {
+        return max_iters;
+    }
+    const double n{ std::ceil(std::log(1.0 - confidence) / std::log(1.0 - all_inliers)) };
+    return static_cast<int>(std::clamp(n, 1.0, static_cast<double>(max_iters)));
+}
+
+// cv::findHomography with a selectable estimator. Fills `stats` when given.
+inline cv::Mat findHomography(cv::InputArray src,
+    cv::InputArray dst,
+    RobustEstimator estimator,
+    double threshold,
+    cv::Mat& mask,
+    HomographyStats* stats = nullptr,
+    int max_iters = 2000,
+    double confidence = 0.995) {
+    auto start{ std::chrono::steady_clock::now() };
+    cv::Mat h{ cv::findHomography(src, dst, toOpenCvMethod(estimator), threshold, mask, max_iters, confidence) };
+    if (stats) {
+        stats->ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        stats->inlier_ratio = h.empty() or src.empty() ? 0.0
+            : static_cast<double>(cv::countNonZero(mask)) / static_cast<double>(src.total());
+        stats->iteration_bound = adaptiveIterations(stats->inlier_ratio, confidence, max_iters);
+    }
+    return h;
+}
+
+} // namespace playground
@@ -0,0 +1,95 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <print>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace playground {
+
+// Collects wall-clock samples per named pipeline stage and prints a summary.
+// Stages are reported in the order they were first recorded.
+class StageTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Adds the lifetime of the returned object to `stage`
+    class Scope {
+    public:
+        Scope(StageTimer& timer, std::string_view stage) : timer_(timer), stage_(stage), start_(Clock::now()) {}
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope() {
+            timer_.add(stage_, std::chrono::duration<double, std::milli>(Clock::now() - start_).count());
+        }
+
+    private:
+        StageTimer& timer_;
+        std::string_view stage_;
+        Clock::time_point start_;
+    };
+
+    [[nodiscard]] Scope measure(std::string_view stage) {
+        return Scope{ *this, stage };
+    }
+
+    void add(std::string_view stage, double ms) {
+        auto it{ std::ranges::find(stages_, stage, &Stage::first) };
+        if (it == stages_.end()) {
+            stages_.emplace_back(std::string{ stage }, std::vector<double>{});
+            it = std::prev(stages_.end());
+        }
+        it->second.push_back(ms);
+    }
+
+    // Samples of a stage, empty if it was never recorded
+    const std::vector<double>& samples(std::string_view stage) const {
+        static const std::vector<double> empty;
+        auto it{ std::ranges::find(stages_, stage, &Stage::first) };
+        return it == stages_.end() ? empty : it->second;
+    }
+
+    // Value below which `p` (0..1) of the samples fall
+    static double percentile(std::vector<double> values, double p) {
+        if (values.empty()) {
+            return 0.0;
+        }
+        auto idx{ static_cast<size_t>(p * static_cast<double>(values.size() - 1) + 0.5) };
+        std::ranges::nth_element(values, values.begin() + idx);
+        return values[idx];
+    }
+
+    void print() const {
+        std::println("{:<24} {:>7} {:>9} {:>9} {:>9} {:>9}", "stage", "calls", "mean ms", "p50 ms", "p95 ms", "max ms");
+        for (const auto& [name, values] : stages_) {
+            double sum{ 0.0 };
+            for (double v : values) {
+                sum += v;
+            }
+            std::println("{:<24} {:>7} {:>9.3f} {:>9.3f} {:>9.3f} {:>9.3f}",
+                name,
+                values.size(),
+                sum / static_cast<double>(values.size()),
+                percentile(values, 0.5),
+                percentile(values, 0.95),
+                std::ranges::max(values));
+        }
+    }
+
+    void clear() {
+        stages_.clear();
+    }
+
+private:
+    using Stage = std::pair<std::string, std::vector<double>>;
+    std::vector<Stage> stages_;
+};
+
+} // namespace playground
@@ -0,0 +1,117 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+namespace playground {
+
+// Grid for tiled feature extraction. The number of tiles follows from the image size,
+// every tile is detected on its cell grown by at least `overlap` pixels. The overlap actually used
+// is the larger of it and detectorBorder(), so keypoints near cell borders are kept at every scale.
+struct TileGrid {
+    int cell_size{ 384 };
+    int overlap{ 32 };
+
+    int cols(cv::Size size) const { return std::max(1, (size.width + cell_size / 2) / cell_size); }
+    int rows(cv::Size size) const { return std::max(1, (size.height + cell_size / 2) / cell_size); }
+};
+
+// Pixels (in image coordinates) along the border in which a detector drops keypoints or samples outside
+// of its image. ORB discards keypoints within edgeThreshold of each pyramid level and describes them with a
+// patchSize patch at that level, so the coarsest level needs
+// max(edgeThreshold, patchSize / 2) * scaleFactor^(nlevels - 1) pixels (~111 px with the defaults). 0 for detectors without these parameters, their TileGrid overlap has to cover them.
+inline int detectorBorder(const cv::Feature2D& detector) {
+    // Rounding of keypoint coordinates between pyramid levels
+    constexpr int margin{ 4 };
+    if (const auto* orb{ dynamic_cast<const cv::ORB*>(&detector) }) {
+        const double top_scale{ std::pow(orb->getScaleFactor(), orb->getNLevels() - 1) };
+        return static_cast<int>(std::ceil(std::max(orb->getEdgeThreshold(), orb->getPatchSize() / 2) * top_scale)) + margin;
+    }
+    return 0;
+}
+
+// Creates a detector limited to `max_features` keypoints, e.g. [](int n) { return cv::ORB::create(n); }
+using FeatureFactory = std::function<cv::Ptr<cv::Feature2D>(int)>;
+
+// detectAndCompute over an overlapping grid, tiles run in parallel. Every tile keeps only the keypoints
+// inside its own cell, so overlaps produce no duplicates, and only its `max_features / tiles` strongest ones,
+// so textured areas can't take the whole budget. Output is ordered by tile, independent of scheduling.
+inline void detectAndComputeTiled(const cv::Mat& image,
+    const FeatureFactory& create,
+    int max_features,
+    std::vector<cv::KeyPoint>& keypoints,
+    cv::Mat& descriptors,
+    const TileGrid& grid = {}) {
+    const int cols{ grid.cols(image.size()) };
+    const int rows{ grid.rows(image.size()) };
+    const int tiles{ cols * rows };
+    const int budget{ std::max(1, (max_features + tiles - 1) / tiles) };
+    const cv::Rect bounds{ 0, 0, image.cols, image.rows };
+    const int overlap{ std::max(grid.overlap, detectorBorder(*create(budget))) };
+
+    struct Tile {
+        std::vector<cv::KeyPoint> keypoints;
+        cv::Mat descriptors;
+    };
+    std::vector<Tile> results(tiles);
+
+    cv::parallel_for_(cv::Range(0, tiles), [&](const cv::Range& range) {
+        // Detectors are not shared between threads. Tiles over-detect so the cell filter leaves enough.
+        cv::Ptr<cv::Feature2D> detector{ create(2 * budget) };
+        for (int t{ range.start }; t < range.end; ++t) {
+            const int x0{ image.cols * (t % cols) / cols };
+            const int x1{ image.cols * (t % cols + 1) / cols };
+            const int y0{ image.rows * (t / cols) / rows };
+            const int y1{ image.rows * (t / cols + 1) / rows };
+            const cv::Rect cell{ x0, y0, x1 - x0, y1 - y0 };
+            const cv::Rect padded{ cv::Rect(x0 - overlap, y0 - overlap,
+                cell.width + 2 * overlap, cell.height + 2 * overlap) & bounds };
+            const cv::Point2f offset{ static_cast<float>(padded.x), static_cast<float>(padded.y) };
+
+            auto& tile{ results[t] };
+            detector->detect(image(padded), tile.keypoints);
+            std::erase_if(tile.keypoints, [&](const cv::KeyPoint& k) {
+                return !cell.contains(cv::Point(cvFloor(k.pt.x + offset.x), cvFloor(k.pt.y + offset.y)));
+            });
+            cv::KeyPointsFilter::retainBest(tile.keypoints, budget);
+            if (tile.keypoints.empty()) {
+                continue;
+            }
+
+            detector->compute(image(padded), tile.keypoints, tile.descriptors);
+            for (auto& k : tile.keypoints) {
+                k.pt += offset;
+            }
+        }
+    });
+
+    keypoints.clear();
+    descriptors.release();
+    for (auto& tile : results) {
+        keypoints.insert(keypoints.end(), tile.keypoints.begin(), tile.keypoints.end());
+        if (!tile.descriptors.empty()) {
+            descriptors.push_back(tile.descriptors);
+        }
+    }
+}
+
+// Share of the cells of a cells x cells grid that hold at least one keypoint, 1.0 for a uniform spread
+inline double gridCoverage(const std::vector<cv::KeyPoint>& keypoints, cv::Size size, int cells = 8) {
+    std::vector<char> occupied(cells * cells, 0);
+    for (const auto& k : keypoints) {
+        const int cx{ std::clamp(static_cast<int>(k.pt.x * cells / size.width), 0, cells - 1) };
+        const int cy{ std::clamp(static_cast<int>(k.pt.y * cells / size.height), 0, cells - 1) };
+        occupied[cy * cells + cx] = 1;
+    }
+    return static_cast<double>(std::ranges::count(occupied, 1)) / static_cast<double>(occupied.size());
+}
+
+} // namespace playground
@@ -0,0 +1,309 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <vector>
+
+namespace playground {
+
+enum class WarpInterpolation {
+    Linear,
+    Cubic
+};
+
+// Outside of the source: black (cv::BORDER_CONSTANT) or the nearest edge pixel (cv::BORDER_REPLICATE)
+enum class WarpBorder {
+    Constant,
+    Replicate
+};
+
+namespace detail {
+
+// Sub-pixel precision of source coordinates, same as OpenCV's INTER_BITS
+inline constexpr int warp_bits{ 5 };
+inline constexpr int warp_tab_size{ 1 << warp_bits };
+inline constexpr int warp_tab_mask{ warp_tab_size - 1 };
+
+// Bilinear weights are products of two warp_bits fractions
+inline constexpr int linear_bits{ 2 * warp_bits };
+
+// Fixed-point precision of a single cubic tap, the 2D result has 2 * cubic_bits
+inline constexpr int cubic_bits{ 10 };
+
+// Coordinates further than this are outside of any image and only need to stay in int range
+inline constexpr float coord_limit{ 1e9f };
+
+// Keys cubic kernel (a = -0.75, as in cv::INTER_CUBIC) sampled at warp_tab_size fractions
+inline const std::array<std::array<int, 4>, warp_tab_size>& cubicTable() {
+    static const auto table = [] {
+        std::array<std::array<int, 4>, warp_tab_size> t{};
+        constexpr float a{ -0.75f };
+        for (int i{ 0 }; i < warp_tab_size; ++i) {
+            const float x{ static_cast<float>(i) / warp_tab_size };
+            std::array<float, 4> w{
+                ((a * (x + 1) - 5 * a) * (x + 1) + 8 * a) * (x + 1) - 4 * a,
+                ((a + 2) * x - (a + 3)) * x * x + 1,
+                ((a + 2) * (1 - x) - (a + 3)) * (1 - x) * (1 - x) + 1,
+                0.0f
+            };
+            w[3] = 1.0f - w[0] - w[1] - w[2];
+
+            int sum{ 0 };
+            for (int k{ 0 }; k < 4; ++k) {
+                t[i][k] = cvRound(w[k] * (1 << cubic_bits));
+                sum += t[i][k];
+            }
+            // Put the rounding error into the dominant tap so the weights sum exactly to one
+            t[i][x < 0.5f ? 1 : 2] += (1 << cubic_bits) - sum;
+        }
+        return t;
+    }();
+    return table;
+}
+
+// Maps `count` destination pixels starting at (x0, y) to fixed-point source coordinates.
+// The projection is evaluated once per row in double and then stepped incrementally,
+// several lanes at a time when universal intrinsics are available.
+inline void mapRow(const cv::Matx33d& m, int x0, int y, int count, int* xs, int* ys, int* fxs, int* fys) {
+    const double X0{ m(0, 0) * x0 + m(0, 1) * y + m(0, 2) };
+    const double Y0{ m(1, 0) * x0 + m(1, 1) * y + m(1, 2) };
+    const double W0{ m(2, 0) * x0 + m(2, 1) * y + m(2, 2) };
+
+    int i{ 0 };
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int lanes{ cv::VTraits<cv::v_float32>::vlanes() };
+    float lane_offsets[cv::VTraits<cv::v_float32>::max_nlanes];
+    for (int k{ 0 }; k < lanes; ++k) {
+        lane_offsets[k] = static_cast<float>(k);
+    }
+    const cv::v_float32 v_offsets{ cv::vx_load(lane_offsets) };
+
+    const cv::v_float32 v_X0{ cv::vx_setall_f32(static_cast<float>(X0)) };
+    const cv::v_float32 v_Y0{ cv::vx_setall_f32(static_cast<float>(Y0)) };
+    const cv::v_float32 v_W0{ cv::vx_setall_f32(static_cast<float>(W0)) };
+    const cv::v_float32 v_dX{ cv::vx_setall_f32(static_cast<float>(m(0, 0))) };
+    const cv::v_float32 v_dY{ cv::vx_setall_f32(static_cast<float>(m(1, 0))) };
+    const cv::v_float32 v_dW{ cv::vx_setall_f32(static_cast<float>(m(2, 0))) };
+
+    const cv::v_float32 v_zero{ cv::vx_setzero_f32() };
+    const cv::v_float32 v_scale{ cv::vx_setall_f32(static_cast<float>(warp_tab_size)) };
+    const cv::v_float32 v_hi{ cv::vx_setall_f32(coord_limit) };
+    const cv::v_float32 v_lo{ cv::vx_setall_f32(-coord_limit) };
+    const cv::v_int32 v_mask{ cv::vx_setall_s32(warp_tab_mask) };
+
+    for (; i <= count - lanes; i += lanes) {
+        const cv::v_float32 v_i{ cv::v_add(cv::vx_setall_f32(static_cast<float>(i)), v_offsets) };
+        const cv::v_float32 v_W{ cv::v_fma(v_dW, v_i, v_W0) };
+        const cv::v_float32 v_inv{ cv::v_select(cv::v_ne(v_W, v_zero), cv::v_div(v_scale, v_W), v_zero) };
+
+        const cv::v_float32 v_X{ cv::v_min(cv::v_max(cv::v_mul(cv::v_fma(v_dX, v_i, v_X0), v_inv), v_lo), v_hi) };
+        const cv::v_float32 v_Y{ cv::v_min(cv::v_max(cv::v_mul(cv::v_fma(v_dY, v_i, v_Y0), v_inv), v_lo), v_hi) };
+
+        const cv::v_int32 v_ix{ cv::v_round(v_X) };
+        const cv::v_int32 v_iy{ cv::v_round(v_Y) };
+        cv::v_store(xs + i, cv::v_shr<warp_bits>(v_ix));
+        cv::v_store(ys + i, cv::v_shr<warp_bits>(v_iy));
+        cv::v_store(fxs + i, cv::v_and(v_ix, v_mask));
+        cv::v_store(fys + i, cv::v_and(v_iy, v_mask));
+    }
+#endif
+    for (; i < count; ++i) {
+        const double W{ W0 + m(2, 0) * i };
+        const double inv{ W != 0.0 ? warp_tab_size / W : 0.0 };
+        const double X{ std::clamp((X0 + m(0, 0) * i) * inv, static_cast<double>(-coord_limit), static_cast<double>(coord_limit)) };
+        const double Y{ std::clamp((Y0 + m(1, 0) * i) * inv, static_cast<double>(-coord_limit), static_cast<double>(coord_limit)) };
+        const int ix{ cvRound(X) };
+        const int iy{ cvRound(Y) };
+        xs[i] = ix >> warp_bits;
+        ys[i] = iy >> warp_bits;
+        fxs[i] = ix & warp_tab_mask;
+        fys[i] = iy & warp_tab_mask;
+    }
+}
+
+// Reads a source pixel channel, outside of the image black or clamped to the nearest edge
+template <int cn>
+inline int borderPixel(const cv::Mat& src, int x, int y, int c, WarpBorder border) {
+    if (border == WarpBorder::Replicate) {
+        x = std::clamp(x, 0, src.cols - 1);
+        y = std::clamp(y, 0, src.rows - 1);
+    }
+    else if (static_cast<unsigned>(x) >= static_cast<unsigned>(src.cols) ||
+        static_cast<unsigned>(y) >= static_cast<unsigned>(src.rows)) {
+        return 0;
+    }
+    return src.ptr<uchar>(y)[x * cn + c];
+}
+
+template <int cn>
+void warpTileLinear(const cv::Mat& src, cv::Mat& dst, const cv::Matx33d& m, const cv::Rect& tile, WarpBorder border,
+    int* buffer) {
+    int* xs{ buffer };
+    int* ys{ xs + tile.width };
+    int* fxs{ ys + tile.width };
+    int* fys{ fxs + tile.width };
+    const size_t step{ src.step };
+
+    for (int y{ tile.y }; y < tile.y + tile.height; ++y) {
+        mapRow(m, tile.x, y, tile.width, xs, ys, fxs, fys);
+        uchar* d{ dst.ptr<uchar>(y) + tile.x * cn };
+
+        for (int i{ 0 }; i < tile.width; ++i, d += cn) {
+            const int sx{ xs[i] };
+            const int sy{ ys[i] };
+            const int fx{ fxs[i] };
+            const int fy{ fys[i] };
+            const int w00{ (warp_tab_size - fx) * (warp_tab_size - fy) };
+            const int w01{ fx * (warp_tab_size - fy) };
+            const int w10{ (warp_tab_size - fx) * fy };
+            const int w11{ fx * fy };
+
+            if (static_cast<unsigned>(sx) < static_cast<unsigned>(src.cols - 1) &&
+                static_cast<unsigned>(sy) < static_cast<unsigned>(src.rows - 1)) {
+                const uchar* p0{ src.ptr<uchar>(sy) + sx * cn };
+                const uchar* p1{ p0 + step };
+                for (int c{ 0 }; c < cn; ++c) {
+                    d[c] = static_cast<uchar>((p0[c] * w00 + p0[c + cn] * w01 + p1[c] * w10 + p1[c + cn] * w11 +
+                        (1 << (linear_bits - 1))) >> linear_bits);
+                }
+            }
+            else if (border == WarpBorder::Replicate || (sx >= -1 && sx < src.cols && sy >= -1 && sy < src.rows)) {
+                for (int c{ 0 }; c < cn; ++c) {
+                    const int sum{ borderPixel<cn>(src, sx, sy, c, border) * w00 + borderPixel<cn>(src, sx + 1, sy, c, border) * w01 +
+                        borderPixel<cn>(src, sx, sy + 1, c, border) * w10 + borderPixel<cn>(src, sx + 1, sy + 1, c, border) * w11 };
+                    d[c] = static_cast<uchar>((sum + (1 << (linear_bits - 1))) >> linear_bits);
+                }
+            }
+            else {
+                std::fill_n(d, cn, uchar{ 0 });
+            }
+        }
+    }
+}
+
+template <int cn>
+void warpTileCubic(const cv::Mat& src, cv::Mat& dst, const cv::Matx33d& m, const cv::Rect& tile, WarpBorder border,
+    int* buffer) {
+    int* xs{ buffer };
+    int* ys{ xs + tile.width };
+    int* fxs{ ys + tile.width };
+    int* fys{ fxs + tile.width };
+    const auto& table{ cubicTable() };
+    constexpr int half{ 1 << (2 * cubic_bits - 1) };
+
+    for (int y{ tile.y }; y < tile.y + tile.height; ++y) {
+        mapRow(m, tile.x, y, tile.width, xs, ys, fxs, fys);
+        uchar* d{ dst.ptr<uchar>(y) + tile.x * cn };
+
+        for (int i{ 0 }; i < tile.width; ++i, d += cn) {
+            const int sx{ xs[i] - 1 };
+            const int sy{ ys[i] - 1 };
+            if (border == WarpBorder::Constant && (sx <= -4 || sx >= src.cols || sy <= -4 || sy >= src.rows)) {
+                std::fill_n(d, cn, uchar{ 0 });
+                continue;
+            }
+
+            const auto& wx{ table[fxs[i]] };
+            const auto& wy{ table[fys[i]] };
+            const bool inside{ sx >= 0 && sx + 3 < src.cols && sy >= 0 && sy + 3 < src.rows };
+
+            for (int c{ 0 }; c < cn; ++c) {
+                int sum{ 0 };
+                for (int r{ 0 }; r < 4; ++r) {
+                    int row_sum{ 0 };
+                    if (inside) {
+                        const uchar* p{ src.ptr<uchar>(sy + r) + sx * cn + c };
+                        row_sum = p[0] * wx[0] + p[cn] * wx[1] + p[2 * cn] * wx[2] + p[3 * cn] * wx[3];
+                    }
+                    else {
+                        for (int k{ 0 }; k < 4; ++k) {
+                            row_sum += borderPixel<cn>(src, sx + k, sy + r, c, border) * wx[k];
+                        }
+                    }
+                    sum += row_sum * wy[r];
+                }
+                d[c] = cv::saturate_cast<uchar>((sum + half) >> (2 * cubic_bits));
+            }
+        }
+    }
+}
+
+template <int cn>
+void warpTile(const cv::Mat& src, cv::Mat& dst, const cv::Matx33d& m, const cv::Rect& tile,
+    WarpInterpolation interpolation, WarpBorder border, int* buffer) {
+    if (interpolation == WarpInterpolation::Cubic) {
+        warpTileCubic<cn>(src, dst, m, tile, border, buffer);
+    }
+    else {
+        warpTileLinear<cn>(src, dst, m, tile, border, buffer);
+    }
+}
+
+} // namespace detail
+
+// Drop-in replacement for cv::warpPerspective(src, dst, h, dsize, INTER_LINEAR / INTER_CUBIC,
+// BORDER_CONSTANT / BORDER_REPLICATE), black by default. The output is split into tiles processed in parallel,
+// source coordinates are stepped along each row with SIMD and interpolation uses fixed-point weights.
+// Types other than 8-bit 1/3/4 channel images are forwarded to OpenCV.
+inline void warpPerspective(const cv::Mat& src, cv::Mat& dst, const cv::Mat& h, cv::Size dsize,
+    WarpInterpolation interpolation = WarpInterpolation::Linear,
+    WarpBorder border = WarpBorder::Constant,
+    cv::Size tile_size = { 64, 16 }) {
+    if (h.empty()) {
+        throw std::runtime_error("Homography matrix is empty!\n");
+    }
+
+    if (src.depth() != CV_8U || (src.channels() != 1 && src.channels() != 3 && src.channels() != 4)) {
+        cv::warpPerspective(src, dst, h, dsize,
+            interpolation == WarpInterpolation::Cubic ? cv::INTER_CUBIC : cv::INTER_LINEAR,
+            border == WarpBorder::Replicate ? cv::BORDER_REPLICATE : cv::BORDER_CONSTANT);
+        return;
+    }
+
+    cv::Mat h64;
+    h.convertTo(h64, CV_64F);
+    cv::Matx33d m;
+    if (cv::invert(h64, m) == 0.0) {
+        throw std::runtime_error("Homography matrix is singular!\n");
+    }
+
+    // Keep the source alive and untouched when warping in place
+    const cv::Mat source{ src.data == dst.data ? src.clone() : src };
+    dst.create(dsize, source.type());
+
+    const int tiles_x{ (dsize.width + tile_size.width - 1) / tile_size.width };
+    const int tiles_y{ (dsize.height + tile_size.height - 1) / tile_size.height };
+
+    cv::parallel_for_(cv::Range(0, tiles_x * tiles_y), [&](const cv::Range& range) {
+        std::vector<int> buffer(4 * static_cast<size_t>(tile_size.width));
+        for (int t{ range.start }; t < range.end; ++t) {
+            const int tx{ (t % tiles_x) * tile_size.width };
+            const int ty{ (t / tiles_x) * tile_size.height };
+            const cv::Rect tile{ tx, ty,
+                std::min(tile_size.width, dsize.width - tx),
+                std::min(tile_size.height, dsize.height - ty) };
+
+            switch (source.channels()) {
+            case 1:
+                detail::warpTile<1>(source, dst, m, tile, interpolation, border, buffer.data());
+                break;
+            case 3:
+                detail::warpTile<3>(source, dst, m, tile, interpolation, border, buffer.data());
+                break;
+            default:
+                detail::warpTile<4>(source, dst, m, tile, interpolation, border, buffer.data());
+                break;
+            }
+        }
+    });
+}
+
+} // namespace playground
@@ -0,0 +1,131 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "feature_policies.hpp"
+#include "robust_homography.hpp"
+
+namespace playground {
+
+// One query image matched against the train side of a FeaturePipeline. Kept by the caller between runs,
+// so the match and point vectors keep their capacity and gathering points doesn't allocate once warm.
+struct FeatureMatch {
+    std::vector<cv::KeyPoint> keypoints;
+    cv::Mat descriptors;
+    std::vector<std::vector<cv::DMatch>> knn;
+    // Filtered matches, sorted by distance
+    std::vector<cv::DMatch> matches;
+    // Query / train positions of `matches`
+    std::vector<cv::Point2f> src_points;
+    std::vector<cv::Point2f> dst_points;
+    // Query to train homography, empty when there were too few matches or the fit failed
+    cv::Mat homography;
+    cv::Mat inlier_mask;
+    HomographyStats stats;
+
+    int inliers() const { return inlier_mask.empty() ? 0 : cv::countNonZero(inlier_mask); }
+};
+
+// detect -> match -> filter -> gather points -> homography, with every stage a policy (feature_policies.hpp).
+// The train side (detected once, indexed by the matcher) lives in the pipeline, query sides in FeatureMatch
+// objects, so one trained pipeline serves any number of queries, also from several threads at once.
+// No windows or drawing, the demos do that with the results.
+template <typename Detector, typename Matcher, typename Filter, typename Estimator>
+class FeaturePipeline {
+public:
+    explicit FeaturePipeline(Detector detector = {},
+        Matcher matcher = {},
+        Filter filter = {},
+        Estimator estimator = {},
+        int min_matches = 10
+    ) :
+        detector_(std::move(detector)),
+        matcher_(std::move(matcher)),
+        filter_(std::move(filter)),
+        estimator_(std::move(estimator)),
+        min_matches_(min_matches) {}
+
+    void detect(const cv::Mat& gray, std::vector<cv::KeyPoint>& kp, cv::Mat& descriptors) const {
+        detector_(gray, kp, descriptors);
+    }
+
+    // Detects `gray` and indexes it as the train side until the next call
+    void setTrain(const cv::Mat& gray) {
+        detector_(gray, train_kp_, train_descriptors_);
+        matcher_.train(train_descriptors_);
+    }
+
+    // Train side from features computed elsewhere
+    void setTrain(std::vector<cv::KeyPoint> kp, cv::Mat descriptors) {
+        train_kp_ = std::move(kp);
+        train_descriptors_ = std::move(descriptors);
+        matcher_.train(train_descriptors_);
+    }
+
+    // Whole flow for a query image. False when there are too few matches for a homography or the fit fails.
+    bool process(const cv::Mat& query_gray, FeatureMatch& result) const {
+        detect(query_gray, result.keypoints, result.descriptors);
+        match(result);
+        return estimate(result);
+    }
+
+    // k-NN of the query descriptors against the train side, then the filter
+    void match(FeatureMatch& result) const {
+        if (result.descriptors.empty() or train_descriptors_.empty()) {
+            result.knn.clear();
+            result.matches.clear();
+            return;
+        }
+        matcher_.knnMatch(result.descriptors, result.knn, Filter::k);
+        filter_(result.knn, result.matches);
+    }
+
+    // Points of the filtered matches and the homography between them
+    bool estimate(FeatureMatch& result) const {
+        result.homography.release();
+        result.inlier_mask.release();
+        result.stats = {};
+        const size_t n{ result.matches.size() };
+        if (n < static_cast<size_t>(std::max(min_matches_, 4))) {
+            result.src_points.clear();
+            result.dst_points.clear();
+            return false;
+        }
+
+        // Sized once, written in place
+        result.src_points.resize(n);
+        result.dst_points.resize(n);
+        for (size_t i{ 0 }; i < n; ++i) {
+            result.src_points[i] = result.keypoints[result.matches[i].queryIdx].pt;
+            result.dst_points[i] = train_kp_[result.matches[i].trainIdx].pt;
+        }
+        result.homography = estimator_(result.src_points, result.dst_points, result.inlier_mask, result.stats);
+        return !result.homography.empty();
+    }
+
+    const auto& trainKeypoints() const { return train_kp_; }
+    const auto& trainDescriptors() const { return train_descriptors_; }
+
+private:
+    Detector detector_;
+    Matcher matcher_;
+    Filter filter_;
+    Estimator estimator_;
+
+    // Configuration variables
+    int min_matches_{};
+
+    // Train side
+    std::vector<cv::KeyPoint> train_kp_;
+    cv::Mat train_descriptors_;
+};
+
+} // namespace playground
@@ -0,0 +1,201 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#include <opencv2/flann.hpp>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hamming_matcher.hpp"
+#include "lsh_index.hpp"
+#include "robust_homography.hpp"
+#include "tiled_features.hpp"
+
+namespace playground {
+
+// Stages of FeaturePipeline. Every policy is a small value type, the pipeline calls:
+//   Detector:  void operator()(const cv::Mat& gray, std::vector<cv::KeyPoint>&, cv::Mat& descriptors) const
+//   Matcher:   void train(const cv::Mat& descriptors)
+//              void knnMatch(const cv::Mat& query, std::vector<std::vector<cv::DMatch>>&, int k) const
+//   Filter:    static constexpr int k; void operator()(const knn matches&, std::vector<cv::DMatch>& good) const
+//   Estimator: cv::Mat operator()(const std::vector<cv::Point2f>& src, const std::vector<cv::Point2f>& dst,
+//                                 cv::Mat& mask, HomographyStats& stats) const
+// Detectors and matcher searches must be safe to call from several threads at once.
+
+// ORB over an overlapping grid in parallel, or over the whole image
+struct OrbDetector {
+    int max_features{ 1000 };
+    bool tiled{ true };
+
+    void operator()(const cv::Mat& gray, std::vector<cv::KeyPoint>& kp, cv::Mat& descriptors) const {
+        if (tiled) {
+            detectAndComputeTiled(gray, [](int n) { return cv::ORB::create(n); }, max_features, kp, descriptors);
+            return;
+        }
+        // One detector per call, so images can be detected from different threads
+        cv::ORB::create(max_features)->detectAndCompute(gray, cv::Mat{}, kp, descriptors);
+    }
+};
+
+struct SiftDetector {
+    int max_features{ 1000 };
+    bool tiled{ true };
+    // The overlap can't be derived from cv::SIFT, it covers descriptors of up to ~6 sigma
+    TileGrid grid{ 384, 48 };
+
+    void operator()(const cv::Mat& gray, std::vector<cv::KeyPoint>& kp, cv::Mat& descriptors) const {
+        if (tiled) {
+            detectAndComputeTiled(gray, [](int n) { return cv::SIFT::create(n); }, max_features, kp, descriptors, grid);
+            return;
+        }
+        cv::SIFT::create(max_features)->detectAndCompute(gray, cv::Mat{}, kp, descriptors);
+    }
+};
+
+// Exact popcount Hamming k-NN over binary descriptors
+struct HammingBruteForce {
+    cv::Mat train_descriptors;
+
+    void train(const cv::Mat& descriptors) {
+        train_descriptors = descriptors;
+    }
+
+    void knnMatch(const cv::Mat& query, std::vector<std::vector<cv::DMatch>>& matches, int k) const {
+        HammingMatcher::knnMatch(query, train_descriptors, matches, k);
+    }
+};
+
+// Multi-probe LSH over binary descriptors, built once per train set
+struct LshMatcher {
+    int hash_tables{ 8 };
+    int key_bits{ 16 };
+    // Kept here, the index only references it
+    cv::Mat train_descriptors;
+    std::shared_ptr<LshIndex> index;
+
+    void train(const cv::Mat& descriptors) {
+        train_descriptors = descriptors;
+        index = std::make_shared<LshIndex>(train_descriptors, hash_tables, key_bits);
+    }
+
+    void knnMatch(const cv::Mat& query, std::vector<std::vector<cv::DMatch>>& matches, int k) const {
+        index->knnMatch(query, matches, k);
+    }
+};
+
+// FLANN KD-tree over float descriptors, built once per train set. Searches only read the tree, so several
+// queries can run against it at the same time.
+struct KdTreeMatcher {
+    int trees{ 5 };
+    int checks{ 5 };
+    cv::Mat train_descriptors;
+    std::shared_ptr<cv::flann::Index> index;
+
+    void train(const cv::Mat& descriptors) {
+        descriptors.convertTo(train_descriptors, CV_32F);
+        // FLANN can't build over an empty set, the pipeline doesn't search one
+        index = train_descriptors.empty() ? nullptr
+            : std::make_shared<cv::flann::Index>(train_descriptors, cv::flann::KDTreeIndexParams(trees));
+    }
+
+    // In the layout FlannBasedMatcher::knnMatch returns
+    void knnMatch(const cv::Mat& query, std::vector<std::vector<cv::DMatch>>& matches, int k) const {
+        matches.resize(query.rows);
+        for (auto& m : matches) {
+            m.clear();
+        }
+        if (query.empty() or train_descriptors.empty()) {
+            return;
+        }
+        cv::Mat query_f, indices, distances;
+        query.convertTo(query_f, CV_32F);
+        index->knnSearch(query_f, indices, distances, std::min(k, train_descriptors.rows), cv::flann::SearchParams(checks));
+        for (int i{ 0 }; i < query.rows; ++i) {
+            for (int j{ 0 }; j < indices.cols; ++j) {
+                const int train{ indices.at<int>(i, j) };
+                if (train >= 0) {
+                    // KD-tree distances are squared L2
+                    matches[i].emplace_back(i, train, std::sqrt(distances.at<float>(i, j)));
+                }
+            }
+        }
+    }
+};
+
+// Any cv::DescriptorMatcher by name, popcount brute force for "BruteForce-Hamming"
+struct NamedMatcher {
+    std::string type{ "BruteForce-Hamming" };
+    cv::Mat train_descriptors;
+    cv::Ptr<cv::DescriptorMatcher> matcher;
+
+    void train(const cv::Mat& descriptors) {
+        train_descriptors = descriptors;
+        matcher.reset();
+        if (type != "BruteForce-Hamming" and !train_descriptors.empty()) {
+            matcher = cv::DescriptorMatcher::create(type);
+            matcher->clear();
+            matcher->add(std::vector<cv::Mat>{ train_descriptors });
+            matcher->train();
+        }
+    }
+
+    void knnMatch(const cv::Mat& query, std::vector<std::vector<cv::DMatch>>& matches, int k) const {
+        if (!matcher) {
+            HammingMatcher::knnMatch(query, train_descriptors, matches, k);
+            return;
+        }
+        matcher->knnMatch(query, matches, k);
+    }
+};
+
+// Lowe's ratio test on the two nearest neighbours, survivors sorted by distance (the order PROSAC samples in)
+struct LoweRatio {
+    static constexpr int k{ 2 };
+    float ratio{ 0.8f };
+
+    void operator()(const std::vector<std::vector<cv::DMatch>>& knn, std::vector<cv::DMatch>& good) const {
+        good.clear();
+        for (const auto& e : knn) {
+            if (e.size() == 2 and e[0].distance < ratio * e[1].distance) {
+                good.push_back(e[0]);
+            }
+        }
+        std::ranges::sort(good, std::less{});
+    }
+};
+
+// Best `fraction` of the nearest-neighbour matches, sorted by distance
+struct KeepBest {
+    static constexpr int k{ 1 };
+    float fraction{ 0.15f };
+
+    void operator()(const std::vector<std::vector<cv::DMatch>>& knn, std::vector<cv::DMatch>& good) const {
+        good.clear();
+        for (const auto& e : knn) {
+            if (!e.empty()) {
+                good.push_back(e[0]);
+            }
+        }
+        HammingMatcher::keepBest(good, fraction);
+    }
+};
+
+// playground::findHomography with the estimator picked at run time
+struct RobustHomography {
+    RobustEstimator estimator{ RobustEstimator::Ransac };
+    double threshold{ 3.0 };
+
+    cv::Mat operator()(const std::vector<cv::Point2f>& src, const std::vector<cv::Point2f>& dst, cv::Mat& mask,
+        HomographyStats& stats) const {
+        return findHomography(src, dst, estimator, threshold, mask, &stats);
+    }
+};
+
+} // namespace playground
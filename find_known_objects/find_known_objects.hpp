@@ -0,0 +1,134 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <filesystem>
+#include <format>
+#include <stdexcept>
+#include <vector>
+
+#include "feature_pipeline.hpp"
+#include "robust_homography.hpp"
+
+// Projects the object corners with the homography and outlines their convex hull, shifted by offset_x
+inline void drawObjectOutline(cv::Mat& img, cv::Size object_size, const cv::Mat& homography, float offset_x = 0.0f) {
+    if (homography.empty()) {
+        return;
+    }
+    std::vector<cv::Point2f> src_corners{
+      {0.0f, 0.0f},
+      {static_cast<float>(object_size.width), 0.0f},
+      {static_cast<float>(object_size.width), static_cast<float>(object_size.height)},
+      {0.0f, static_cast<float>(object_size.height)}
+    };
+    std::vector<cv::Point2f> scene_corners(4);
+    cv::perspectiveTransform(src_corners, scene_corners, homography);
+
+    for (auto& pt : scene_corners) {
+        pt.x += offset_x;
+    }
+
+    std::vector<cv::Point2f> hull;
+    cv::convexHull(scene_corners, hull);
+    for (size_t i{ 0 }; i < hull.size(); ++i) {
+        cv::line(img,
+            hull[i],
+            hull[(i + 1) % hull.size()],
+            cv::Scalar(0, 0, 255),
+            5,
+            cv::LINE_AA);
+    }
+}
+
+using ObjectPipeline = playground::FeaturePipeline<playground::OrbDetector, playground::LshMatcher,
+    playground::LoweRatio, playground::RobustHomography>;
+
+class FindKnownObjects {
+public:
+    FindKnownObjects(
+        const std::filesystem::path& src_path,
+        const std::filesystem::path& dst_path,
+        int max_features = 1000,
+        int min_mach_count = 10,
+        int hash_tables = 8,
+        int key_bits = 16,
+        float lowe_ratio = 0.9f,
+        float ransac_threshold = 5.0f,
+        playground::RobustEstimator estimator = playground::RobustEstimator::Ransac,
+        bool tiled_features = true
+    ) :
+        src_(cv::imread(src_path.string())),
+        dst_(cv::imread(dst_path.string())),
+        pipeline_(playground::OrbDetector{ max_features, tiled_features },
+            playground::LshMatcher{ hash_tables, key_bits },
+            playground::LoweRatio{ lowe_ratio },
+            playground::RobustHomography{ estimator, ransac_threshold },
+            min_mach_count) {
+        if (src_.empty()) {
+            throw std::runtime_error(std::format("Can't load an image from: {}", src_path.string()));
+        }
+
+        if (dst_.empty()) {
+            throw std::runtime_error(std::format("Can't load an image from: {}", dst_path.string()));
+        }
+
+        process();
+    }
+
+    cv::Mat drawMatches(bool use_mask = true,
+        bool draw_location = true,
+        const cv::DrawMatchesFlags& flag = cv::DrawMatchesFlags::NOT_DRAW_SINGLE_POINTS) {
+        cv::Mat output;
+        cv::Mat mask{};
+
+        if (use_mask) {
+            mask = match_.inlier_mask;
+        }
+        cv::drawMatches(
+            src_,
+            match_.keypoints,
+            dst_,
+            pipeline_.trainKeypoints(),
+            match_.matches,
+            output,
+            cv::Scalar::all(-1),
+            cv::Scalar::all(-1),
+            mask,
+            flag
+        );
+
+        if (draw_location) {
+            drawLines(output);
+        }
+
+        return output;
+    }
+
+    const auto& getHomographyStats() const { return match_.stats; }
+private:
+    // Matrices for images
+    cv::Mat src_;
+    cv::Mat dst_;
+
+    // ORB descriptors stay binary: multi-probe LSH index over the scene with popcount Hamming distance,
+    // built once per scene, then Lowe's ratio test
+    ObjectPipeline pipeline_;
+    // Object side: features, matches, points, homography and inlier mask
+    playground::FeatureMatch match_;
+
+    void process() {
+        cv::Mat gray_src, gray_dst;
+        cv::cvtColor(src_, gray_src, cv::COLOR_BGR2GRAY);
+        cv::cvtColor(dst_, gray_dst, cv::COLOR_BGR2GRAY);
+        pipeline_.setTrain(gray_dst);
+        pipeline_.process(gray_src, match_);
+    }
+
+    void drawLines(cv::Mat& img) {
+        drawObjectOutline(img, src_.size(), match_.homography, static_cast<float>(src_.size().width));
+    }
+};
@@ -2,7 +2,9 @@
 // Created by Michał Maj on 21/06/2025.
 //
 
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <opencv2/core.hpp>
 #include <opencv2/opencv.hpp>
 #include <opencv2/highgui.hpp>
@@ -10,187 +12,430 @@
 #include <filesystem>
 #include <print>
 #include <ranges>
-
-class FindKnownObjects {
+#include <string>
+#include <unordered_set>
+
+#include "find_known_objects.hpp"
+#include "hamming_matcher.hpp"
+#include "lsh_index.hpp"
+#include "object_database.hpp"
+#include "robust_homography.hpp"
+#include "stage_timer.hpp"
+
+// Video mode: full detection (ORB + LSH + RANSAC) once, then the homography is propagated frame to frame
+// by KLT tracking of the detection inliers. Detection runs again every `redetect_interval` frames
+// or as soon as the tracked inliers drop below `min_inliers`.
+class ObjectTracker {
 public:
-    FindKnownObjects(
-        const std::filesystem::path& src_path,
-        const std::filesystem::path& dst_path,
+    using Clock = std::chrono::steady_clock;
+
+    explicit ObjectTracker(const std::filesystem::path& object_path,
         int max_features = 1000,
-        int min_mach_count = 10,
-        int trees_number = 5,
-        int number_of_checks = 5,
-        float lowe_ratio = 0.9f,
-        float ransac_threshold = 5.0f
+        int min_inliers = 15,
+        int redetect_interval = 30,
+        float lowe_ratio = 0.8f,
+        double ransac_threshold = 3.0
     ) :
-        src_(cv::imread(src_path.string())),
-        dst_(cv::imread(dst_path.string())),
-        max_features_(max_features),
-        min_match_count_(min_mach_count),
-        trees_number_(trees_number),
-        number_of_checks_(number_of_checks),
-        lowe_ratio_(lowe_ratio),
-        ransac_threshold_(ransac_threshold) {
-        if (src_.empty()) {
-            throw std::runtime_error(std::format("Can't load an image from: {}", src_path.string()));
+        min_inliers_(min_inliers),
+        redetect_interval_(redetect_interval),
+        ransac_threshold_(ransac_threshold),
+        pipeline_(playground::OrbDetector{ max_features, false },
+            playground::LshMatcher{},
+            playground::LoweRatio{ lowe_ratio },
+            playground::RobustHomography{ playground::RobustEstimator::Ransac, ransac_threshold },
+            min_inliers) {
+        cv::Mat object{ cv::imread(object_path.string(), cv::IMREAD_GRAYSCALE) };
+        if (object.empty()) {
+            throw std::runtime_error(std::format("Can't load an image from: {}", object_path.string()));
         }
-
-        if (dst_.empty()) {
-            throw std::runtime_error(std::format("Can't load an image from: {}", dst_path.string()));
-        }
-
-        process();
+        object_size_ = object.size();
+        pipeline_.detect(object, object_.keypoints, object_.descriptors);
     }
 
-    cv::Mat drawMatches(bool use_mask = true,
-        bool draw_location = true,
-        const cv::DrawMatchesFlags& flag = cv::DrawMatchesFlags::NOT_DRAW_SINGLE_POINTS) {
-        cv::Mat output;
-        cv::Mat mask{};
+    // Locates the object in `frame` and outlines it, returns false if it is not found
+    bool process(cv::Mat& frame) {
+        auto start{ Clock::now() };
+        {
+            auto t{ timer_.measure("grayscale") };
+            cv::cvtColor(frame, gray_, cv::COLOR_BGR2GRAY);
+        }
 
-        if (use_mask) {
-            mask = mask_;
+        // A failed periodic detection keeps the tracked points, a lost track triggers detection right away
+        const bool periodic{ frames_since_detection_ >= redetect_interval_ };
+        bool found{ periodic && detect(periodic_redetections_) };
+        if (!found) {
+            found = track();
+        }
+        if (!found && !periodic) {
+            found = detect(lost_redetections_);
         }
-        cv::drawMatches(
-            src_,
-            kp1_,
-            dst_,
-            kp2_,
-            good_matches_,
-            output,
-            cv::Scalar::all(-1),
-            cv::Scalar::all(-1),
-            mask,
-            flag
-        );
 
-        if (draw_location) {
-            drawLines(output);
+        if (found) {
+            auto t{ timer_.measure("draw") };
+            drawObjectOutline(frame, object_size_, homography_);
+        }
+        else {
+            scene_points_.clear();
+            object_points_.clear();
         }
 
-        return output;
+        std::swap(prev_gray_, gray_);
+        ++frames_;
+        ++frames_since_detection_;
+        timer_.add("frame", std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        return found;
     }
-private:
-    // Matrices for images
-    cv::Mat src_;
-    cv::Mat dst_;
 
-    // Matrices for descriptors
-    cv::Mat descriptors1_;
-    cv::Mat descriptors2_;
-
-    // Vectors for keypoints
-    std::vector<cv::KeyPoint> kp1_;
-    std::vector<cv::KeyPoint> kp2_;
+    void printReport() const {
+        const int redetections{ periodic_redetections_ + lost_redetections_ };
+        std::println("Frames: {}, detections: {} ({:.1f}%): {} periodic, {} after losing the object",
+            frames_,
+            redetections,
+            frames_ ? 100.0 * redetections / frames_ : 0.0,
+            periodic_redetections_,
+            lost_redetections_);
+        timer_.print();
+    }
 
-    // Matrices for homography and mask
-    cv::Mat homography_;
+private:
+    // Object features, matched against every detection's scene index
+    cv::Size object_size_;
+    playground::FeatureMatch object_;
+
+    // Grayscale frames
+    cv::Mat prev_gray_;
+    cv::Mat gray_;
+
+    // Tracked inliers in the scene and their positions on the object
+    std::vector<cv::Point2f> object_points_;
+    std::vector<cv::Point2f> scene_points_;
+    std::vector<cv::Point2f> next_points_;
+    std::vector<uchar> status_;
+    std::vector<float> errors_;
     cv::Mat mask_;
+    cv::Mat homography_;
 
-    // Vectors for homography
-    std::vector<cv::Point2f> src_points_;
-    std::vector<cv::Point2f> dst_points_;
+    // Configuration variables
+    int min_inliers_{};
+    int redetect_interval_{};
+    double ransac_threshold_{};
+
+    // Whole-frame ORB, the frame is the train side
+    ObjectPipeline pipeline_;
+
+    // Statistics
+    playground::StageTimer timer_;
+    int frames_{};
+    int frames_since_detection_{};
+    int periodic_redetections_{};
+    int lost_redetections_{};
+
+    // Keeps only the entries of both point sets for which keep(i) is true
+    template <typename Keep>
+    void compactPoints(Keep keep) {
+        size_t n{ 0 };
+        for (size_t i{ 0 }; i < next_points_.size(); ++i) {
+            if (keep(i)) {
+                object_points_[n] = object_points_[i];
+                next_points_[n] = next_points_[i];
+                ++n;
+            }
+        }
+        object_points_.resize(n);
+        next_points_.resize(n);
+    }
 
-    // Vectors for matches and for good matches
-    std::vector<std::vector<cv::DMatch>> matches_;
-    std::vector<cv::DMatch> good_matches_;
+    bool track() {
+        if (scene_points_.size() < static_cast<size_t>(min_inliers_)) {
+            return false;
+        }
 
-    // Configuration variables
-    int max_features_{};
-    int min_match_count_{};
-    int trees_number_{};
-    int number_of_checks_{};
-    float lowe_ratio_{};
-    float ransac_threshold_{};
+        {
+            auto t{ timer_.measure("optical flow") };
+            cv::calcOpticalFlowPyrLK(prev_gray_, gray_, scene_points_, next_points_, status_, errors_, cv::Size(21, 21), 3);
+        }
 
-    void process() {
-        findKeyPointsAndDescriptors();
-        matchFeatures();
-        findGoodMatches();
-        auto check{ fillSrcDst() };
-        if (!check) {
-            return;
+        auto t{ timer_.measure("homography") };
+        compactPoints([this](size_t i) { return status_[i] != 0; });
+        if (next_points_.size() < static_cast<size_t>(min_inliers_)) {
+            return false;
         }
-        findHomography();
-    }
 
-    void findKeyPointsAndDescriptors() {
-        cv::Mat gray_src, gray_dst;
-        cv::cvtColor(src_, gray_src, cv::COLOR_BGR2GRAY);
-        cv::cvtColor(dst_, gray_dst, cv::COLOR_BGR2GRAY);
+        cv::Mat h{ cv::findHomography(object_points_, next_points_, cv::RANSAC, ransac_threshold_, mask_) };
+        if (h.empty()) {
+            return false;
+        }
+        compactPoints([this](size_t i) { return mask_.at<uchar>(static_cast<int>(i)) != 0; });
+        if (next_points_.size() < static_cast<size_t>(min_inliers_)) {
+            return false;
+        }
 
-        cv::Ptr<cv::ORB> orb{ cv::ORB::create(max_features_) };
-        orb->detectAndCompute(gray_src, cv::Mat{}, kp1_, descriptors1_);
-        orb->detectAndCompute(gray_dst, cv::Mat{}, kp2_, descriptors2_);
+        homography_ = h;
+        std::swap(scene_points_, next_points_);
+        return true;
     }
 
-    void matchFeatures() {
-        descriptors1_.convertTo(descriptors1_, CV_32F);
-        descriptors2_.convertTo(descriptors2_, CV_32F);
+    bool detect(int& counter) {
+        auto t{ timer_.measure("detection") };
+        ++counter;
+        frames_since_detection_ = 0;
+        pipeline_.setTrain(gray_);
+        pipeline_.match(object_);
+        if (!pipeline_.estimate(object_) or object_.inliers() < min_inliers_) {
+            return false;
+        }
 
-        cv::FlannBasedMatcher macher{
-          new cv::flann::KDTreeIndexParams(trees_number_),
-          new cv::flann::SearchParams(number_of_checks_)
-        };
-        macher.knnMatch(descriptors1_, descriptors2_, matches_, 2);
+        // Only the inliers are tracked
+        object_points_.clear();
+        scene_points_.clear();
+        for (size_t i{ 0 }; i < object_.src_points.size(); ++i) {
+            if (object_.inlier_mask.at<uchar>(static_cast<int>(i)) != 0) {
+                object_points_.push_back(object_.src_points[i]);
+                scene_points_.push_back(object_.dst_points[i]);
+            }
+        }
+        homography_ = object_.homography;
+        return true;
     }
+};
 
-    void findGoodMatches() {
-        good_matches_ = matches_ |
-            std::views::filter([this](const auto& e) {return e[0].distance < lowe_ratio_ * e[1].distance; }) |
-            std::views::transform([](const auto& e) {return e[0]; }) |
-            std::ranges::to<std::vector>();
+// Follows the object through a video file or a camera index and reports per-frame latency
+int runVideo(const std::string& source, const std::filesystem::path& object_path) {
+    cv::VideoCapture cap;
+    if (!source.empty() && std::ranges::all_of(source, [](unsigned char c) { return std::isdigit(c); })) {
+        cap.open(std::stoi(source));
+    }
+    else {
+        cap.open(source);
+    }
+    if (!cap.isOpened()) {
+        std::cerr << std::format("Can't load video from: {}\n", source);
+        return EXIT_FAILURE;
     }
 
-    bool fillSrcDst() {
-        if (good_matches_.size() < min_match_count_) {
-            return false;
+    ObjectTracker tracker{ object_path };
+    const std::string win_name{ "Tracked" };
+    cv::namedWindow(win_name, cv::WINDOW_NORMAL);
+
+    cv::Mat frame;
+    while (cap.read(frame)) {
+        if (!tracker.process(frame)) {
+            cv::putText(frame, "Not found", { 20, 40 }, cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 0, 255), 2);
+        }
+        cv::imshow(win_name, frame);
+        if (cv::waitKey(1) == 'q') {
+            break;
         }
+    }
 
-        src_points_.reserve(good_matches_.size());
-        dst_points_.reserve(good_matches_.size());
+    tracker.printReport();
+    cv::destroyAllWindows();
+    return EXIT_SUCCESS;
+}
+
+// Ratio-test matches of the previous float KD-tree path and of the LSH index, scored against exact
+// brute-force Hamming k-NN. Recall is the share of exact ratio-test matches that a method also returns.
+int runComparison(const std::filesystem::path& object_path, const std::filesystem::path& scene_path,
+    int max_features, float lowe_ratio, int runs = 10) {
+    cv::Mat object{ cv::imread(object_path.string(), cv::IMREAD_GRAYSCALE) };
+    cv::Mat scene{ cv::imread(scene_path.string(), cv::IMREAD_GRAYSCALE) };
+    if (object.empty() or scene.empty()) {
+        std::cerr << "Can't load images for comparison\n";
+        return EXIT_FAILURE;
+    }
 
-        std::ranges::for_each(good_matches_, [this](const auto& e) {
-            src_points_.emplace_back(kp1_[e.queryIdx].pt);
-            dst_points_.emplace_back(kp2_[e.trainIdx].pt);
-            });
+    std::vector<cv::KeyPoint> kp1, kp2;
+    cv::Mat descriptors1, descriptors2;
+    cv::Ptr<cv::ORB> orb{ cv::ORB::create(max_features) };
+    orb->detectAndCompute(object, cv::Mat{}, kp1, descriptors1);
+    orb->detectAndCompute(scene, cv::Mat{}, kp2, descriptors2);
+
+    auto ratioMatches = [lowe_ratio](const std::vector<std::vector<cv::DMatch>>& knn) {
+        std::vector<std::pair<int, int>> good;
+        for (const auto& e : knn) {
+            if (e.size() == 2 && e[0].distance < lowe_ratio * e[1].distance) {
+                good.emplace_back(e[0].queryIdx, e[0].trainIdx);
+            }
+        }
+        std::ranges::sort(good);
+        return good;
+    };
+
+    std::vector<std::vector<cv::DMatch>> knn;
+    playground::HammingMatcher::knnMatch(descriptors1, descriptors2, knn, 2);
+    const auto exact{ ratioMatches(knn) };
+
+    auto report = [&](std::string_view name, double build_ms, double query_ms) {
+        const auto found{ ratioMatches(knn) };
+        std::vector<std::pair<int, int>> common;
+        std::ranges::set_intersection(exact, found, std::back_inserter(common));
+        std::println("{:<16} {:>10.3f} {:>10.3f} {:>12.0f} {:>8} {:>8.1f}%",
+            name,
+            build_ms,
+            query_ms,
+            descriptors1.rows / (query_ms / 1000.0),
+            found.size(),
+            exact.empty() ? 0.0 : 100.0 * common.size() / exact.size());
+    };
+
+    auto elapsed = [](auto start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::println("{} object x {} scene descriptors, {} exact ratio-test matches", descriptors1.rows, descriptors2.rows, exact.size());
+    std::println("{:<16} {:>10} {:>10} {:>12} {:>8} {:>9}", "method", "build ms", "query ms", "queries/s", "matches", "recall");
+
+    // Previous path: descriptors as CV_32F in a FLANN KD-tree (build and search happen in knnMatch)
+    {
+        cv::Mat f1, f2;
+        descriptors1.convertTo(f1, CV_32F);
+        descriptors2.convertTo(f2, CV_32F);
+        double total{ 0.0 };
+        for (int i{ 0 }; i < runs; ++i) {
+            cv::FlannBasedMatcher matcher{
+              new cv::flann::KDTreeIndexParams(5),
+              new cv::flann::SearchParams(5)
+            };
+            auto start{ std::chrono::steady_clock::now() };
+            matcher.knnMatch(f1, f2, knn, 2);
+            total += elapsed(start);
+        }
+        report("flann kd-tree", 0.0, total / runs);
+    }
 
-        return true;
+    {
+        double build{ 0.0 }, query{ 0.0 };
+        for (int i{ 0 }; i < runs; ++i) {
+            auto start{ std::chrono::steady_clock::now() };
+            playground::LshIndex index{ descriptors2 };
+            build += elapsed(start);
+            start = std::chrono::steady_clock::now();
+            index.knnMatch(descriptors1, knn, 2);
+            query += elapsed(start);
+        }
+        report("lsh multi-probe", build / runs, query / runs);
     }
 
-    void findHomography() {
-        homography_ = cv::findHomography(src_points_, dst_points_, cv::RANSAC, ransac_threshold_, mask_);
+    {
+        double total{ 0.0 };
+        for (int i{ 0 }; i < runs; ++i) {
+            auto start{ std::chrono::steady_clock::now() };
+            playground::HammingMatcher::knnMatch(descriptors1, descriptors2, knn, 2);
+            total += elapsed(start);
+        }
+        report("exact hamming", 0.0, total / runs);
     }
 
-    void drawLines(cv::Mat& img) {
-        std::vector<cv::Point2f> src_corners{
-          {0.0f, 0.0f},
-          {static_cast<float>(src_.size().width), 0.0f},
-          {static_cast<float>(src_.size().width), static_cast<float>(src_.size().height)},
-          {0.0f, static_cast<float>(src_.size().height)}
+    return EXIT_SUCCESS;
+}
+
+// Indexes the object images (or every image of the given directories) into a database file
+int runBuildDatabase(const std::filesystem::path& db_path, const std::vector<std::filesystem::path>& inputs) {
+    static const std::unordered_set<std::string> valid_extensions{ ".jpg", ".jpeg", ".png", ".tif", ".tiff" };
+    try {
+        std::vector<std::filesystem::path> images;
+        for (const auto& input : inputs) {
+            if (std::filesystem::is_directory(input)) {
+                for (const auto& entry : std::filesystem::directory_iterator(input)) {
+                    if (entry.is_regular_file() and valid_extensions.contains(entry.path().extension().string())) {
+                        images.push_back(entry.path());
+                    }
+                }
+            } else {
+                images.push_back(input);
+            }
+        }
+        std::ranges::sort(images);
+
+        auto start{ std::chrono::steady_clock::now() };
+        ObjectDatabase::build(images, db_path);
+        const double build_ms{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() };
+
+        ObjectDatabase db{ db_path };
+        std::println("Indexed {} objects into {} words in {:.1f} ms: {}",
+            db.objectCount(), db.wordCount(), build_ms, db_path.string());
+    }
+    catch (std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Recognizes database objects in the scene and outlines every verified detection
+int runRecognition(const std::filesystem::path& db_path, const std::filesystem::path& scene_path) {
+    try {
+        auto elapsed = [](auto start) {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
         };
-        std::vector<cv::Point2f> scene_corners(4);
-        cv::perspectiveTransform(src_corners, scene_corners, homography_);
 
-        float offset_x = static_cast<float>(src_.size().width);
-        for (auto& pt : scene_corners) {
-            pt.x += offset_x;
+        auto start{ std::chrono::steady_clock::now() };
+        ObjectDatabase db{ db_path };
+        const double load_ms{ elapsed(start) };
+
+        cv::Mat scene{ cv::imread(scene_path.string()) };
+        if (scene.empty()) {
+            std::cerr << std::format("Can't load an image from: {}\n", scene_path.string());
+            return EXIT_FAILURE;
+        }
+        cv::Mat gray;
+        cv::cvtColor(scene, gray, cv::COLOR_BGR2GRAY);
+
+        start = std::chrono::steady_clock::now();
+        std::vector<cv::KeyPoint> kp;
+        cv::Mat descriptors;
+        cv::ORB::create(2000)->detectAndCompute(gray, cv::Mat{}, kp, descriptors);
+        const double features_ms{ elapsed(start) };
+
+        start = std::chrono::steady_clock::now();
+        const auto candidates{ db.shortlist(descriptors, 5) };
+        const double shortlist_ms{ elapsed(start) };
+
+        start = std::chrono::steady_clock::now();
+        const auto detections{ db.detect(kp, descriptors, candidates) };
+        const double detect_ms{ elapsed(start) };
+
+        std::println("{} objects, load {:.2f} ms, features {:.2f} ms, shortlist {:.2f} ms, verification {:.2f} ms",
+            db.objectCount(), load_ms, features_ms, shortlist_ms, detect_ms);
+        for (const auto& c : candidates) {
+            std::println("  candidate {:<24} score {:.4f}", db.name(c.object), c.score);
+        }
+        for (const auto& d : detections) {
+            std::println("  detected  {:<24} inliers {}", d.name, d.inliers);
+            std::vector<cv::Point> outline(d.corners.begin(), d.corners.end());
+            cv::polylines(scene, outline, true, cv::Scalar(0, 0, 255), 5, cv::LINE_AA);
+            cv::putText(scene, std::string{ d.name }, outline[0] + cv::Point{ 10, 40 },
+                cv::FONT_HERSHEY_SIMPLEX, 1.2, cv::Scalar(0, 0, 255), 3, cv::LINE_AA);
         }
 
-        std::vector<cv::Point2f> hull;
-        cv::convexHull(scene_corners, hull);
-        for (size_t i{ 0 }; i < hull.size(); ++i) {
-            cv::line(img,
-                hull[i],
-                hull[(i + 1) % hull.size()],
-                cv::Scalar(0, 0, 255),
-                5,
-                cv::LINE_AA);
+        cv::namedWindow("Recognized", cv::WINDOW_NORMAL);
+        cv::imshow("Recognized", scene);
+        cv::waitKey(0);
+        cv::destroyAllWindows();
+    }
+    catch (std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+    const std::string_view mode{ argc > 1 ? argv[1] : "" };
+    if (mode == "build-db") {
+        const std::filesystem::path db_path{ argc > 2 ? argv[2] : "objects.vtdb" };
+        std::vector<std::filesystem::path> inputs(argv + std::min(argc, 3), argv + argc);
+        if (inputs.empty()) {
+            inputs = { "../data/images/book.png", "../data/images/book1.png", "../data/images/book2.png" };
         }
+        return runBuildDatabase(db_path, inputs);
+    }
+    if (mode == "query") {
+        const std::filesystem::path db_path{ argc > 2 ? argv[2] : "objects.vtdb" };
+        const std::filesystem::path scene_path{ argc > 3 ? argv[3] : "../data/images/book_scene.png" };
+        return runRecognition(db_path, scene_path);
     }
-};
 
-int main() {
     std::filesystem::path path1{ "../data/images/book.png" };
     if (!std::filesystem::exists(path1)) {
         std::cerr << std::format("Can't find file at given location: {}", path1.string());
@@ -203,7 +448,27 @@ int main() {
         return EXIT_FAILURE;
     }
 
-    FindKnownObjects o{ path1, path2 };
+    if (mode == "track") {
+        return runVideo(argc > 2 ? argv[2] : "0", argc > 3 ? std::filesystem::path{ argv[3] } : path1);
+    }
+    if (mode == "compare") {
+        return runComparison(path1, path2, 1000, 0.9f);
+    }
+
+    // Any other argument selects the robust estimator
+    playground::RobustEstimator estimator{ playground::RobustEstimator::Ransac };
+    if (!mode.empty()) {
+        try {
+            estimator = playground::parseRobustEstimator(mode);
+        }
+        catch (std::exception& e) {
+            std::cerr << std::format("{}\nUsage: find_known_objects [{} | track [video] [object] | compare | "
+                "build-db [db] [images...] | query [db] [scene]]\n", e.what(), playground::robustEstimatorNames());
+            return EXIT_FAILURE;
+        }
+    }
+    FindKnownObjects o{ path1, path2, 1000, 10, 8, 16, 0.9f, 5.0f, estimator };
+    o.getHomographyStats().print(estimator);
 
     cv::namedWindow("Matched", cv::WINDOW_NORMAL);
 
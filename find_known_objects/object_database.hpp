@@ -0,0 +1,568 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hamming_matcher.hpp"
+#include "lsh_index.hpp"
+#include "mapped_file.hpp"
+
+namespace vocabulary {
+
+// Tree node. Children of a node are stored next to each other, leaves carry a word id.
+struct Node {
+    int32_t first_child;
+    int32_t child_count;
+    int32_t word;
+};
+
+struct Tree {
+    std::vector<Node> nodes;
+    std::vector<uchar> centroids;
+    int descriptor_bytes{};
+    int words{};
+};
+
+// Bitwise majority of the member descriptors
+inline void majority(const cv::Mat& descriptors, std::span<const int> members, uchar* centroid) {
+    const int bytes{ descriptors.cols };
+    std::vector<int> ones(bytes * 8, 0);
+    for (int m : members) {
+        const uchar* d{ descriptors.ptr<uchar>(m) };
+        for (int b{ 0 }; b < bytes; ++b) {
+            for (int bit{ 0 }; bit < 8; ++bit) {
+                ones[b * 8 + bit] += (d[b] >> bit) & 1;
+            }
+        }
+    }
+    const int half{ static_cast<int>(members.size()) };
+    for (int b{ 0 }; b < bytes; ++b) {
+        uchar value{ 0 };
+        for (int bit{ 0 }; bit < 8; ++bit) {
+            value |= static_cast<uchar>((ones[b * 8 + bit] * 2 > half) << bit);
+        }
+        centroid[b] = value;
+    }
+}
+
+// k-majority clustering of `members` (k-means++ seeding, Hamming distance), then recursion into the clusters
+inline void split(Tree& tree, const cv::Mat& descriptors, const std::vector<int>& members, int node,
+    int level, int branching, int depth, std::mt19937& rng) {
+    const int bytes{ descriptors.cols };
+    if (level == depth or static_cast<int>(members.size()) <= branching) {
+        tree.nodes[node].word = tree.words++;
+        return;
+    }
+
+    std::vector<uchar> centers(branching * bytes);
+    std::vector<int> min_distance(members.size(), INT_MAX);
+    int seeded{ 0 };
+    int next{ std::uniform_int_distribution<int>(0, static_cast<int>(members.size()) - 1)(rng) };
+    while (seeded < branching) {
+        std::memcpy(&centers[seeded * bytes], descriptors.ptr<uchar>(members[next]), bytes);
+        double total{ 0.0 };
+        for (size_t i{ 0 }; i < members.size(); ++i) {
+            const int d{ playground::detail::hammingDistance(descriptors.ptr<uchar>(members[i]), &centers[seeded * bytes], bytes) };
+            min_distance[i] = std::min(min_distance[i], d);
+            total += static_cast<double>(min_distance[i]) * min_distance[i];
+        }
+        ++seeded;
+        if (total == 0.0) {
+            break;
+        }
+        double pick{ std::uniform_real_distribution<double>(0.0, total)(rng) };
+        for (size_t i{ 0 }; i < members.size(); ++i) {
+            pick -= static_cast<double>(min_distance[i]) * min_distance[i];
+            if (pick <= 0.0) {
+                next = static_cast<int>(i);
+                break;
+            }
+        }
+    }
+
+    std::vector<int> assignment(members.size(), -1);
+    std::vector<std::vector<int>> clusters(seeded);
+    for (int iteration{ 0 }; iteration < 10; ++iteration) {
+        bool changed{ false };
+        for (size_t i{ 0 }; i < members.size(); ++i) {
+            const uchar* d{ descriptors.ptr<uchar>(members[i]) };
+            int best{ 0 }, best_distance{ INT_MAX };
+            for (int c{ 0 }; c < seeded; ++c) {
+                const int distance{ playground::detail::hammingDistance(d, &centers[c * bytes], bytes) };
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best = c;
+                }
+            }
+            changed |= assignment[i] != best;
+            assignment[i] = best;
+        }
+
+        for (auto& cluster : clusters) {
+            cluster.clear();
+        }
+        for (size_t i{ 0 }; i < members.size(); ++i) {
+            clusters[assignment[i]].push_back(members[i]);
+        }
+        if (!changed) {
+            break;
+        }
+        for (int c{ 0 }; c < seeded; ++c) {
+            if (!clusters[c].empty()) {
+                majority(descriptors, clusters[c], &centers[c * bytes]);
+            }
+        }
+    }
+
+    std::erase_if(clusters, [](const auto& cluster) { return cluster.empty(); });
+    if (clusters.size() < 2) {
+        tree.nodes[node].word = tree.words++;
+        return;
+    }
+
+    const int first{ static_cast<int>(tree.nodes.size()) };
+    tree.nodes[node].first_child = first;
+    tree.nodes[node].child_count = static_cast<int>(clusters.size());
+    tree.nodes.resize(first + clusters.size(), Node{ -1, 0, -1 });
+    tree.centroids.resize(tree.nodes.size() * bytes);
+    for (size_t c{ 0 }; c < clusters.size(); ++c) {
+        majority(descriptors, clusters[c], &tree.centroids[(first + c) * bytes]);
+    }
+    for (size_t c{ 0 }; c < clusters.size(); ++c) {
+        split(tree, descriptors, clusters[c], first + static_cast<int>(c), level + 1, branching, depth, rng);
+    }
+}
+
+// Hierarchical k-majority tree with up to branching^depth leaves (words)
+inline Tree train(const cv::Mat& descriptors, int branching, int depth, unsigned seed = 0x5eed) {
+    if (descriptors.empty() or descriptors.type() != CV_8U) {
+        throw std::runtime_error("Vocabulary training requires CV_8U descriptors!\n");
+    }
+    Tree tree;
+    tree.descriptor_bytes = descriptors.cols;
+    tree.nodes.push_back({ -1, 0, -1 });
+    tree.centroids.resize(descriptors.cols, 0);
+
+    std::vector<int> all(descriptors.rows);
+    std::iota(all.begin(), all.end(), 0);
+    std::mt19937 rng{ seed };
+    split(tree, descriptors, all, 0, 0, branching, depth, rng);
+    return tree;
+}
+
+// Leaf reached by descending to the closest child at every level
+inline int quantize(std::span<const Node> nodes, const uchar* centroids, int bytes, const uchar* descriptor) {
+    int node{ 0 };
+    while (nodes[node].child_count > 0) {
+        const int first{ nodes[node].first_child };
+        int best{ first }, best_distance{ INT_MAX };
+        for (int c{ first }; c < first + nodes[node].child_count; ++c) {
+            const int distance{ playground::detail::hammingDistance(descriptor, centroids + static_cast<size_t>(c) * bytes, bytes) };
+            if (distance < best_distance) {
+                best_distance = distance;
+                best = c;
+            }
+        }
+        node = best;
+    }
+    return nodes[node].word;
+}
+
+} // namespace vocabulary
+
+// Offline index of many planar objects. ORB descriptors of all objects are quantized with a vocabulary
+// tree, every object is stored as an L1-normalized tf-idf vector in an inverted file, next to its keypoints
+// and descriptors for verification. The file is memory-mapped, so loading costs no parsing or copying.
+//
+// File layout (all sections 4-byte aligned):
+// Header | Node[nodes] | centroids | idf[words] | posting offsets[words + 1] | Posting[postings]
+//        | ObjectEntry[objects] | Point2f[features] | descriptors[features] | names
+class ObjectDatabase {
+public:
+    struct Candidate {
+        int object;
+        float score;
+    };
+
+    struct Detection {
+        int object;
+        std::string_view name;
+        float score;
+        int inliers;
+        cv::Mat homography;
+        std::vector<cv::Point2f> corners;
+    };
+
+    // Extracts ORB features of every image, trains the vocabulary and writes the database
+    static void build(const std::vector<std::filesystem::path>& images, const std::filesystem::path& path,
+        int max_features = 1000, int branching = 10, int depth = 4) {
+        cv::Ptr<cv::ORB> orb{ cv::ORB::create(max_features) };
+        std::vector<ObjectEntry> objects;
+        std::vector<cv::Point2f> points;
+        std::string names;
+        cv::Mat descriptors;
+
+        for (const auto& image_path : images) {
+            cv::Mat img{ cv::imread(image_path.string(), cv::IMREAD_GRAYSCALE) };
+            if (img.empty()) {
+                throw std::runtime_error(std::format("Can't load an image from: {}", image_path.string()));
+            }
+            std::vector<cv::KeyPoint> kp;
+            cv::Mat d;
+            orb->detectAndCompute(img, cv::Mat{}, kp, d);
+            if (kp.empty()) {
+                continue;
+            }
+
+            const auto name{ image_path.stem().string() };
+            objects.push_back({ static_cast<uint32_t>(points.size()), static_cast<uint32_t>(kp.size()),
+                img.cols, img.rows, static_cast<uint32_t>(names.size()), static_cast<uint32_t>(name.size()) });
+            for (const auto& k : kp) {
+                points.push_back(k.pt);
+            }
+            descriptors.push_back(d);
+            names += name;
+        }
+        if (objects.empty()) {
+            throw std::runtime_error("No object features to index!\n");
+        }
+
+        const auto tree{ vocabulary::train(descriptors, branching, depth) };
+        const int bytes{ tree.descriptor_bytes };
+
+        std::vector<int> words(descriptors.rows);
+        cv::parallel_for_(cv::Range(0, descriptors.rows), [&](const cv::Range& range) {
+            for (int r{ range.start }; r < range.end; ++r) {
+                words[r] = vocabulary::quantize(tree.nodes, tree.centroids.data(), bytes, descriptors.ptr<uchar>(r));
+            }
+        });
+
+        // Document frequency -> idf
+        std::vector<int> frequency(tree.words, 0);
+        std::vector<int> last_object(tree.words, -1);
+        for (size_t o{ 0 }; o < objects.size(); ++o) {
+            for (uint32_t f{ objects[o].feature_offset }; f < objects[o].feature_offset + objects[o].feature_count; ++f) {
+                if (last_object[words[f]] != static_cast<int>(o)) {
+                    last_object[words[f]] = static_cast<int>(o);
+                    ++frequency[words[f]];
+                }
+            }
+        }
+        std::vector<float> idf(tree.words, 0.0f);
+        for (int w{ 0 }; w < tree.words; ++w) {
+            if (frequency[w] > 0) {
+                idf[w] = static_cast<float>(std::log(static_cast<double>(objects.size()) / frequency[w]));
+            }
+        }
+
+        std::vector<std::vector<Posting>> lists(tree.words);
+        for (size_t o{ 0 }; o < objects.size(); ++o) {
+            const auto begin{ words.begin() + objects[o].feature_offset };
+            std::vector<int> object_words(begin, begin + objects[o].feature_count);
+            for (const auto& [word, weight] : bagOfWords(object_words, idf)) {
+                lists[word].push_back({ static_cast<uint32_t>(o), weight });
+            }
+        }
+        std::vector<uint32_t> offsets(tree.words + 1, 0);
+        std::vector<Posting> postings;
+        for (int w{ 0 }; w < tree.words; ++w) {
+            postings.insert(postings.end(), lists[w].begin(), lists[w].end());
+            offsets[w + 1] = static_cast<uint32_t>(postings.size());
+        }
+
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(header.magic));
+        header.version = version;
+        header.descriptor_bytes = static_cast<uint32_t>(bytes);
+        header.node_count = static_cast<uint32_t>(tree.nodes.size());
+        header.word_count = static_cast<uint32_t>(tree.words);
+        header.object_count = static_cast<uint32_t>(objects.size());
+        header.posting_count = static_cast<uint32_t>(postings.size());
+        header.feature_count = static_cast<uint32_t>(points.size());
+        header.names_bytes = static_cast<uint32_t>(names.size());
+
+        std::ofstream file{ path, std::ios::binary };
+        if (!file) {
+            throw std::runtime_error(std::format("Can't write the object database: {}", path.string()));
+        }
+        auto write = [&file](const void* data, size_t size) {
+            file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            const char zeros[4]{};
+            file.write(zeros, static_cast<std::streamsize>(align(size) - size));
+        };
+        write(&header, sizeof(header));
+        write(tree.nodes.data(), tree.nodes.size() * sizeof(vocabulary::Node));
+        write(tree.centroids.data(), tree.centroids.size());
+        write(idf.data(), idf.size() * sizeof(float));
+        write(offsets.data(), offsets.size() * sizeof(uint32_t));
+        write(postings.data(), postings.size() * sizeof(Posting));
+        write(objects.data(), objects.size() * sizeof(ObjectEntry));
+        write(points.data(), points.size() * sizeof(cv::Point2f));
+        write(descriptors.data, descriptors.total());
+        write(names.data(), names.size());
+    }
+
+    explicit ObjectDatabase(const std::filesystem::path& path) :
+        file_(std::make_unique<playground::MappedFile>(path)) {
+        const uchar* data{ file_->data() };
+        if (file_->size() < sizeof(Header)) {
+            throw std::runtime_error(std::format("Not an object database: {}", path.string()));
+        }
+        std::memcpy(&header_, data, sizeof(Header));
+        if (std::memcmp(header_.magic, magic, sizeof(header_.magic)) != 0 or header_.version != version) {
+            throw std::runtime_error(std::format("Not an object database: {}", path.string()));
+        }
+
+        size_t offset{ align(sizeof(Header)) };
+        auto take = [&](size_t size) {
+            const size_t at{ offset };
+            offset += align(size);
+            return at;
+        };
+        const size_t bytes{ header_.descriptor_bytes };
+        const size_t nodes_at{ take(header_.node_count * sizeof(vocabulary::Node)) };
+        const size_t centroids_at{ take(header_.node_count * bytes) };
+        const size_t idf_at{ take(header_.word_count * sizeof(float)) };
+        const size_t offsets_at{ take((header_.word_count + 1) * sizeof(uint32_t)) };
+        const size_t postings_at{ take(header_.posting_count * sizeof(Posting)) };
+        const size_t objects_at{ take(header_.object_count * sizeof(ObjectEntry)) };
+        const size_t points_at{ take(header_.feature_count * sizeof(cv::Point2f)) };
+        const size_t descriptors_at{ take(header_.feature_count * bytes) };
+        const size_t names_at{ take(header_.names_bytes) };
+        if (offset > file_->size() or header_.node_count == 0) {
+            throw std::runtime_error(std::format("Truncated object database: {}", path.string()));
+        }
+
+        // Every section starts at a 4-byte boundary of a page-aligned mapping
+        nodes_ = { reinterpret_cast<const vocabulary::Node*>(data + nodes_at), header_.node_count };
+        centroids_ = data + centroids_at;
+        idf_ = { reinterpret_cast<const float*>(data + idf_at), header_.word_count };
+        offsets_ = { reinterpret_cast<const uint32_t*>(data + offsets_at), header_.word_count + 1 };
+        postings_ = { reinterpret_cast<const Posting*>(data + postings_at), header_.posting_count };
+        objects_ = { reinterpret_cast<const ObjectEntry*>(data + objects_at), header_.object_count };
+        points_ = { reinterpret_cast<const cv::Point2f*>(data + points_at), header_.feature_count };
+        descriptors_ = cv::Mat(static_cast<int>(header_.feature_count), static_cast<int>(bytes), CV_8U,
+            const_cast<uchar*>(data + descriptors_at));
+        names_ = { reinterpret_cast<const char*>(data + names_at), header_.names_bytes };
+        validate(path);
+    }
+
+    // Objects ranked by L1 bag-of-words similarity. Only the inverted lists of the query words are visited.
+    std::vector<Candidate> shortlist(const cv::Mat& descriptors, int count) const {
+        if (!descriptors.empty() and (descriptors.type() != CV_8U or descriptors.cols != static_cast<int>(header_.descriptor_bytes))) {
+            throw std::runtime_error(std::format("Query descriptors must be CV_8U with {} bytes, like the database ones!\n",
+                header_.descriptor_bytes));
+        }
+        std::vector<int> words(descriptors.rows);
+        cv::parallel_for_(cv::Range(0, descriptors.rows), [&](const cv::Range& range) {
+            for (int r{ range.start }; r < range.end; ++r) {
+                words[r] = vocabulary::quantize(nodes_, centroids_, descriptors.cols, descriptors.ptr<uchar>(r));
+            }
+        });
+
+        // |q - d|_1 = 2 - sum over shared words of (|q| + |d| - |q - d|) for L1-normalized vectors
+        std::vector<float> scores(objects_.size(), 0.0f);
+        for (const auto& [word, q] : bagOfWords(words, idf_)) {
+            for (uint32_t p{ offsets_[word] }; p < offsets_[word + 1]; ++p) {
+                const auto& posting{ postings_[p] };
+                scores[posting.object] += std::abs(q) + std::abs(posting.weight) - std::abs(q - posting.weight);
+            }
+        }
+
+        std::vector<Candidate> candidates;
+        for (size_t o{ 0 }; o < scores.size(); ++o) {
+            // With no more objects than the shortlist everything gets verified
+            if (scores[o] > 0.0f or objects_.size() <= static_cast<size_t>(count)) {
+                candidates.push_back({ static_cast<int>(o), 0.5f * scores[o] });
+            }
+        }
+        const auto keep{ std::min(candidates.size(), static_cast<size_t>(count)) };
+        std::ranges::partial_sort(candidates, candidates.begin() + keep, std::greater{}, &Candidate::score);
+        candidates.resize(keep);
+        return candidates;
+    }
+
+    // Shortlisted objects verified with a ratio test and a RANSAC homography against the scene features
+    std::vector<Detection> detect(const std::vector<cv::KeyPoint>& scene_kp, const cv::Mat& scene_descriptors,
+        const std::vector<Candidate>& candidates,
+        float lowe_ratio = 0.8f,
+        int min_inliers = 15,
+        double ransac_threshold = 5.0) const {
+        std::vector<Detection> detections;
+        if (scene_descriptors.empty()) {
+            return detections;
+        }
+        const playground::LshIndex scene_index{ scene_descriptors };
+
+        for (const auto& candidate : candidates) {
+            const auto& object{ objects_[candidate.object] };
+            std::vector<std::vector<cv::DMatch>> knn;
+            scene_index.knnMatch(descriptors_.rowRange(static_cast<int>(object.feature_offset),
+                static_cast<int>(object.feature_offset + object.feature_count)), knn, 2);
+
+            std::vector<cv::Point2f> object_points, scene_points;
+            for (const auto& e : knn) {
+                if (e.size() == 2 && e[0].distance < lowe_ratio * e[1].distance) {
+                    object_points.push_back(points_[object.feature_offset + e[0].queryIdx]);
+                    scene_points.push_back(scene_kp[e[0].trainIdx].pt);
+                }
+            }
+            if (static_cast<int>(object_points.size()) < min_inliers) {
+                continue;
+            }
+
+            cv::Mat mask;
+            cv::Mat h{ cv::findHomography(object_points, scene_points, cv::RANSAC, ransac_threshold, mask) };
+            if (h.empty()) {
+                continue;
+            }
+            const int inliers{ cv::countNonZero(mask) };
+            if (inliers < min_inliers) {
+                continue;
+            }
+
+            const auto w{ static_cast<float>(object.width) };
+            const auto ht{ static_cast<float>(object.height) };
+            std::vector<cv::Point2f> corners;
+            cv::perspectiveTransform(std::vector<cv::Point2f>{ {0.0f, 0.0f}, { w, 0.0f }, { w, ht }, { 0.0f, ht } }, corners, h);
+            if (!cv::isContourConvex(corners)) {
+                continue;
+            }
+            detections.push_back({ candidate.object, name(candidate.object), candidate.score, inliers, h, std::move(corners) });
+        }
+        return detections;
+    }
+
+    size_t objectCount() const { return objects_.size(); }
+    size_t wordCount() const { return idf_.size(); }
+
+    std::string_view name(int object) const {
+        return names_.substr(objects_[object].name_offset, objects_[object].name_length);
+    }
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t descriptor_bytes;
+        uint32_t node_count;
+        uint32_t word_count;
+        uint32_t object_count;
+        uint32_t posting_count;
+        uint32_t feature_count;
+        uint32_t names_bytes;
+    };
+
+    struct Posting {
+        uint32_t object;
+        float weight;
+    };
+
+    struct ObjectEntry {
+        uint32_t feature_offset;
+        uint32_t feature_count;
+        int32_t width;
+        int32_t height;
+        uint32_t name_offset;
+        uint32_t name_length;
+    };
+
+    static constexpr char magic[4]{ 'V', 'T', 'D', 'B' };
+    static constexpr uint32_t version{ 1 };
+
+    std::unique_ptr<playground::MappedFile> file_;
+    Header header_{};
+    std::span<const vocabulary::Node> nodes_;
+    const uchar* centroids_{ nullptr };
+    std::span<const float> idf_;
+    std::span<const uint32_t> offsets_;
+    std::span<const Posting> postings_;
+    std::span<const ObjectEntry> objects_;
+    std::span<const cv::Point2f> points_;
+    cv::Mat descriptors_;
+    std::string_view names_;
+
+    // Every index stored in the file stays inside its section, so a corrupt or hand-edited database
+    // fails here instead of reading out of the mapping. One linear pass over nodes, lists and objects.
+    void validate(const std::filesystem::path& path) const {
+        auto corrupt = [&](std::string_view what) {
+            return std::runtime_error(std::format("Corrupt object database ({}): {}", what, path.string()));
+        };
+        if (header_.descriptor_bytes == 0) {
+            throw corrupt("descriptor size");
+        }
+        for (size_t n{ 0 }; n < nodes_.size(); ++n) {
+            const auto& node{ nodes_[n] };
+            if (node.child_count > 0) {
+                // Children come after their parent, so descending always terminates
+                if (node.first_child <= static_cast<int64_t>(n) or
+                    static_cast<int64_t>(node.first_child) + node.child_count > static_cast<int64_t>(nodes_.size())) {
+                    throw corrupt("tree node");
+                }
+            }
+            else if (node.word < 0 or node.word >= static_cast<int64_t>(header_.word_count)) {
+                throw corrupt("word id");
+            }
+        }
+        if (offsets_.front() != 0 or offsets_.back() != header_.posting_count or
+            !std::ranges::is_sorted(offsets_)) {
+            throw corrupt("posting offsets");
+        }
+        if (std::ranges::any_of(postings_, [&](const Posting& p) { return p.object >= header_.object_count; })) {
+            throw corrupt("posting object");
+        }
+        for (const auto& object : objects_) {
+            if (static_cast<uint64_t>(object.feature_offset) + object.feature_count > header_.feature_count or
+                static_cast<uint64_t>(object.name_offset) + object.name_length > header_.names_bytes) {
+                throw corrupt("object entry");
+            }
+        }
+    }
+
+    static size_t align(size_t size) {
+        return (size + 3) & ~size_t{ 3 };
+    }
+
+    // L1-normalized tf-idf vector, sorted by word
+    static std::vector<std::pair<int, float>> bagOfWords(std::vector<int> words, std::span<const float> idf) {
+        std::ranges::sort(words);
+        std::vector<std::pair<int, float>> bow;
+        float total{ 0.0f };
+        for (size_t i{ 0 }; i < words.size();) {
+            size_t j{ i };
+            while (j < words.size() && words[j] == words[i]) {
+                ++j;
+            }
+            const float weight{ static_cast<float>(j - i) / static_cast<float>(words.size()) * idf[words[i]] };
+            if (weight > 0.0f) {
+                bow.emplace_back(words[i], weight);
+                total += weight;
+            }
+            i = j;
+        }
+        for (auto& [word, weight] : bow) {
+            weight /= total;
+        }
+        return bow;
+    }
+};
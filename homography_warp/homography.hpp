@@ -0,0 +1,233 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <optional>
+#include <print>
+#include <string>
+#include <vector>
+
+#include "warp_perspective.hpp"
+
+// Orders 4 points as top-left, top-right, bottom-right, bottom-left
+template <typename Point>
+void sortQuad(std::vector<Point>& points) {
+    if (points.size() != 4) return;
+
+    Point topLeft = *std::min_element(points.begin(), points.end(),
+        [](const Point& a, const Point& b) { return (a.x + a.y) < (b.x + b.y); });
+
+    Point bottomRight = *std::max_element(points.begin(), points.end(),
+        [](const Point& a, const Point& b) { return (a.x + a.y) < (b.x + b.y); });
+
+    Point topRight = *std::min_element(points.begin(), points.end(),
+        [](const Point& a, const Point& b) { return (a.x - a.y) > (b.x - b.y); });
+
+    Point bottomLeft = *std::max_element(points.begin(), points.end(),
+        [](const Point& a, const Point& b) { return (a.x - a.y) > (b.x - b.y); });
+
+    points = { topLeft, topRight, bottomRight, bottomLeft };
+}
+
+// Warps `src` with `h` (src -> dst) only inside the bounding box of `quad` and blends it into `dst` in place,
+// weighted by an anti-aliased coverage mask of the quad. The cost depends on the quad area instead of the dst size.
+inline void compositeIntoQuad(const cv::Mat& src, cv::Mat& dst, const cv::Mat& h, const std::vector<cv::Point2f>& quad,
+    cv::Mat& warped, cv::Mat& coverage, bool tiled_warp = false) {
+    constexpr int shift_bits{ 4 };
+    constexpr float shift_scale{ 1 << shift_bits };
+
+    cv::Rect roi{ cv::boundingRect(quad) & cv::Rect(0, 0, dst.cols, dst.rows) };
+    if (roi.empty()) {
+        return;
+    }
+
+    // Shift the homography so that roi.tl() lands at (0, 0)
+    cv::Mat shift{ cv::Mat::eye(3, 3, CV_64F) };
+    shift.at<double>(0, 2) = -roi.x;
+    shift.at<double>(1, 2) = -roi.y;
+    if (tiled_warp) {
+        playground::warpPerspective(src, warped, shift * h, roi.size(), playground::WarpInterpolation::Linear,
+            playground::WarpBorder::Replicate);
+    }
+    else {
+        cv::warpPerspective(src, warped, shift * h, roi.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+    }
+
+    // Anti-aliased single channel coverage of the quad inside roi, with sub-pixel vertices
+    std::vector<cv::Point> local_points;
+    local_points.reserve(quad.size());
+    for (const auto& p : quad) {
+        local_points.emplace_back(cvRound((p.x - roi.x) * shift_scale), cvRound((p.y - roi.y) * shift_scale));
+    }
+    coverage.create(roi.size(), CV_8UC1);
+    coverage.setTo(cv::Scalar::all(0));
+    cv::fillConvexPoly(coverage, local_points, cv::Scalar::all(255), cv::LINE_AA, shift_bits);
+
+    cv::Mat dst_roi{ dst(roi) };
+    for (int y{ 0 }; y < roi.height; ++y) {
+        const auto* alpha = coverage.ptr<uchar>(y);
+        const auto* src_row = warped.ptr<cv::Vec3b>(y);
+        auto* dst_row = dst_roi.ptr<cv::Vec3b>(y);
+        for (int x{ 0 }; x < roi.width; ++x) {
+            const int a{ alpha[x] };
+            if (a == 0) {
+                continue;
+            }
+            if (a == 255) {
+                dst_row[x] = src_row[x];
+                continue;
+            }
+            for (int c{ 0 }; c < 3; ++c) {
+                dst_row[x][c] = static_cast<uchar>((src_row[x][c] * a + dst_row[x][c] * (255 - a) + 127) / 255);
+            }
+        }
+    }
+}
+
+class Homography {
+public:
+    Homography(const std::filesystem::path& src, const std::filesystem::path& dst)
+        : src_(cv::imread(src.string())), dst_(cv::imread(dst.string())) {
+        src_points_.reserve(4);
+        dst_points_.reserve(4);
+    }
+    Homography(const std::filesystem::path& src) : src_(cv::imread(src.string())) {
+        dst_ = cv::Mat::zeros(src_.size(), src_.type());
+        src_points_.reserve(4);
+        dst_points_.reserve(4);
+    }
+
+    const auto& getSrc() const { return src_; }
+    const auto& getDst() const { return dst_; }
+    std::optional<cv::Mat> getWarped() const {
+        if (warped_.empty()) {
+            return std::nullopt;
+        }
+        return warped_;
+    }
+
+    auto getSrcPointsSize() const {
+        return src_points_.size();
+    }
+
+    auto getDstPointsSize() const {
+        return dst_points_.size();
+    }
+
+    constexpr std::string srcWindowName() const {
+        return "Src";
+    }
+    constexpr std::string dstWindowName() const {
+        return "Dst";
+    }
+
+    void setSrcPoints(cv::Point p) {
+        if (src_points_.size() >= 4) {
+            std::println("You have already 4 source points");
+            return;
+        }
+        src_points_.emplace_back(p);
+    }
+
+    void setDstPoints(cv::Point p) {
+        if (dst_points_.size() >= 4) {
+            std::println("You have already 4 destination points");
+            return;
+        }
+        dst_points_.emplace_back(p);
+    }
+
+    void process(bool source_to_dst = false) {
+        if (src_points_.size() != 4) {
+            emptySrc();
+        }
+
+        sortQuad(src_points_);
+
+        if (dst_.empty() or dst_points_.size() != 4) {
+            emptyDst();
+        }
+        else {
+            sortQuad(dst_points_);
+            dst_size_ = dst_.size();
+        }
+
+        auto h = cv::findHomography(src_points_, dst_points_);
+        if (h.empty()) {
+            std::println("Can't compute homography for given points");
+            return;
+        }
+
+        if (source_to_dst) {
+            compositeOnDst(h);
+            return;
+        }
+
+        warp(h, dst_size_);
+    }
+
+    void reset() {
+        src_points_.clear();
+        dst_points_.clear();
+    }
+
+    void toggleTiledWarp() {
+        use_tiled_warp_ = !use_tiled_warp_;
+        std::println("Tiled warp: {}", use_tiled_warp_ ? "on" : "off");
+    }
+
+
+private:
+    cv::Mat src_;
+    cv::Mat dst_;
+    cv::Mat warped_;
+    // Bounding-box scratch of compositeOnDst, so warped_ keeps the last full warp
+    cv::Mat quad_warped_;
+    cv::Mat coverage_;
+    cv::Size dst_size_;
+    bool use_tiled_warp_{ false };
+
+    std::vector<cv::Point> src_points_;
+    std::vector<cv::Point> dst_points_;
+
+    void warp(const cv::Mat& h, cv::Size size) {
+        if (use_tiled_warp_) {
+            playground::warpPerspective(src_, warped_, h, size);
+            return;
+        }
+        cv::warpPerspective(src_, warped_, h, size);
+    }
+
+    void compositeOnDst(const cv::Mat& h) {
+        std::vector<cv::Point2f> quad{ dst_points_.begin(), dst_points_.end() };
+        compositeIntoQuad(src_, dst_, h, quad, quad_warped_, coverage_, use_tiled_warp_);
+    }
+
+    void emptyDst() {
+        cv::Rect bbox = cv::boundingRect(src_points_);
+        dst_size_ = bbox.size();
+
+        dst_points_ = {
+            {0, 0},
+            {dst_size_.width - 1, 0},
+            {dst_size_.width - 1, dst_size_.height - 1},
+            {0, dst_size_.height - 1}
+        };
+    }
+
+    void emptySrc() {
+        src_points_ = {
+          {0, 0},
+          {src_.size().width - 1, 0},
+          {src_.size().width - 1, src_.size().height - 1},
+          {0, src_.size().height - 1}
+        };
+    }
+
+};
@@ -2,6 +2,8 @@
 // Created by Michał Maj on 21/06/2025.
 //
 
+#include <cctype>
+#include <chrono>
 #include <iostream>
 #include <opencv2/core.hpp>
 #include <opencv2/opencv.hpp>
@@ -11,142 +13,305 @@
 #include <print>
 #include <ranges>
 
-class Homography {
-public:
-    Homography(const std::filesystem::path& src, const std::filesystem::path& dst)
-        : src_(cv::imread(src.string())), dst_(cv::imread(dst.string())) {
-        src_points_.reserve(4);
-        dst_points_.reserve(4);
-    }
-    Homography(const std::filesystem::path& src) : src_(cv::imread(src.string())) {
-        dst_ = cv::Mat::zeros(src_.size(), src_.type());
-        src_points_.reserve(4);
-        dst_points_.reserve(4);
-    }
+#include "homography.hpp"
+#include "stage_timer.hpp"
 
-    const auto& getSrc() const { return src_; }
-    const auto& getDst() const { return dst_; }
-    std::optional<cv::Mat> getWarped() const {
-        if (warped_.empty()) {
-            return std::nullopt;
+// Tracks a planar quad through a video with pyramidal Lucas-Kanade and draws an overlay image onto it.
+// Points are tracked frame to frame but the homography is always estimated from the reference frame,
+// so errors don't accumulate. ORB re-detection only runs when too few inliers survive.
+class PlanarTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    PlanarTracker(const std::filesystem::path& overlay_path,
+        int max_points = 200,
+        int min_inliers = 20,
+        int tracking_width = 1280,
+        double budget_ms = 33.0,
+        float lowe_ratio = 0.75f,
+        double ransac_threshold = 3.0
+    ) :
+        overlay_(cv::imread(overlay_path.string())),
+        max_points_(max_points),
+        min_inliers_(min_inliers),
+        tracking_width_(tracking_width),
+        budget_ms_(budget_ms),
+        lowe_ratio_(lowe_ratio),
+        ransac_threshold_(ransac_threshold) {
+        if (overlay_.empty()) {
+            throw std::runtime_error(std::format("Can't load an image from: {}", overlay_path.string()));
         }
-        return warped_;
-    }
 
-    auto getSrcPointsSize() const {
-        return src_points_.size();
+        auto w{ static_cast<float>(overlay_.cols - 1) };
+        auto h{ static_cast<float>(overlay_.rows - 1) };
+        overlay_corners_ = { {0.0f, 0.0f}, {w, 0.0f}, {w, h}, {0.0f, h} };
     }
 
-    auto getDstPointsSize() const {
-        return dst_points_.size();
-    }
-
-    constexpr std::string srcWindowName() const {
-        return "Src";
-    }
-    constexpr std::string dstWindowName() const {
-        return "Dst";
-    }
+    // Starts tracking the quad given in frame coordinates
+    void init(const cv::Mat& frame, std::vector<cv::Point2f> quad) {
+        sortQuad(quad);
+        scale_ = std::min(1.0, static_cast<double>(tracking_width_) / frame.cols);
+        toTrackingGray(frame, prev_gray_);
 
-    void setSrcPoints(cv::Point p) {
-        if (src_points_.size() >= 4) {
-            std::println("You have already 4 source points");
-            return;
+        ref_quad_.clear();
+        for (const auto& p : quad) {
+            ref_quad_.emplace_back(p * scale_);
         }
-        src_points_.emplace_back(p);
+        quad_ = ref_quad_;
+        ref_to_frame_ = cv::Mat::eye(3, 3, CV_64F);
+
+        // Descriptors of the target, only used when tracking is lost
+        cv::Mat mask{ cv::Mat::zeros(prev_gray_.size(), CV_8UC1) };
+        std::vector<cv::Point> polygon{ ref_quad_.begin(), ref_quad_.end() };
+        cv::fillConvexPoly(mask, polygon, cv::Scalar::all(255));
+        orb_->detectAndCompute(prev_gray_, mask, ref_kp_, ref_descriptors_);
+
+        prev_points_.clear();
+        ref_points_.clear();
+        seedPoints(prev_gray_);
     }
 
-    void setDstPoints(cv::Point p) {
-        if (dst_points_.size() >= 4) {
-            std::println("You have already 4 destination points");
-            return;
+    // Tracks the quad into `frame` and draws the overlay on it, returns false if the target is lost
+    bool process(cv::Mat& frame) {
+        auto start{ Clock::now() };
+        {
+            auto t{ timer_.measure("grayscale") };
+            toTrackingGray(frame, gray_);
         }
-        dst_points_.emplace_back(p);
-    }
 
-    void process(bool source_to_dst = false) {
-        if (src_points_.size() != 4) {
-            emptySrc();
+        bool tracked{ track() };
+        if (!tracked) {
+            auto t{ timer_.measure("re-detection") };
+            ++redetections_;
+            tracked = redetect();
         }
 
-        sort_points(src_points_);
+        if (tracked) {
+            cv::perspectiveTransform(ref_quad_, quad_, ref_to_frame_);
+            tracked = cv::isContourConvex(quad_);
+        }
 
-        if (dst_.empty() or dst_points_.size() != 4) {
-            emptyDst();
+        if (tracked) {
+            if (prev_points_.size() < static_cast<size_t>(max_points_ / 2)) {
+                auto t{ timer_.measure("re-seeding") };
+                seedPoints(gray_);
+            }
+
+            auto t{ timer_.measure("warp + composite") };
+            std::vector<cv::Point2f> frame_quad;
+            frame_quad.reserve(quad_.size());
+            for (const auto& p : quad_) {
+                frame_quad.emplace_back(p * (1.0 / scale_));
+            }
+            cv::Mat h{ cv::getPerspectiveTransform(overlay_corners_, frame_quad) };
+            compositeIntoQuad(overlay_, frame, h, frame_quad, warped_, coverage_);
         }
         else {
-            sort_points(dst_points_);
-            dst_size_ = dst_.size();
+            prev_points_.clear();
+            ref_points_.clear();
         }
 
-        auto h = cv::findHomography(src_points_, dst_points_);
-
-        cv::warpPerspective(src_, warped_, h, dst_size_);
+        std::swap(prev_gray_, gray_);
+        ++frames_;
 
-        if (source_to_dst) {
-            cv::Mat mask = cv::Mat::zeros(dst_.size(), dst_.type());
-            cv::fillConvexPoly(mask, dst_points_, cv::Scalar(255, 255, 255));
-
-            dst_.setTo(cv::Scalar(0, 0, 0), mask);
-            cv::add(dst_, warped_, dst_);
+        auto ms{ std::chrono::duration<double, std::milli>(Clock::now() - start).count() };
+        timer_.add("frame", ms);
+        if (ms > budget_ms_) {
+            ++over_budget_;
         }
+        return tracked;
     }
 
-    void reset() {
-        src_points_.clear();
-        dst_points_.clear();
+    const auto& getQuad() const { return quad_; }
+    double getConfidence() const { return confidence_; }
+
+    void printReport() const {
+        std::println("Frames: {}, re-detections: {} ({:.1f}%), over {:.1f} ms budget: {} ({:.1f}%)",
+            frames_,
+            redetections_,
+            frames_ ? 100.0 * redetections_ / frames_ : 0.0,
+            budget_ms_,
+            over_budget_,
+            frames_ ? 100.0 * over_budget_ / frames_ : 0.0);
+        timer_.print();
     }
 
-
 private:
-    cv::Mat src_;
-    cv::Mat dst_;
+    // Overlay image and its corners
+    cv::Mat overlay_;
+    std::vector<cv::Point2f> overlay_corners_;
+
+    // Grayscale frames at tracking resolution
+    cv::Mat prev_gray_;
+    cv::Mat gray_;
+    cv::Mat full_gray_;
+
+    // Buffers for compositing
     cv::Mat warped_;
-    cv::Size dst_size_;
+    cv::Mat coverage_;
+
+    // Quad in the reference frame and in the current frame (tracking resolution)
+    std::vector<cv::Point2f> ref_quad_;
+    std::vector<cv::Point2f> quad_;
+    cv::Mat ref_to_frame_;
+
+    // Tracked points with their positions in the reference frame
+    std::vector<cv::Point2f> ref_points_;
+    std::vector<cv::Point2f> prev_points_;
+    std::vector<cv::Point2f> next_points_;
+    std::vector<uchar> status_;
+    std::vector<float> errors_;
+    cv::Mat inlier_mask_;
+
+    // Re-detection
+    cv::Ptr<cv::ORB> orb_{ cv::ORB::create(1000) };
+    cv::BFMatcher matcher_{ cv::NORM_HAMMING };
+    std::vector<cv::KeyPoint> ref_kp_;
+    cv::Mat ref_descriptors_;
+
+    // Configuration variables
+    int max_points_{};
+    int min_inliers_{};
+    int tracking_width_{};
+    double budget_ms_{};
+    float lowe_ratio_{};
+    double ransac_threshold_{};
+    double scale_{ 1.0 };
+    int min_distance_{ 7 };
+
+    // Statistics
+    playground::StageTimer timer_;
+    double confidence_{};
+    int frames_{};
+    int redetections_{};
+    int over_budget_{};
+
+    void toTrackingGray(const cv::Mat& frame, cv::Mat& gray) {
+        if (scale_ >= 1.0) {
+            cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+            return;
+        }
+        cv::cvtColor(frame, full_gray_, cv::COLOR_BGR2GRAY);
+        cv::resize(full_gray_, gray, {}, scale_, scale_, cv::INTER_AREA);
+    }
 
-    std::vector<cv::Point> src_points_;
-    std::vector<cv::Point> dst_points_;
+    // Keeps only the entries of both point sets for which keep(i) is true
+    template <typename Keep>
+    void compactPoints(Keep keep) {
+        size_t n{ 0 };
+        for (size_t i{ 0 }; i < next_points_.size(); ++i) {
+            if (keep(i)) {
+                ref_points_[n] = ref_points_[i];
+                next_points_[n] = next_points_[i];
+                ++n;
+            }
+        }
+        ref_points_.resize(n);
+        next_points_.resize(n);
+    }
 
-    void sort_points(std::vector<cv::Point>& points) {
-        if (points.size() != 4) return;
+    bool track() {
+        if (prev_points_.size() < static_cast<size_t>(min_inliers_)) {
+            return false;
+        }
 
-        cv::Point topLeft = *std::min_element(points.begin(), points.end(),
-            [](const cv::Point& a, const cv::Point& b) { return (a.x + a.y) < (b.x + b.y); });
+        {
+            auto t{ timer_.measure("optical flow") };
+            cv::calcOpticalFlowPyrLK(prev_gray_, gray_, prev_points_, next_points_, status_, errors_, cv::Size(21, 21), 3);
+        }
 
-        cv::Point bottomRight = *std::max_element(points.begin(), points.end(),
-            [](const cv::Point& a, const cv::Point& b) { return (a.x + a.y) < (b.x + b.y); });
+        auto t{ timer_.measure("homography") };
+        const auto tracked_before{ prev_points_.size() };
+        compactPoints([this](size_t i) { return status_[i] != 0; });
+        if (next_points_.size() < static_cast<size_t>(min_inliers_)) {
+            return false;
+        }
 
-        cv::Point topRight = *std::min_element(points.begin(), points.end(),
-            [](const cv::Point& a, const cv::Point& b) { return (a.x - a.y) > (b.x - b.y); });
+        cv::Mat h{ cv::findHomography(ref_points_, next_points_, cv::RANSAC, ransac_threshold_, inlier_mask_) };
+        if (h.empty()) {
+            return false;
+        }
+        compactPoints([this](size_t i) { return inlier_mask_.at<uchar>(static_cast<int>(i)) != 0; });
 
-        cv::Point bottomLeft = *std::max_element(points.begin(), points.end(),
-            [](const cv::Point& a, const cv::Point& b) { return (a.x - a.y) > (b.x - b.y); });
+        confidence_ = static_cast<double>(next_points_.size()) / static_cast<double>(tracked_before);
+        if (next_points_.size() < static_cast<size_t>(min_inliers_)) {
+            return false;
+        }
 
-        points = { topLeft, topRight, bottomRight, bottomLeft };
+        ref_to_frame_ = h;
+        std::swap(prev_points_, next_points_);
+        return true;
     }
 
+    bool redetect() {
+        std::vector<cv::KeyPoint> kp;
+        cv::Mat descriptors;
+        orb_->detectAndCompute(gray_, cv::noArray(), kp, descriptors);
+        if (descriptors.empty() or ref_descriptors_.empty()) {
+            return false;
+        }
 
-    void emptyDst() {
-        cv::Rect bbox = cv::boundingRect(src_points_);
-        dst_size_ = bbox.size();
+        std::vector<std::vector<cv::DMatch>> matches;
+        matcher_.knnMatch(ref_descriptors_, descriptors, matches, 2);
 
-        dst_points_ = {
-            {0, 0},
-            {dst_size_.width - 1, 0},
-            {dst_size_.width - 1, dst_size_.height - 1},
-            {0, dst_size_.height - 1}
-        };
-    }
+        std::vector<cv::Point2f> ref_pts, frame_pts;
+        for (const auto& m : matches) {
+            if (m.size() == 2 && m[0].distance < lowe_ratio_ * m[1].distance) {
+                ref_pts.emplace_back(ref_kp_[m[0].queryIdx].pt);
+                frame_pts.emplace_back(kp[m[0].trainIdx].pt);
+            }
+        }
+        if (ref_pts.size() < static_cast<size_t>(min_inliers_)) {
+            return false;
+        }
+
+        cv::Mat mask;
+        cv::Mat h{ cv::findHomography(ref_pts, frame_pts, cv::RANSAC, ransac_threshold_, mask) };
+        if (h.empty() or cv::countNonZero(mask) < min_inliers_) {
+            return false;
+        }
 
-    void emptySrc() {
-        src_points_ = {
-          {0, 0},
-          {src_.size().width - 1, 0},
-          {src_.size().width - 1, src_.size().height - 1},
-          {0, src_.size().height - 1}
-        };
+        ref_to_frame_ = h;
+        confidence_ = static_cast<double>(cv::countNonZero(mask)) / static_cast<double>(ref_pts.size());
+        cv::perspectiveTransform(ref_quad_, quad_, ref_to_frame_);
+        prev_points_.clear();
+        ref_points_.clear();
+        seedPoints(gray_);
+        return true;
     }
 
+    // Adds corners inside the current quad, away from the points already tracked
+    void seedPoints(const cv::Mat& gray) {
+        int needed{ max_points_ - static_cast<int>(prev_points_.size()) };
+        cv::Rect roi{ cv::boundingRect(quad_) & cv::Rect(0, 0, gray.cols, gray.rows) };
+        if (needed <= 0 or roi.empty()) {
+            return;
+        }
+
+        cv::Mat mask{ cv::Mat::zeros(roi.size(), CV_8UC1) };
+        std::vector<cv::Point> polygon;
+        for (const auto& p : quad_) {
+            polygon.emplace_back(cvRound(p.x) - roi.x, cvRound(p.y) - roi.y);
+        }
+        cv::fillConvexPoly(mask, polygon, cv::Scalar::all(255));
+        for (const auto& p : prev_points_) {
+            cv::circle(mask, cv::Point(cvRound(p.x) - roi.x, cvRound(p.y) - roi.y), min_distance_, cv::Scalar::all(0), -1);
+        }
+
+        std::vector<cv::Point2f> corners;
+        cv::goodFeaturesToTrack(gray(roi), corners, needed, 0.01, min_distance_, mask);
+        if (corners.empty()) {
+            return;
+        }
+        for (auto& c : corners) {
+            c += cv::Point2f(static_cast<float>(roi.x), static_cast<float>(roi.y));
+        }
+
+        std::vector<cv::Point2f> ref_corners;
+        cv::perspectiveTransform(corners, ref_corners, ref_to_frame_.inv());
+        prev_points_.insert(prev_points_.end(), corners.begin(), corners.end());
+        ref_points_.insert(ref_points_.end(), ref_corners.begin(), ref_corners.end());
+    }
 };
 
 void setSrcPoints(int event, int x, int y, int flag, void* data) {
@@ -167,7 +332,77 @@ void setDstPoints(int event, int x, int y, int flag, void* data) {
     }
 }
 
-int main() {
+void addTrackPoint(int event, int x, int y, int flag, void* data) {
+    auto* points = static_cast<std::vector<cv::Point2f>*>(data);
+    if (event == cv::EVENT_LBUTTONDOWN && points->size() < 4) {
+        points->emplace_back(static_cast<float>(x), static_cast<float>(y));
+    }
+}
+
+// Click 4 corners on the first frame, then the overlay follows them through the video
+int runTracking(const std::string& source, const std::filesystem::path& overlay_path) {
+    cv::VideoCapture cap;
+    if (!source.empty() && std::ranges::all_of(source, [](unsigned char c) { return std::isdigit(c); })) {
+        cap.open(std::stoi(source));
+    }
+    else {
+        cap.open(source);
+    }
+    if (!cap.isOpened()) {
+        std::cerr << std::format("Can't load video from: {}\n", source);
+        return EXIT_FAILURE;
+    }
+
+    PlanarTracker tracker{ overlay_path };
+
+    const std::string win_name{ "Track" };
+    cv::namedWindow(win_name, cv::WINDOW_AUTOSIZE);
+    std::vector<cv::Point2f> corners;
+    cv::setMouseCallback(win_name, addTrackPoint, &corners);
+
+    cv::Mat frame;
+    bool tracking{ false };
+    while (cap.read(frame)) {
+        if (!tracking) {
+            corners.clear();
+            while (corners.size() < 4) {
+                cv::Mat preview{ frame.clone() };
+                for (const auto& p : corners) {
+                    cv::circle(preview, p, 5, cv::Scalar(0, 0, 255), -1);
+                }
+                cv::imshow(win_name, preview);
+                // Closing the window would otherwise leave this loop waiting for clicks forever
+                const bool closed{ cv::getWindowProperty(win_name, cv::WND_PROP_VISIBLE) < 1 };
+                if (cv::waitKey(10) == 'q' or closed) {
+                    tracker.printReport();
+                    return EXIT_SUCCESS;
+                }
+            }
+            tracker.init(frame, corners);
+            tracking = true;
+            continue;
+        }
+
+        if (!tracker.process(frame)) {
+            cv::putText(frame, "Lost", { 20, 40 }, cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 0, 255), 2);
+        }
+        cv::imshow(win_name, frame);
+
+        auto c = cv::waitKey(1);
+        if (c == 'q' or cv::getWindowProperty(win_name, cv::WND_PROP_VISIBLE) < 1) {
+            break;
+        }
+        if (c == 'r') {
+            tracking = false;
+        }
+    }
+
+    tracker.printReport();
+    cv::destroyAllWindows();
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
     std::filesystem::path book2_path{ "../data/images/first-image.png" };
     std::filesystem::path book1_path{ "../data/images/times-square.png" };
 
@@ -181,6 +416,10 @@ int main() {
         return EXIT_FAILURE;
     }
 
+    if (argc > 1 && std::string_view{ argv[1] } == "track") {
+        return runTracking(argc > 2 ? argv[2] : "../data/videos/chaplin.mp4", book2_path);
+    }
+
     Homography h1{ book2_path, book1_path };
 
 
@@ -208,6 +447,10 @@ int main() {
             h1.reset();
         }
 
+        if (c == 't') {
+            h1.toggleTiledWarp();
+        }
+
         cv::imshow(h1.srcWindowName(), h1.getSrc());
         cv::imshow(h1.dstWindowName(), h1.getDst());
         if (h1.getWarped().has_value()) {
@@ -0,0 +1,107 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <opencv2/photo.hpp>
+#include <algorithm>
+#include <array>
+#include <format>
+#include <stdexcept>
+#include <string>
+
+class ImageInpainting {
+public:
+    ImageInpainting(const std::string& path) : img_(cv::imread(path, cv::IMREAD_GRAYSCALE)) {
+        if (img_.empty()) {
+            throw std::runtime_error(std::format("Can't load an image from: {}", path));
+        }
+        copy_ = img_.clone();
+        mask_ = cv::Mat::zeros(img_.size(), CV_8U);
+    }
+
+    cv::Mat process(int flag) {
+        cv::Mat processed_;
+        cv::inpaint(img_, mask_, processed_, 3, flag);
+
+        return processed_;
+    }
+
+    const cv::Mat& getImg() const {
+        return img_;
+    }
+
+    void setImg(const cv::Mat& img) {
+        img_ = img.clone();
+    }
+
+    cv::Mat& getMask() {
+        return mask_;
+    }
+
+    const cv::Mat& getCopy() const {
+        return copy_;
+    }
+
+    const std::string& getOriginalName() const {
+        return original_name_;
+    }
+
+    const std::string& getMaskName() const {
+        return mask_name_;
+    }
+
+    int& getLineIdx() {
+        return line_idx;
+    }
+
+    const int& getMaxLineIdx() const {
+        return max_line_idx;
+    }
+
+    const int& getTypeOfLine(int idx) {
+        return type_of_line.at(idx);
+    }
+
+    int& getLineThickness() {
+        line_thickness = std::clamp(line_thickness, 1, max_line_thickness);
+        return line_thickness;
+    }
+
+    const int& getMaxLineThickness() const {
+        return max_line_thickness;
+    }
+
+    void setPreviousPoint(const cv::Point& point) {
+        previous_point_ = point;
+    }
+
+    cv::Point getPreviousPoint() const {
+        return previous_point_;
+    }
+
+private:
+    // Matrices for images
+    cv::Mat img_;
+    cv::Mat mask_;
+    cv::Mat copy_;
+
+    // Point for drawing purpose
+    cv::Point previous_point_{ -1, -1 };
+
+    // Windows names
+    const std::string original_name_{ "Original Image" };
+    const std::string mask_name_{ "Mask" };
+
+    // Line type
+    static constexpr std::array<int, 3> type_of_line{ cv::LINE_4 , cv::LINE_8 , cv::LINE_AA };
+    int line_idx{ 0 };
+    int max_line_idx{ type_of_line.size() - 1 };
+
+    // Line thickness
+    int line_thickness{ 1 };
+    const int max_line_thickness{ 20 };
+};
@@ -0,0 +1,374 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "feature_pipeline.hpp"
+#include "robust_homography.hpp"
+#include "stage_timer.hpp"
+#include "warp_perspective.hpp"
+
+enum class RegistrationPipeline {
+    // ORB + RANSAC at full resolution
+    Features,
+    // ORB + RANSAC on a downscaled pyramid level, then ECC refinement at full resolution
+    CoarseToFine,
+    // Page outline of the scan mapped onto the template corners, Features when the outline isn't found
+    PageQuad
+};
+
+// ORB on scan and template, nearest neighbour by the named matcher, best fraction of matches, robust homography
+using RegistrationFeatures = playground::FeaturePipeline<playground::OrbDetector, playground::NamedMatcher,
+    playground::KeepBest, playground::RobustHomography>;
+
+class ImageRegistration {
+public:
+    ImageRegistration(const std::filesystem::path& src_path,
+        const std::filesystem::path& dst_path,
+        int num_features = 500,
+        float percent_features = 0.15f,
+        std::string&& matcher_type = "BruteForce-Hamming",
+        bool tiled_warp = false,
+        RegistrationPipeline pipeline = RegistrationPipeline::Features,
+        playground::RobustEstimator estimator = playground::RobustEstimator::Ransac,
+        bool tiled_features = true
+    ) :
+        src_(cv::imread(src_path.string())),
+        dst_(cv::imread(dst_path.string())),
+        tiled_warp_(tiled_warp),
+        pipeline_(pipeline),
+        features_(playground::OrbDetector{ num_features, tiled_features },
+            playground::NamedMatcher{ std::move(matcher_type) },
+            playground::KeepBest{ percent_features },
+            playground::RobustHomography{ estimator, 3.0 },
+            4) {
+        if (src_.empty()) {
+            throw std::runtime_error(std::format("Can't load an image from: {}", src_path.string()));
+        }
+
+        if (dst_.empty()) {
+            throw std::runtime_error(std::format("Can't load an image from: {}", dst_path.string()));
+        }
+
+        process();
+    }
+
+    const auto& getSrc() const { return src_; }
+    const auto& getDst() const { return dst_; }
+    const auto& getWarped() const { return warped_; }
+    const auto& getHomography() const { return homography_; }
+    const auto& getTimer() const { return timer_; }
+    const auto& getHomographyStats() const { return match_.stats; }
+    const auto& getKeypoints() const { return match_.keypoints; }
+    double getPageConfidence() const { return page_confidence_; }
+
+    // ECC correlation and mean absolute intensity error between the template and the warped image,
+    // both measured over the pixels covered by the warp
+    std::pair<double, double> alignmentError() const {
+        if (warped_.empty()) {
+            return { 0.0, 0.0 };
+        }
+        cv::Mat template_gray, warped_gray, valid;
+        cv::cvtColor(dst_, template_gray, cv::COLOR_BGR2GRAY);
+        cv::cvtColor(warped_, warped_gray, cv::COLOR_BGR2GRAY);
+        cv::warpPerspective(cv::Mat(src_.size(), CV_8UC1, cv::Scalar::all(255)), valid, homography_, dst_.size(),
+            cv::INTER_NEAREST);
+
+        cv::Mat diff;
+        cv::absdiff(template_gray, warped_gray, diff);
+        return { cv::computeECC(template_gray, warped_gray, valid), cv::mean(diff, valid)[0] };
+    }
+
+    cv::Mat showMatches(bool use_ransac_mask = true) {
+        cv::Mat mask{};
+        if (use_ransac_mask) {
+            mask = match_.inlier_mask;
+        }
+        cv::Mat output;
+        cv::drawMatches(src_,
+            match_.keypoints,
+            dst_,
+            dst_kp_.empty() ? features_.trainKeypoints() : dst_kp_,
+            match_.matches,
+            output,
+            cv::Scalar::all(-1),
+            cv::Scalar::all(-1),
+            mask);
+
+        return output;
+    }
+private:
+    // Matrices for images
+    cv::Mat src_;
+    cv::Mat dst_;
+    cv::Mat gray_;
+
+    // Matrix for homography
+    cv::Mat homography_;
+
+    // Matrix for warped image
+    cv::Mat warped_;
+
+    // Values for setup detect and match keypoints
+    bool tiled_warp_{};
+    RegistrationPipeline pipeline_{};
+
+    // The template is the train side, the scan the query
+    RegistrationFeatures features_;
+    playground::FeatureMatch match_;
+    // Template keypoints scaled to full resolution by the coarse-to-fine path, for drawing
+    std::vector<cv::KeyPoint> dst_kp_;
+
+    // Values for coarse-to-fine registration
+    int coarse_size_{ 1000 };
+    int band_radius_{ 4 };
+    int ecc_iterations_{ 50 };
+    double ecc_epsilon_{ 1e-6 };
+    double ecc_correlation_{};
+
+    // Values for page quad detection
+    int quad_size_{ 480 };
+    double min_page_area_{ 0.2 };
+    double min_page_confidence_{ 0.95 };
+    double page_confidence_{};
+
+    // Timings of the last run
+    playground::StageTimer timer_;
+
+    void process() {
+        if (pipeline_ == RegistrationPipeline::CoarseToFine) {
+            processCoarseToFine();
+            return;
+        }
+        if (pipeline_ == RegistrationPipeline::PageQuad && processPageQuad()) {
+            return;
+        }
+
+        {
+            auto t{ timer_.measure("features") };
+            findKeyPointsAndDescriptors(src_, dst_);
+        }
+        {
+            auto t{ timer_.measure("matching") };
+            features_.match(match_);
+        }
+        bool done{};
+        {
+            auto t{ timer_.measure("homography") };
+            done = calculateHomography();
+        }
+        if (!done) {
+            std::cerr << "No enough points to calculate homography\n";
+            return;
+        }
+        auto t{ timer_.measure("warp") };
+        warpImage();
+    }
+
+    void processCoarseToFine() {
+        // Both images go down by the same factor so the homography only needs one rescale
+        cv::Mat src_small{ src_ };
+        cv::Mat dst_small{ dst_ };
+        double scale{ 1.0 };
+        {
+            auto t{ timer_.measure("pyramid") };
+            while (std::max({ src_small.cols, src_small.rows, dst_small.cols, dst_small.rows }) > coarse_size_) {
+                cv::pyrDown(src_small, src_small);
+                cv::pyrDown(dst_small, dst_small);
+                scale *= 0.5;
+            }
+        }
+
+        {
+            auto t{ timer_.measure("coarse features") };
+            findKeyPointsAndDescriptors(src_small, dst_small);
+            features_.match(match_);
+            if (!calculateHomography()) {
+                std::cerr << "No enough points to calculate homography\n";
+                return;
+            }
+        }
+
+        // Coarse estimate at full resolution: H = S^-1 * H_small * S
+        const cv::Matx33d s{ scale, 0, 0, 0, scale, 0, 0, 0, 1 };
+        homography_ = cv::Mat(s.inv() * cv::Matx33d(homography_) * s);
+        dst_kp_ = features_.trainKeypoints();
+        for (auto& kp : match_.keypoints) {
+            kp.pt *= static_cast<float>(1.0 / scale);
+        }
+        for (auto& kp : dst_kp_) {
+            kp.pt *= static_cast<float>(1.0 / scale);
+        }
+
+        {
+            auto t{ timer_.measure("ecc refinement") };
+            refineEcc(src_small);
+        }
+
+        auto t{ timer_.measure("warp") };
+        warpImage();
+    }
+
+    // The template is the page itself, so its corners are the image corners
+    bool processPageQuad() {
+        std::vector<cv::Point2f> quad;
+        {
+            auto t{ timer_.measure("page quad") };
+            page_confidence_ = findPageQuad(quad);
+        }
+        if (page_confidence_ < min_page_confidence_) {
+            std::println("Page quad confidence {:.3f} is below {:.3f}, falling back to features",
+                page_confidence_, min_page_confidence_);
+            return false;
+        }
+
+        {
+            auto t{ timer_.measure("homography") };
+            const auto w{ static_cast<float>(dst_.cols - 1) };
+            const auto h{ static_cast<float>(dst_.rows - 1) };
+            const std::vector<cv::Point2f> corners{ {0.0f, 0.0f}, {w, 0.0f}, {w, h}, {0.0f, h} };
+            homography_ = cv::getPerspectiveTransform(quad, corners);
+        }
+
+        auto t{ timer_.measure("warp") };
+        warpImage();
+        return true;
+    }
+
+    // Outline of the page in the scan, found on a downscaled edge map: the convex hull of the largest
+    // external contour approximated by a polygon. Corners are returned clockwise from top-left at full
+    // resolution. Confidence is how well the quad covers the hull (area ratio), 0 when there is no
+    // convex quad covering at least min_page_area_ of the scan.
+    double findPageQuad(std::vector<cv::Point2f>& quad) {
+        const double scale{ std::min(1.0, static_cast<double>(quad_size_) / std::max(src_.cols, src_.rows)) };
+        cv::Mat small, gray, edges;
+        cv::resize(src_, small, {}, scale, scale, cv::INTER_AREA);
+        cv::cvtColor(small, gray, cv::COLOR_BGR2GRAY);
+        cv::GaussianBlur(gray, gray, cv::Size(5, 5), 0);
+        cv::Canny(gray, edges, 50, 150);
+        cv::dilate(edges, edges, cv::Mat{});
+
+        std::vector<std::vector<cv::Point>> contours;
+        cv::findContours(edges, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+        if (contours.empty()) {
+            return 0.0;
+        }
+        const auto& largest{ *std::ranges::max_element(contours, std::less{},
+            [](const auto& c) { return cv::contourArea(c); }) };
+
+        std::vector<cv::Point> hull, polygon;
+        cv::convexHull(largest, hull);
+        cv::approxPolyDP(hull, polygon, 0.02 * cv::arcLength(hull, true), true);
+        if (polygon.size() != 4 or !cv::isContourConvex(polygon)) {
+            return 0.0;
+        }
+
+        const double polygon_area{ cv::contourArea(polygon) };
+        const double hull_area{ cv::contourArea(hull) };
+        if (polygon_area < min_page_area_ * static_cast<double>(gray.total())) {
+            return 0.0;
+        }
+
+        // Top-left has the smallest x + y, top-right the smallest y - x
+        quad.assign(4, {});
+        const auto sum = [](const cv::Point& p) { return p.x + p.y; };
+        const auto diff = [](const cv::Point& p) { return p.y - p.x; };
+        quad[0] = *std::ranges::min_element(polygon, std::less{}, sum);
+        quad[1] = *std::ranges::min_element(polygon, std::less{}, diff);
+        quad[2] = *std::ranges::max_element(polygon, std::less{}, sum);
+        quad[3] = *std::ranges::max_element(polygon, std::less{}, diff);
+        for (auto& p : quad) {
+            p *= static_cast<float>(1.0 / scale);
+        }
+        return std::min(polygon_area, hull_area) / std::max(polygon_area, hull_area);
+    }
+
+    // Mask of textured regions of the scan, found on the coarse level and widened into a band
+    cv::Mat texturedBand(const cv::Mat& src_small) {
+        cv::Mat gray, grad_x, grad_y, magnitude, band;
+        cv::cvtColor(src_small, gray, cv::COLOR_BGR2GRAY);
+        cv::Sobel(gray, grad_x, CV_32F, 1, 0);
+        cv::Sobel(gray, grad_y, CV_32F, 0, 1);
+        cv::magnitude(grad_x, grad_y, magnitude);
+
+        cv::Scalar mean, stddev;
+        cv::meanStdDev(magnitude, mean, stddev);
+        cv::threshold(magnitude, band, mean[0] + stddev[0], 255, cv::THRESH_BINARY);
+        band.convertTo(band, CV_8U);
+        cv::dilate(band, band, cv::getStructuringElement(cv::MORPH_ELLIPSE,
+            cv::Size(2 * band_radius_ + 1, 2 * band_radius_ + 1)));
+
+        cv::Mat mask;
+        cv::resize(band, mask, src_.size(), 0, 0, cv::INTER_NEAREST);
+        return mask;
+    }
+
+    // ECC looks for W with scan(W(x)) ~ template(x), so it is initialized with the inverse of src -> dst
+    void refineEcc(const cv::Mat& src_small) {
+        cv::Mat template_gray, input_gray, warp;
+        cv::cvtColor(dst_, template_gray, cv::COLOR_BGR2GRAY);
+        cv::cvtColor(src_, input_gray, cv::COLOR_BGR2GRAY);
+        cv::Mat(homography_.inv()).convertTo(warp, CV_32F);
+
+        try {
+            ecc_correlation_ = cv::findTransformECC(template_gray,
+                input_gray,
+                warp,
+                cv::MOTION_HOMOGRAPHY,
+                cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, ecc_iterations_, ecc_epsilon_),
+                texturedBand(src_small),
+                5);
+        }
+        catch (const cv::Exception& e) {
+            std::cerr << std::format("ECC refinement failed, keeping the coarse estimate: {}\n", e.what());
+            return;
+        }
+
+        cv::Mat refined;
+        cv::Mat(warp.inv()).convertTo(refined, CV_64F);
+        homography_ = refined / refined.at<double>(2, 2);
+    }
+
+    void convertToGray(const cv::Mat& img) {
+        cv::cvtColor(img, gray_, cv::COLOR_BGR2GRAY);
+    }
+
+    void findKeyPointsAndDescriptors(const cv::Mat& src, const cv::Mat& dst) {
+        convertToGray(src);
+        features_.detect(gray_, match_.keypoints, match_.descriptors);
+        convertToGray(dst);
+        features_.setTrain(gray_);
+        dst_kp_.clear();
+    }
+
+    bool calculateHomography() {
+        // Matches are sorted by distance, which is the order PROSAC expects
+        if (!features_.estimate(match_)) {
+            return false;
+        }
+        homography_ = match_.homography;
+        std::cout << homography_ << '\n';
+        return true;
+    }
+
+    void warpImage() {
+        if (tiled_warp_) {
+            playground::warpPerspective(src_, warped_, homography_, dst_.size());
+            return;
+        }
+        cv::warpPerspective(src_, warped_, homography_, dst_.size());
+    }
+};
@@ -2,151 +2,353 @@
 // Created by Michał Maj on 21/06/2025.
 //
 
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <opencv2/core.hpp>
 #include <opencv2/opencv.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/photo.hpp>
 #include <filesystem>
+#include <memory>
+#include <print>
 #include <ranges>
+#include <span>
+#include <unordered_set>
 
-class ImageRegistration {
+#include "image_registration.hpp"
+#include "mapped_file.hpp"
+#include "robust_homography.hpp"
+#include "stage_timer.hpp"
+#include "video_stabilizer.hpp"
+#include "warp_perspective.hpp"
+
+// ORB keypoint locations and descriptors of a template, computed once and cached on disk.
+// File layout: header, count * cv::Point2f, count * descriptor_size bytes of descriptors.
+// The header also records the ORB settings, so a cache built with other ones can be told apart.
+// A loaded template points straight into the mapped file, nothing is copied.
+class TemplateFeatures {
 public:
-    ImageRegistration(const std::filesystem::path& src_path,
-        const std::filesystem::path& dst_path,
-        int num_features = 500,
-        float percent_features = 0.15f,
-        std::string&& matcher_type = "BruteForce-Hamming"
-    ) :
-        src_(cv::imread(src_path.string())),
-        dst_(cv::imread(dst_path.string())),
-        num_features_(num_features),
-        percent_features_(percent_features),
-        matcher_type_(std::move(matcher_type)) {
-        if (src_.empty()) {
-            throw std::runtime_error(std::format("Can't load an image from: {}", src_path.string()));
-        }
+    // Settings of the detector the features come from
+    struct Detector {
+        int32_t max_features;
+        int32_t levels;
+        float scale_factor;
+        int32_t edge_threshold;
+        int32_t patch_size;
+        int32_t fast_threshold;
 
-        if (dst_.empty()) {
-            throw std::runtime_error(std::format("Can't load an image from: {}", dst_path.string()));
+        static Detector of(const cv::ORB& orb) {
+            return { orb.getMaxFeatures(), orb.getNLevels(), static_cast<float>(orb.getScaleFactor()),
+                orb.getEdgeThreshold(), orb.getPatchSize(), orb.getFastThreshold() };
         }
 
-        process();
+        bool operator==(const Detector&) const = default;
+    };
+
+    TemplateFeatures(TemplateFeatures&&) = default;
+    TemplateFeatures& operator=(TemplateFeatures&&) = default;
+
+    // Copies would keep pointing into the other object's points
+    TemplateFeatures(const TemplateFeatures&) = delete;
+    TemplateFeatures& operator=(const TemplateFeatures&) = delete;
+
+    static TemplateFeatures compute(const cv::Mat& img, int num_features) {
+        cv::Mat gray;
+        cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
+
+        std::vector<cv::KeyPoint> kp;
+        TemplateFeatures t;
+        cv::Ptr<cv::ORB> orb{ cv::ORB::create(num_features) };
+        orb->detectAndCompute(gray, cv::Mat{}, kp, t.descriptors_);
+        t.detector_ = Detector::of(*orb);
+
+        t.owned_points_.reserve(kp.size());
+        for (const auto& k : kp) {
+            t.owned_points_.emplace_back(k.pt);
+        }
+        t.points_ = t.owned_points_;
+        t.size_ = img.size();
+        return t;
     }
 
-    const auto& getSrc() const { return src_; }
-    const auto& getDst() const { return dst_; }
-    const auto& getWarped() const { return warped_; }
+    static TemplateFeatures load(const std::filesystem::path& path) {
+        TemplateFeatures t;
+        t.mapping_ = std::make_shared<playground::MappedFile>(path);
+
+        Header header{};
+        if (t.mapping_->size() < sizeof(Header)) {
+            throw std::runtime_error(std::format("Invalid template cache: {}", path.string()));
+        }
+        std::memcpy(&header, t.mapping_->data(), sizeof(Header));
 
-    cv::Mat showMatches(bool use_ransac_mask = true) {
-        cv::Mat mask{};
-        if (use_ransac_mask) {
-            mask = mask_;
+        const size_t points_bytes{ header.count * sizeof(cv::Point2f) };
+        const size_t descriptor_bytes{ static_cast<size_t>(header.count) * header.descriptor_size };
+        if (std::memcmp(header.magic, magic_, sizeof(magic_)) != 0 or header.version != version_ or
+            t.mapping_->size() != sizeof(Header) + points_bytes + descriptor_bytes) {
+            throw std::runtime_error(std::format("Invalid template cache: {}", path.string()));
         }
-        cv::Mat output;
-        cv::drawMatches(src_,
-            kp1_,
-            dst_,
-            kp2_,
-            matches_,
-            output,
-            cv::Scalar::all(-1),
-            cv::Scalar::all(-1),
-            mask);
 
-        return output;
+        const uchar* base{ t.mapping_->data() + sizeof(Header) };
+        t.points_ = { reinterpret_cast<const cv::Point2f*>(base), header.count };
+        t.descriptors_ = cv::Mat(static_cast<int>(header.count), static_cast<int>(header.descriptor_size), CV_8U,
+            const_cast<uchar*>(base + points_bytes));
+        t.size_ = { header.width, header.height };
+        t.detector_ = header.detector;
+        return t;
     }
-private:
-    // Matrices for images
-    cv::Mat src_;
-    cv::Mat dst_;
-    cv::Mat gray_;
 
-    // Matrices for descriptors
-    cv::Mat descriptors1_;
-    cv::Mat descriptors2_;
+    void save(const std::filesystem::path& path) const {
+        std::ofstream file{ path, std::ios::binary };
+        if (!file) {
+            throw std::runtime_error(std::format("Can't write template cache: {}", path.string()));
+        }
 
-    // Matrix for mask
-    cv::Mat mask_;
+        Header header{};
+        std::memcpy(header.magic, magic_, sizeof(magic_));
+        header.version = version_;
+        header.width = size_.width;
+        header.height = size_.height;
+        header.count = static_cast<uint32_t>(points_.size());
+        header.descriptor_size = static_cast<uint32_t>(descriptors_.cols);
+        header.detector = detector_;
 
-    // Matrix for homography
-    cv::Mat homography_;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        file.write(reinterpret_cast<const char*>(points_.data()), static_cast<std::streamsize>(points_.size_bytes()));
+        for (int r{ 0 }; r < descriptors_.rows; ++r) {
+            file.write(descriptors_.ptr<char>(r), descriptors_.cols);
+        }
+    }
 
-    // Matrix for warped image
-    cv::Mat warped_;
+    std::span<const cv::Point2f> getPoints() const { return points_; }
+    const cv::Mat& getDescriptors() const { return descriptors_; }
+    cv::Size getSize() const { return size_; }
+    const Detector& getDetector() const { return detector_; }
 
-    // Store keypoints
-    std::vector<cv::KeyPoint> kp1_;
-    std::vector<cv::KeyPoint> kp2_;
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        int32_t width;
+        int32_t height;
+        uint32_t count;
+        uint32_t descriptor_size;
+        Detector detector;
+    };
+    static constexpr char magic_[4]{ 'O', 'R', 'B', 'T' };
+    static constexpr uint32_t version_{ 2 };
 
-    // Store matches
-    std::vector<cv::DMatch> matches_;
+    TemplateFeatures() = default;
 
-    // Store points for homography
-    std::vector<cv::Point> src_pts_;
-    std::vector<cv::Point> dst_pts_;
+    std::shared_ptr<playground::MappedFile> mapping_;
+    std::vector<cv::Point2f> owned_points_;
+    std::span<const cv::Point2f> points_;
+    cv::Mat descriptors_;
+    cv::Size size_;
+    Detector detector_{};
+};
 
-    // Values for setup detect and match keypoints
-    int num_features_{};
-    float percent_features_{};
-    std::string matcher_type_{};
+// Registers every scan in a directory against one cached template, in parallel across cores.
+// Per scan only the scan's own features are extracted, the template side comes from the cache
+// and is the train side of one RegistrationFeatures pipeline shared by all workers.
+class BatchRegistration {
+public:
+    struct Result {
+        std::filesystem::path scan;
+        cv::Mat homography;
+        double ms{};
+    };
 
-    void process() {
-        findKeyPointsAndDescriptors();
-        matchFeatures();
-        getGoodMatches();
-        auto done = calculateHomography();
-        if (!done) {
-            std::cerr << "No enough points to calculate homography\n";
-            return;
+    BatchRegistration(TemplateFeatures features,
+        int num_features = 500,
+        float percent_features = 0.15f,
+        bool tiled_warp = false
+    ) :
+        template_(std::move(features)),
+        tiled_warp_(tiled_warp),
+        features_(playground::OrbDetector{ num_features, false },
+            playground::NamedMatcher{},
+            playground::KeepBest{ percent_features },
+            playground::RobustHomography{ playground::RobustEstimator::Ransac, 3.0 },
+            4) {
+        // Only the positions of the template keypoints are cached
+        std::vector<cv::KeyPoint> kp;
+        kp.reserve(template_.getPoints().size());
+        for (const auto& p : template_.getPoints()) {
+            kp.emplace_back(p, 31.0f);
         }
-        warpImage();
+        features_.setTrain(std::move(kp), template_.getDescriptors());
     }
 
-    void convertToGray(const cv::Mat& img) {
-        cv::cvtColor(img, gray_, cv::COLOR_BGR2GRAY);
-    }
+    // Writes <stem>_registered.png for every scan and homographies.csv into output_dir
+    std::vector<Result> run(const std::filesystem::path& scan_dir, const std::filesystem::path& output_dir) const {
+        if (!std::filesystem::is_directory(scan_dir)) {
+            throw std::runtime_error(std::format("Invalid directory path: {}", scan_dir.string()));
+        }
+        std::filesystem::create_directories(output_dir);
 
-    void findKeyPointsAndDescriptors() {
-        cv::Ptr<cv::ORB> orb{ cv::ORB::create(num_features_) };
-        convertToGray(src_);
-        orb->detectAndCompute(gray_, cv::Mat{}, kp1_, descriptors1_);
-        convertToGray(dst_);
-        orb->detectAndCompute(gray_, cv::Mat{}, kp2_, descriptors2_);
-    }
+        std::vector<std::filesystem::path> scans;
+        for (const auto& e : std::filesystem::directory_iterator(scan_dir)) {
+            if (e.is_regular_file() and valid_extensions_.contains(e.path().extension().string())) {
+                scans.emplace_back(e.path());
+            }
+        }
+        std::ranges::sort(scans);
 
-    void matchFeatures() {
-        cv::Ptr<cv::DescriptorMatcher> matcher{ cv::DescriptorMatcher::create(matcher_type_) };
-        matcher->match(descriptors1_, descriptors2_, matches_);
-        std::ranges::sort(matches_, std::less{});
-    }
+        std::vector<Result> results(scans.size());
+        cv::parallel_for_(cv::Range(0, static_cast<int>(scans.size())), [&](const cv::Range& range) {
+            // Reused by the scans of one worker
+            playground::FeatureMatch match;
+            for (int i{ range.start }; i < range.end; ++i) {
+                results[i] = registerScan(scans[i], output_dir, match);
+            }
+        });
 
-    void getGoodMatches() {
-        int take{ static_cast<int>(matches_.size() * percent_features_) };
-        matches_ = matches_ | std::views::take(take) | std::ranges::to<std::vector>();
+        writeHomographies(results, output_dir / "homographies.csv");
+        return results;
     }
 
-    bool calculateHomography() {
-        if (matches_.size() < 4) {
-            return false;
+private:
+    // Keeps the mapping the train descriptors point into
+    TemplateFeatures template_;
+    bool tiled_warp_{};
+    // Template as the train side, scans as queries
+    RegistrationFeatures features_;
+    static inline std::unordered_set<std::string> valid_extensions_{ ".jpg", ".jpeg", ".png", ".tif", ".tiff" };
+
+    Result registerScan(const std::filesystem::path& path, const std::filesystem::path& output_dir,
+        playground::FeatureMatch& match) const {
+        auto start{ std::chrono::steady_clock::now() };
+        Result result{ path, {}, 0.0 };
+
+        cv::Mat scan{ cv::imread(path.string()) };
+        if (scan.empty()) {
+            std::cerr << std::format("Can't load an image from: {}\n", path.string());
+            return result;
         }
 
-        for (const auto& match : matches_) {
-            src_pts_.emplace_back(kp1_[match.queryIdx].pt);
-            dst_pts_.emplace_back(kp2_[match.trainIdx].pt);
+        cv::Mat gray;
+        cv::cvtColor(scan, gray, cv::COLOR_BGR2GRAY);
+        if (!features_.process(gray, match)) {
+            return result;
         }
+        result.homography = match.homography;
 
-        homography_ = cv::findHomography(src_pts_, dst_pts_, cv::RANSAC, 3.0, mask_);
-        std::cout << homography_ << '\n';
-        return true;
+        cv::Mat warped;
+        if (tiled_warp_) {
+            playground::warpPerspective(scan, warped, result.homography, template_.getSize());
+        }
+        else {
+            cv::warpPerspective(scan, warped, result.homography, template_.getSize());
+        }
+        cv::imwrite((output_dir / (path.stem().string() + "_registered.png")).string(), warped);
+
+        result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return result;
     }
 
-    void warpImage() {
-        cv::warpPerspective(src_, warped_, homography_, dst_.size());
+    static void writeHomographies(const std::vector<Result>& results, const std::filesystem::path& path) {
+        std::ofstream file{ path };
+        file << "scan,h00,h01,h02,h10,h11,h12,h20,h21,h22\n";
+        for (const auto& r : results) {
+            if (r.homography.empty()) {
+                continue;
+            }
+            file << r.scan.filename().string();
+            for (int i{ 0 }; i < 9; ++i) {
+                file << ',' << std::format("{:.9g}", r.homography.at<double>(i / 3, i % 3));
+            }
+            file << '\n';
+        }
     }
 };
 
-int main() {
+// Loads the template cache, or builds it when it's missing, older than the template image, unreadable
+// (e.g. written by an older version) or computed with other ORB settings than `num_features` asks for
+TemplateFeatures loadOrBuildTemplate(const std::filesystem::path& template_path,
+    const std::filesystem::path& cache_path, int num_features) {
+    if (std::filesystem::exists(cache_path) and
+        std::filesystem::last_write_time(cache_path) >= std::filesystem::last_write_time(template_path)) {
+        try {
+            auto cached{ TemplateFeatures::load(cache_path) };
+            if (cached.getDetector() == TemplateFeatures::Detector::of(*cv::ORB::create(num_features))) {
+                return cached;
+            }
+            std::println("Template cache {} was built with other ORB settings, rebuilding", cache_path.string());
+        }
+        catch (std::exception& e) {
+            std::println("{}, rebuilding", e.what());
+        }
+    }
+
+    cv::Mat img{ cv::imread(template_path.string()) };
+    if (img.empty()) {
+        throw std::runtime_error(std::format("Can't load an image from: {}", template_path.string()));
+    }
+    TemplateFeatures::compute(img, num_features).save(cache_path);
+    std::println("Template cache written to: {}", cache_path.string());
+    return TemplateFeatures::load(cache_path);
+}
+
+// Runs the pipelines on the same pair and prints latency, stage breakdown and alignment quality.
+// Coverage is the share of 8x8 grid cells of the scan holding an ORB keypoint.
+int runComparison(const std::filesystem::path& src_path, const std::filesystem::path& dst_path) {
+    struct Config {
+        std::string_view name;
+        RegistrationPipeline pipeline;
+        bool tiled_features;
+    };
+    std::println("{:<20} {:>10} {:>10} {:>12} {:>9}", "pipeline", "total ms", "ecc", "mean abs err", "coverage");
+    for (auto [name, pipeline, tiled] : { Config{ "features", RegistrationPipeline::Features, false },
+                                          Config{ "features (tiled)", RegistrationPipeline::Features, true },
+                                          Config{ "coarse-to-fine", RegistrationPipeline::CoarseToFine, true },
+                                          Config{ "page quad", RegistrationPipeline::PageQuad, true } }) {
+        auto start{ std::chrono::steady_clock::now() };
+        ImageRegistration ir(src_path, dst_path, 500, 0.15f, "BruteForce-Hamming", false, pipeline,
+            playground::RobustEstimator::Ransac, tiled);
+        auto ms{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() };
+
+        auto [ecc, mae] = ir.alignmentError();
+        const auto coverage{ pipeline == RegistrationPipeline::Features
+            ? std::format("{:.1f}%", 100.0 * playground::gridCoverage(ir.getKeypoints(), ir.getSrc().size()))
+            : std::string{ "-" } };
+        std::println("{:<20} {:>10.2f} {:>10.5f} {:>12.3f} {:>9}", name, ms, ecc, mae, coverage);
+        ir.getTimer().print();
+        std::println("");
+    }
+    return EXIT_SUCCESS;
+}
+
+int runBatch(const std::filesystem::path& scan_dir, const std::filesystem::path& output_dir,
+    const std::filesystem::path& template_path, const std::filesystem::path& cache_path) {
+    try {
+        auto start{ std::chrono::steady_clock::now() };
+        BatchRegistration batch{ loadOrBuildTemplate(template_path, cache_path, 500) };
+        auto results{ batch.run(scan_dir, output_dir) };
+        auto total{ std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+
+        auto registered{ std::ranges::count_if(results, [](const auto& r) { return !r.homography.empty(); }) };
+        double scan_ms{ 0.0 };
+        for (const auto& r : results) {
+            scan_ms += r.ms;
+        }
+        std::println("Registered {} / {} scans in {:.2f} s ({:.1f} scans/s, {:.1f} ms per scan per worker)",
+            registered,
+            results.size(),
+            total,
+            results.size() / total,
+            registered ? scan_ms / registered : 0.0);
+    }
+    catch (std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
     std::filesystem::path path1{ "../data/images/scanned-form.png" };
     if (!std::filesystem::exists(path1)) {
         std::cerr << std::format("Can't find file at given location: {}", path1.string());
@@ -159,7 +361,65 @@ int main() {
         return EXIT_FAILURE;
     }
 
-    ImageRegistration ir(path1, path2);
+    if (argc > 1 && std::string_view{ argv[1] } == "compare") {
+        return runComparison(argc > 2 ? std::filesystem::path{ argv[2] } : path1,
+            argc > 3 ? std::filesystem::path{ argv[3] } : path2);
+    }
+
+    if (argc > 1 && std::string_view{ argv[1] } == "batch") {
+        if (argc < 4) {
+            std::cerr << "Usage: image_registration batch <scan_dir> <output_dir> [template] [cache]\n";
+            return EXIT_FAILURE;
+        }
+        std::filesystem::path template_path{ argc > 4 ? std::filesystem::path{ argv[4] } : path2 };
+        // Next to the binary by default, data/ only holds inputs
+        std::filesystem::path cache_path{ template_path.filename() };
+        cache_path.replace_extension(".orb");
+        if (argc > 5) {
+            cache_path = argv[5];
+        }
+        return runBatch(argv[2], argv[3], template_path, cache_path);
+    }
+
+    if (argc > 1 && std::string_view{ argv[1] } == "stabilize") {
+        const std::string source{ argc > 2 ? argv[2] : "../data/videos/chaplin.mp4" };
+        const std::filesystem::path output{ argc > 3 ? argv[3] : "stabilized.mp4" };
+        const bool homography{ argc > 4 && std::string_view{ argv[4] } == "homography" };
+        try {
+            VideoStabilizer stabilizer{ 500, homography ? MotionModel::Homography : MotionModel::Similarity };
+            stabilizer.run(source, output);
+            stabilizer.printReport();
+        }
+        catch (std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // "page" registers with the page outline, any other argument selects the robust estimator
+    const bool page{ argc > 1 && std::string_view{ argv[1] } == "page" };
+    playground::RobustEstimator estimator{ playground::RobustEstimator::Ransac };
+    if (argc > 1 && !page) {
+        try {
+            estimator = playground::parseRobustEstimator(argv[1]);
+        }
+        catch (std::exception& e) {
+            std::cerr << std::format("{}\nUsage: image_registration [{} | page | compare [scan] [template] | "
+                "batch <scan_dir> <output_dir> [template] [cache] | stabilize [video] [output] [similarity | homography]]\n",
+                e.what(), playground::robustEstimatorNames());
+            return EXIT_FAILURE;
+        }
+    }
+    ImageRegistration ir(path1, path2, 500, 0.15f, "BruteForce-Hamming", false,
+        page ? RegistrationPipeline::PageQuad : RegistrationPipeline::Features, estimator);
+    if (page) {
+        std::println("Page quad confidence: {:.3f}", ir.getPageConfidence());
+        ir.getTimer().print();
+    }
+    else {
+        ir.getHomographyStats().print(estimator);
+    }
 
     auto matched = ir.showMatches();
 
@@ -0,0 +1,311 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <mutex>
+#include <print>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "blocking_queue.hpp"
+#include "image_registration.hpp"
+#include "robust_homography.hpp"
+#include "stage_timer.hpp"
+#include "warp_perspective.hpp"
+
+enum class MotionModel {
+    // Rotation, uniform scale and translation, cv::estimateAffinePartial2D
+    Similarity,
+    // Full perspective, playground::findHomography
+    Homography
+};
+
+// Frame-to-frame registration of a video with trajectory smoothing. Every frame is registered to the
+// previous one with the RegistrationFeatures pipeline of ImageRegistration. The previous frame stays its
+// train side, so only one side is extracted per frame.
+// The accumulated trajectory is smoothed with a centered moving average of `radius` frames each side,
+// so a frame leaves the pipeline `radius` frames after it was decoded (bounded lookahead).
+//
+// Decode, estimation and warp run on their own threads connected by bounded queues. A stage that fails closes
+// the queues on both of its sides, a stage whose output queue was closed closes its input, so the whole
+// pipeline winds down and run() rethrows the first error once the threads are joined.
+class VideoStabilizer {
+public:
+    VideoStabilizer(int num_features = 500,
+        MotionModel model = MotionModel::Similarity,
+        int radius = 15,
+        double crop = 0.05,
+        int analysis_width = 640,
+        playground::RobustEstimator estimator = playground::RobustEstimator::Ransac
+    ) :
+        num_features_(num_features),
+        model_(model),
+        radius_(radius),
+        crop_(crop),
+        analysis_width_(analysis_width),
+        features_(playground::OrbDetector{ num_features, true },
+            playground::NamedMatcher{},
+            playground::KeepBest{ keep_fraction_ },
+            playground::RobustHomography{ estimator, ransac_threshold_ },
+            10) {}
+
+    // Stabilizes `source` (file or camera index) into `output`, nothing is written for an empty path
+    void run(const std::string& source, const std::filesystem::path& output) {
+        cv::VideoCapture cap;
+        if (!source.empty() && std::ranges::all_of(source, [](unsigned char c) { return std::isdigit(c); })) {
+            cap.open(std::stoi(source));
+        }
+        else {
+            cap.open(source);
+        }
+        if (!cap.isOpened()) {
+            throw std::runtime_error(std::format("Can't load video from: {}", source));
+        }
+        fps_ = cap.get(cv::CAP_PROP_FPS) > 0.0 ? cap.get(cv::CAP_PROP_FPS) : 30.0;
+
+        cv::VideoWriter writer;
+        playground::BlockingQueue<Frame> decoded{ queue_size_ };
+        playground::BlockingQueue<Frame> estimated{ queue_size_ };
+        playground::BlockingQueue<Frame> stabilized{ queue_size_ };
+
+        std::exception_ptr failure;
+        std::mutex failure_mutex;
+        auto guarded = [&](auto&& stage, auto&... queues) {
+            try {
+                stage();
+            }
+            catch (...) {
+                {
+                    std::lock_guard lock{ failure_mutex };
+                    if (!failure) {
+                        failure = std::current_exception();
+                    }
+                }
+                (queues.close(), ...);
+            }
+        };
+
+        auto start{ std::chrono::steady_clock::now() };
+        {
+            std::jthread decoder{ [&] { guarded([&] { decode(cap, decoded); }, decoded); } };
+            std::jthread estimator{ [&] { guarded([&] { estimate(decoded, estimated); }, decoded, estimated); } };
+            std::jthread warper{ [&] { guarded([&] { smoothAndWarp(estimated, stabilized); }, estimated, stabilized); } };
+
+            guarded([&] {
+                while (auto frame{ stabilized.pop() }) {
+                    auto t{ write_timer_.measure("write") };
+                    if (!output.empty() && !writer.isOpened()) {
+                        writer.open(output.string(), cv::VideoWriter::fourcc('m', 'p', '4', 'v'), fps_, frame->image.size());
+                    }
+                    if (writer.isOpened()) {
+                        writer.write(frame->image);
+                    }
+                    ++frames_;
+                }
+            }, stabilized);
+        }
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+        seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void printReport() const {
+        std::println("Frames: {}, {:.2f} s, {:.1f} fps ({:.2f}x real time at {:.1f} fps), lookahead {} frames ({:.0f} ms)",
+            frames_,
+            seconds_,
+            seconds_ > 0.0 ? frames_ / seconds_ : 0.0,
+            seconds_ > 0.0 ? frames_ / seconds_ / fps_ : 0.0,
+            fps_,
+            radius_,
+            1000.0 * radius_ / fps_);
+        std::println("Registration failures: {}", failures_);
+        for (const auto* timer : { &decode_timer_, &estimate_timer_, &warp_timer_, &write_timer_ }) {
+            timer->print();
+        }
+    }
+
+private:
+    struct Frame {
+        int index{};
+        cv::Mat image;
+        // Maps this frame into the coordinates of the first one
+        cv::Matx33d to_first{ cv::Matx33d::eye() };
+    };
+
+    // Configuration variables
+    int num_features_{};
+    MotionModel model_{};
+    int radius_{};
+    double crop_{};
+    int analysis_width_{};
+    size_t queue_size_{ 8 };
+    // Consecutive frames overlap almost entirely, so a larger share of the matches is kept than for scans
+    static constexpr float keep_fraction_{ 0.3f };
+    static constexpr double ransac_threshold_{ 3.0 };
+
+    // Previous frame at analysis resolution as the train side, the current one as the query
+    RegistrationFeatures features_;
+    playground::FeatureMatch match_;
+    bool has_previous_{ false };
+
+    // Statistics, one timer per thread
+    playground::StageTimer decode_timer_;
+    playground::StageTimer estimate_timer_;
+    playground::StageTimer warp_timer_;
+    playground::StageTimer write_timer_;
+    double fps_{ 30.0 };
+    double seconds_{};
+    int frames_{};
+    int failures_{};
+
+    void decode(cv::VideoCapture& cap, playground::BlockingQueue<Frame>& out) {
+        for (int index{ 0 };; ++index) {
+            Frame frame{ index, {}, cv::Matx33d::eye() };
+            {
+                auto t{ decode_timer_.measure("decode") };
+                if (!cap.read(frame.image)) {
+                    break;
+                }
+            }
+            if (!out.push(std::move(frame))) {
+                break;
+            }
+        }
+        out.close();
+    }
+
+    void estimate(playground::BlockingQueue<Frame>& in, playground::BlockingQueue<Frame>& out) {
+        cv::Matx33d to_first{ cv::Matx33d::eye() };
+        while (auto frame{ in.pop() }) {
+            {
+                auto t{ estimate_timer_.measure("estimate") };
+                to_first = to_first * motionToPrevious(frame->image);
+            }
+            frame->to_first = to_first;
+            if (!out.push(std::move(*frame))) {
+                in.close();
+                break;
+            }
+        }
+        out.close();
+    }
+
+    // Motion mapping the current frame onto the previous one, identity when registration fails
+    cv::Matx33d motionToPrevious(const cv::Mat& image) {
+        const double scale{ std::min(1.0, static_cast<double>(analysis_width_) / image.cols) };
+        cv::Mat small, gray;
+        cv::resize(image, small, {}, scale, scale, cv::INTER_AREA);
+        cv::cvtColor(small, gray, cv::COLOR_BGR2GRAY);
+
+        features_.detect(gray, match_.keypoints, match_.descriptors);
+
+        cv::Matx33d motion{ cv::Matx33d::eye() };
+        if (has_previous_) {
+            features_.match(match_);
+            cv::Mat m;
+            if (model_ == MotionModel::Similarity) {
+                // The pipeline's estimator fits a homography, a similarity is fitted to the same matches
+                if (match_.matches.size() >= 10) {
+                    std::vector<cv::Point2f> cur_pts, prev_pts;
+                    cur_pts.reserve(match_.matches.size());
+                    prev_pts.reserve(match_.matches.size());
+                    for (const auto& e : match_.matches) {
+                        cur_pts.push_back(match_.keypoints[e.queryIdx].pt);
+                        prev_pts.push_back(features_.trainKeypoints()[e.trainIdx].pt);
+                    }
+                    cv::Mat affine{ cv::estimateAffinePartial2D(cur_pts, prev_pts, cv::noArray(), cv::RANSAC, ransac_threshold_) };
+                    if (!affine.empty()) {
+                        m = cv::Mat::eye(3, 3, CV_64F);
+                        affine.copyTo(m(cv::Rect(0, 0, 3, 2)));
+                    }
+                }
+            }
+            else if (features_.estimate(match_)) {
+                m = match_.homography;
+            }
+
+            if (m.empty()) {
+                ++failures_;
+            }
+            else {
+                // Back to full resolution: S^-1 * M * S
+                const cv::Matx33d s{ scale, 0, 0, 0, scale, 0, 0, 0, 1 };
+                motion = s.inv() * cv::Matx33d(m) * s;
+            }
+        }
+
+        // Moved, so the next detection can't write into the train descriptors
+        features_.setTrain(std::move(match_.keypoints), std::move(match_.descriptors));
+        match_.keypoints.clear();
+        has_previous_ = true;
+        return motion;
+    }
+
+    // Holds up to `radius` frames until their future trajectory is known, then warps them onto
+    // the smoothed trajectory
+    void smoothAndWarp(playground::BlockingQueue<Frame>& in, playground::BlockingQueue<Frame>& out) {
+        std::vector<cv::Matx33d> trajectory;
+        std::deque<Frame> pending;
+        int next{ 0 };
+
+        // False once the output was closed
+        auto emit = [&](int last_known) {
+            auto t{ warp_timer_.measure("smooth + warp") };
+            Frame frame{ std::move(pending.front()) };
+            pending.pop_front();
+
+            cv::Matx33d smoothed{ cv::Matx33d::zeros() };
+            const int first{ std::max(0, next - radius_) };
+            const int last{ std::min(last_known, next + radius_) };
+            for (int i{ first }; i <= last; ++i) {
+                smoothed += trajectory[i] * (1.0 / trajectory[i](2, 2));
+            }
+            smoothed *= 1.0 / (last - first + 1);
+
+            // Frame -> first frame -> smoothed position, then a fixed zoom hides the moving borders
+            const cv::Matx33d correction{ zoom(frame.image.size()) * smoothed.inv() * frame.to_first };
+            cv::Mat stabilized;
+            playground::warpPerspective(frame.image, stabilized, cv::Mat(correction), frame.image.size());
+            frame.image = stabilized;
+            ++next;
+            return out.push(std::move(frame));
+        };
+
+        while (auto frame{ in.pop() }) {
+            trajectory.push_back(frame->to_first);
+            pending.push_back(std::move(*frame));
+            if (static_cast<int>(trajectory.size()) > next + radius_ && !emit(static_cast<int>(trajectory.size()) - 1)) {
+                in.close();
+                return;
+            }
+        }
+        while (!pending.empty()) {
+            if (!emit(static_cast<int>(trajectory.size()) - 1)) {
+                break;
+            }
+        }
+        out.close();
+    }
+
+    // Scales about the center by 1 / (1 - 2 * crop)
+    cv::Matx33d zoom(cv::Size size) const {
+        const double s{ 1.0 / (1.0 - 2.0 * crop_) };
+        const double cx{ size.width / 2.0 };
+        const double cy{ size.height / 2.0 };
+        return { s, 0, (1.0 - s) * cx, 0, s, (1.0 - s) * cy, 0, 0, 1 };
+    }
+};
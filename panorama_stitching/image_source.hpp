@@ -0,0 +1,355 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+// Dimensions from the file header without decoding: PNG IHDR, JPEG start-of-frame.
+// Returns an empty size for anything else, callers then have to decode.
+inline cv::Size imageSize(const std::filesystem::path& path) {
+    std::ifstream file{ path, std::ios::binary };
+    auto byte = [&] { return static_cast<unsigned>(file.get()); };
+    auto be16 = [&] { const unsigned hi{ byte() }; return hi << 8 | byte(); };
+    auto be32 = [&] { const unsigned hi{ be16() }; return hi << 16 | be16(); };
+
+    const unsigned magic{ be16() };
+    if (magic == 0x8950) {
+        // 8 byte signature, IHDR length and type, then width and height
+        file.seekg(16);
+        const auto width{ static_cast<int>(be32()) };
+        const auto height{ static_cast<int>(be32()) };
+        return file ? cv::Size{ width, height } : cv::Size{};
+    }
+    if (magic != 0xFFD8) {
+        return {};
+    }
+    while (file) {
+        unsigned marker{ byte() };
+        if (marker != 0xFF) {
+            return {};
+        }
+        while (marker == 0xFF) {
+            marker = byte();
+        }
+        // Standalone markers carry no length
+        if (marker == 0x01 or (marker >= 0xD0 and marker <= 0xD9)) {
+            continue;
+        }
+        const unsigned length{ be16() };
+        // SOF0..SOF15 except DHT (C4), JPG (C8) and DAC (CC)
+        if (marker >= 0xC0 and marker <= 0xCF and marker != 0xC4 and marker != 0xC8 and marker != 0xCC) {
+            byte();
+            const auto height{ static_cast<int>(be16()) };
+            const auto width{ static_cast<int>(be16()) };
+            return file ? cv::Size{ width, height } : cv::Size{};
+        }
+        file.seekg(static_cast<std::streamoff>(length) - 2, std::ios::cur);
+    }
+    return {};
+}
+
+// FNV-1a over the file bytes, so a renamed or touched file keeps its entries and an edited one gets new ones
+inline uint64_t contentHash(const std::filesystem::path& path) {
+    const playground::MappedFile file{ path };
+    uint64_t hash{ 0xcbf29ce484222325ull };
+    for (size_t i{ 0 }; i < file.size(); ++i) {
+        hash = (hash ^ file.data()[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// File name order with runs of digits compared by value, so "scene2" comes before "scene10"
+inline bool naturalLess(const std::filesystem::path& a, const std::filesystem::path& b) {
+    const std::string x{ a.filename().string() }, y{ b.filename().string() };
+    size_t i{ 0 }, j{ 0 };
+    while (i < x.size() and j < y.size()) {
+        if (std::isdigit(static_cast<unsigned char>(x[i])) and std::isdigit(static_cast<unsigned char>(y[j]))) {
+            const size_t i_end{ x.find_first_not_of("0123456789", i) }, j_end{ y.find_first_not_of("0123456789", j) };
+            std::string_view u{ std::string_view{ x }.substr(i, i_end - i) }, v{ std::string_view{ y }.substr(j, j_end - j) };
+            u.remove_prefix(std::min(u.find_first_not_of('0'), u.size()));
+            v.remove_prefix(std::min(v.find_first_not_of('0'), v.size()));
+            if (u.size() != v.size()) {
+                return u.size() < v.size();
+            }
+            if (u != v) {
+                return u < v;
+            }
+            i = std::min(i_end, x.size());
+            j = std::min(j_end, y.size());
+            continue;
+        }
+        if (x[i] != y[j]) {
+            return x[i] < y[j];
+        }
+        ++i;
+        ++j;
+    }
+    return x.size() - i < y.size() - j or (x.size() - i == y.size() - j and a < b);
+}
+
+// Image files of a directory in natural name order, walked once
+inline std::vector<std::filesystem::path> listImages(const std::filesystem::path& dir) {
+    static const std::unordered_set<std::string> valid_extensions{ ".jpg", ".jpeg", ".png" };
+    if (!std::filesystem::exists(dir) or !std::filesystem::is_directory(dir)) {
+        throw std::runtime_error(std::format("Invalid directory path: {}", dir.string()));
+    }
+    std::vector<std::filesystem::path> paths;
+    for (const auto& e : std::filesystem::directory_iterator(dir)) {
+        if (e.is_regular_file() and valid_extensions.contains(e.path().extension().string())) {
+            paths.push_back(e.path());
+        }
+    }
+    std::ranges::sort(paths, naturalLess);
+    return paths;
+}
+
+// TIFF structure of a JPEG's EXIF segment (APP1), offsets inside are relative to its header.
+// Empty for other files or without EXIF.
+class ExifData {
+public:
+    explicit ExifData(const std::filesystem::path& path) {
+        std::ifstream file{ path, std::ios::binary };
+        auto byte = [&] { return static_cast<unsigned>(file.get()); };
+        auto be16 = [&] { const unsigned hi{ byte() }; return hi << 8 | byte(); };
+        if (be16() != 0xFFD8) {
+            return;
+        }
+        while (file and data_.empty()) {
+            if (byte() != 0xFF) {
+                return;
+            }
+            const unsigned marker{ byte() };
+            // EXIF comes before the image data
+            if (marker == 0xDA or marker == 0xD9) {
+                return;
+            }
+            const unsigned length{ be16() };
+            if (length < 2) {
+                return;
+            }
+            std::vector<unsigned char> segment(length - 2);
+            file.read(reinterpret_cast<char*>(segment.data()), static_cast<std::streamsize>(segment.size()));
+            if (marker == 0xE1 and segment.size() > 14 and std::memcmp(segment.data(), "Exif\0\0", 6) == 0) {
+                data_.assign(segment.begin() + 6, segment.end());
+            }
+        }
+        if (data_.size() < 8) {
+            data_.clear();
+        }
+        little_ = !data_.empty() and data_[0] == 'I';
+    }
+
+    bool empty() const { return data_.empty(); }
+
+    unsigned u16(size_t at) const {
+        return at + 2 > data_.size() ? 0 : little_ ? data_[at] | data_[at + 1] << 8 : data_[at] << 8 | data_[at + 1];
+    }
+
+    size_t u32(size_t at) const {
+        return little_ ? u16(at) | static_cast<size_t>(u16(at + 2)) << 16 : static_cast<size_t>(u16(at)) << 16 | u16(at + 2);
+    }
+
+    size_t ifd0() const { return empty() ? 0 : u32(4); }
+
+    // Offset of the 12 byte entry of `tag` in the IFD at `ifd`, 0 if it isn't there
+    size_t entry(size_t ifd, unsigned tag) const {
+        if (ifd == 0) {
+            return 0;
+        }
+        const unsigned count{ u16(ifd) };
+        for (unsigned e{ 0 }; e < count; ++e) {
+            const size_t at{ ifd + 2 + 12 * e };
+            if (at + 12 > data_.size()) {
+                break;
+            }
+            if (u16(at) == tag) {
+                return at;
+            }
+        }
+        return 0;
+    }
+
+    // Value offset of an entry stored out of line (LONG offsets, ASCII longer than 4 bytes), 0 if missing
+    size_t offset(size_t ifd, unsigned tag) const {
+        const size_t at{ entry(ifd, tag) };
+        return at == 0 ? 0 : u32(at + 8);
+    }
+
+    // `length` bytes of text at `at`, empty if out of range
+    std::string text(size_t at, size_t length) const {
+        return at == 0 or at + length > data_.size() ? std::string{} : std::string(data_.begin() + at, data_.begin() + at + length);
+    }
+
+private:
+    std::vector<unsigned char> data_;
+    bool little_{};
+};
+
+// EXIF DateTimeOriginal (or DateTime) of a JPEG, "YYYY:MM:DD HH:MM:SS". Empty for other files or without EXIF.
+inline std::string exifCaptureTime(const std::filesystem::path& path) {
+    const ExifData exif{ path };
+    if (exif.empty()) {
+        return {};
+    }
+    const size_t ifd0{ exif.ifd0() };
+    if (const size_t exif_ifd{ exif.offset(ifd0, 0x8769) }; exif_ifd != 0) {
+        if (auto original{ exif.text(exif.offset(exif_ifd, 0x9003), 19) }; !original.empty()) {
+            return original;
+        }
+    }
+    return exif.text(exif.offset(ifd0, 0x0132), 19);
+}
+
+// EXIF Orientation of a JPEG (1..8), 1 for other files or without the tag. 5..8 are rotated by 90 degrees.
+inline int exifOrientation(const std::filesystem::path& path) {
+    const ExifData exif{ path };
+    // A SHORT value sits inline in the first two bytes of the value field
+    const size_t at{ exif.entry(exif.ifd0(), 0x0112) };
+    const int orientation{ at == 0 ? 1 : static_cast<int>(exif.u16(at + 8)) };
+    return orientation >= 1 and orientation <= 8 ? orientation : 1;
+}
+
+// Sorts a sequence by capture time: EXIF time where there is one, the file modification time otherwise,
+// in the same "YYYY:MM:DD HH:MM:SS" form. Stable, so images taken in the same second keep their order.
+inline void sortByCaptureTime(std::vector<std::filesystem::path>& paths) {
+    std::vector<std::pair<std::string, std::filesystem::path>> keyed;
+    keyed.reserve(paths.size());
+    for (auto& path : paths) {
+        std::string time{ exifCaptureTime(path) };
+        if (time.empty()) {
+            const auto modified{ std::chrono::clock_cast<std::chrono::system_clock>(std::filesystem::last_write_time(path)) };
+            time = std::format("{:%Y:%m:%d %H:%M:%S}", std::chrono::floor<std::chrono::seconds>(modified));
+        }
+        keyed.emplace_back(std::move(time), std::move(path));
+    }
+    std::ranges::stable_sort(keyed, {}, &std::pair<std::string, std::filesystem::path>::first);
+    for (size_t i{ 0 }; i < paths.size(); ++i) {
+        paths[i] = std::move(keyed[i].second);
+    }
+}
+
+// One input of the panorama: a registration copy of about `registration_mp` megapixels stays in memory,
+// the full resolution is decoded again only when the image is composited.
+// Sizes are of the decoded image, i.e. after the EXIF orientation imread applies.
+struct SourceImage {
+    std::filesystem::path path;
+    uint64_t hash{};
+    cv::Size full_size;
+    cv::Mat work;
+    // work size / full size
+    double work_scale{ 1.0 };
+
+    cv::Mat loadFull() const {
+        cv::Mat img{ cv::imread(path.string()) };
+        if (img.empty()) {
+            throw std::runtime_error(std::format("Can't load an image from: {}", path.string()));
+        }
+        return img;
+    }
+};
+
+// Decodes straight to the registration resolution. Like cv::Stitcher, one work scale is used for all images,
+// taken from the first one so that `registration_mp` holds for it, or `work_scale` when images join an
+// already loaded set. Every file is decoded with the largest
+// IMREAD_REDUCED_* factor that still covers its work size, which JPEG does with DCT scaling instead of decoding
+// the full image, and INTER_AREA takes the rest. Files are decoded in parallel, failed ones are reported and skipped.
+inline std::vector<SourceImage> loadForRegistration(const std::vector<std::filesystem::path>& paths,
+    double registration_mp = 0.6, double work_scale = -1.0) {
+    static constexpr std::array<std::pair<int, int>, 4> reductions{ {
+        { 8, cv::IMREAD_REDUCED_COLOR_8 }, { 4, cv::IMREAD_REDUCED_COLOR_4 }, { 2, cv::IMREAD_REDUCED_COLOR_2 },
+        { 1, cv::IMREAD_COLOR } } };
+    const cv::Range all{ 0, static_cast<int>(paths.size()) };
+
+    // Sizes from the headers, files without a readable header are decoded here and kept
+    std::vector<SourceImage> images(paths.size());
+    std::vector<cv::Mat> decoded(paths.size());
+    cv::parallel_for_(all, [&](const cv::Range& range) {
+        for (int i{ range.start }; i < range.end; ++i) {
+            images[i].path = paths[i];
+            try {
+                images[i].hash = contentHash(paths[i]);
+            }
+            catch (const std::runtime_error&) {
+                // Unreadable, left without a size and reported below
+                continue;
+            }
+            images[i].full_size = imageSize(paths[i]);
+            // imread applies the EXIF orientation, the header has the stored (unrotated) size
+            if (!images[i].full_size.empty() and exifOrientation(paths[i]) >= 5) {
+                std::swap(images[i].full_size.width, images[i].full_size.height);
+            }
+            if (images[i].full_size.empty()) {
+                decoded[i] = cv::imread(paths[i].string());
+                images[i].full_size = decoded[i].size();
+            }
+        }
+    });
+
+    const auto first{ std::ranges::find_if(images, [](const auto& image) { return !image.full_size.empty(); }) };
+    if (first == images.end()) {
+        return {};
+    }
+    const double scale{ work_scale > 0.0 ? work_scale : std::min(1.0, std::sqrt(registration_mp * 1e6 / first->full_size.area())) };
+
+    cv::parallel_for_(all, [&](const cv::Range& range) {
+        for (int i{ range.start }; i < range.end; ++i) {
+            auto& image{ images[i] };
+            if (image.full_size.empty()) {
+                continue;
+            }
+            const cv::Size work_size{ cvRound(image.full_size.width * scale), cvRound(image.full_size.height * scale) };
+            if (decoded[i].empty()) {
+                for (const auto& [factor, flag] : reductions) {
+                    if (image.full_size.width / factor >= work_size.width and image.full_size.height / factor >= work_size.height) {
+                        decoded[i] = cv::imread(paths[i].string(), flag);
+                        break;
+                    }
+                }
+            }
+            if (decoded[i].empty()) {
+                continue;
+            }
+            if (decoded[i].size() != work_size) {
+                cv::resize(decoded[i], image.work, work_size, 0.0, 0.0, cv::INTER_AREA);
+            }
+            else {
+                image.work = decoded[i];
+            }
+            image.work_scale = scale;
+            decoded[i].release();
+        }
+    });
+
+    std::vector<SourceImage> loaded;
+    loaded.reserve(images.size());
+    for (auto& image : images) {
+        if (image.work.empty()) {
+            std::cerr << std::format("Failed to load an image from: {}\n", image.path.string());
+            continue;
+        }
+        loaded.push_back(std::move(image));
+    }
+    return loaded;
+}
@@ -2,8 +2,11 @@
 // Created by Michał Maj on 21/06/2025.
 //
 
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <iostream>
+#include <memory>
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/opencv.hpp>
@@ -11,97 +14,201 @@
 #include <opencv2/stitching.hpp>
 #include <print>
 #include <ranges>
-#include <unordered_set>
-
-class Stitcher {
-public:
-    Stitcher(const std::filesystem::path& path, const cv::Stitcher::Mode& mode = cv::Stitcher::Mode::PANORAMA)
-        : mode_(mode) {
-        auto len{ std::distance(std::filesystem::directory_iterator(path), std::filesystem::directory_iterator{}) };
-        images_.reserve(len);
-
-        if (!std::filesystem::exists(path) or !std::filesystem::is_directory(path)) {
-            throw std::runtime_error(std::format("Invalid directory path: {}", path.string()));
-        }
-        for (const auto& e : std::filesystem::directory_iterator(path)) {
-            if (!std::filesystem::is_regular_file(e)) {
-                continue;
-            }
-            std::string ext{ e.path().extension().string() };
-            if (!valid_extensions_.contains(ext)) {
-                continue;
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "image_source.hpp"
+#include "panorama_pipeline.hpp"
+#include "rig_compositor.hpp"
+#include "stage_timer.hpp"
+#include "stitcher.hpp"
+#include "tiled_compositor.hpp"
+
+// Full stitch of every image in `path` with each of `configs`, `runs` times, without a registration cache.
+// Prints the per-stage breakdown of every configuration and the spread of the end-to-end time.
+void benchmark(const std::filesystem::path& path, const std::vector<PanoramaSettings>& configs, int runs) {
+    for (const auto& settings : configs) {
+        std::println("\n{} | seam_mp={} compose_mp={} match_window={} loop_closure={}", settings.signature(),
+            settings.seam_mp, settings.compose_mp, settings.match_window, settings.loop_closure);
+        const auto files{ Stitcher::sequence(path, settings) };
+        PanoramaPipeline pipeline{ settings };
+        playground::StageTimer loading;
+        std::vector<double> totals;
+        cv::Size pano_size;
+        for (int run{ 0 }; run < runs; ++run) {
+            const auto start{ std::chrono::steady_clock::now() };
+            std::vector<SourceImage> images;
+            {
+                auto t{ loading.measure("loading") };
+                images = loadForRegistration(files, settings.registration_mp);
             }
-            cv::Mat img{ cv::imread(e.path().string()) };
-            if (img.empty()) {
-                std::cerr << std::format("Failed to load an image from: {}\n", e.path().string());
-                continue;
+            if (!pipeline.estimate(images)) {
+                std::println("Registration failed");
+                break;
             }
-            images_.emplace_back(std::move(img));
+            const auto pano{ pipeline.compose(images) };
+            totals.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            pano_size = pano ? pano->size() : cv::Size{};
         }
-
-        if (images_.size() < 2) {
-            throw std::runtime_error("Stitcher requires at least 2 images!\n");
+        if (totals.empty()) {
+            continue;
         }
+        loading.print();
+        pipeline.getProfile().print();
+        std::println("Panorama {}x{}, {} of {} images | end to end p50 {:.2f} ms, p95 {:.2f} ms",
+            pano_size.width, pano_size.height, pipeline.getIndices().size(), files.size(),
+            playground::StageTimer::percentile(totals, 0.5), playground::StageTimer::percentile(totals, 0.95));
     }
-
-    void setMode(const cv::Stitcher::Mode& mode) {
-        mode_ = mode;
+}
+
+// Calibrates a rig on the images of `calibration_dir` (one per camera, in sequence order), then composes
+// synchronized frames of `videos` (one per camera, same order) until one ends or ESC. Without videos the
+// calibration images are replayed as a still rig for `frames` frames to measure the throughput.
+void videoPanorama(const std::filesystem::path& calibration_dir, const std::vector<std::filesystem::path>& videos, int frames = 100) {
+    const PanoramaSettings settings;
+    const auto calibration{ loadForRegistration(Stitcher::sequence(calibration_dir, settings), settings.registration_mp) };
+    if (!videos.empty() and videos.size() != calibration.size()) {
+        std::cerr << std::format("{} videos for {} calibration images\n", videos.size(), calibration.size());
+        return;
     }
 
-    void setNewImages(const std::filesystem::path& path) {
-        if (!std::filesystem::exists(path) or !std::filesystem::is_directory(path)) {
-            std::cout << std::format("Invalid path: {}\n", path.string());
-            return;
+    PanoramaPipeline pipeline{ settings };
+    RigCompositor rig;
+    const auto start{ std::chrono::steady_clock::now() };
+    if (!rig.calibrate(pipeline, calibration)) {
+        std::cerr << "Can't calibrate the rig!\n";
+        return;
+    }
+    std::println("Calibrated {} of {} cameras in {:.2f} ms, panorama {}x{}, cached maps and weights {:.1f} MB",
+        rig.cameraCount(), calibration.size(),
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+        rig.size().width, rig.size().height, rig.cachedBytes() / 1048576.0);
+
+    std::vector<cv::VideoCapture> captures;
+    std::vector<cv::Mat> frame_set;
+    for (const auto& video : videos) {
+        captures.emplace_back(video.string());
+    }
+    if (captures.empty()) {
+        for (const auto& image : calibration) {
+            frame_set.push_back(image.loadFull());
         }
+    }
+    else {
+        frame_set.resize(captures.size());
+    }
 
-        std::vector<cv::Mat> temp;
-        for (const auto& e : std::filesystem::directory_iterator(path)) {
-            if (!std::filesystem::is_regular_file(e)) {
-                continue;
-            }
-            std::string ext{ e.path().extension().string() };
-
-            if (!valid_extensions_.contains(ext)) {
-                continue;
-            }
-
-            cv::Mat img{ cv::imread(e.path().string()) };
-            if (img.empty()) {
-                std::cerr << std::format("Can't load an image from: {}", e.path().string());
-                continue;
-            }
-            temp.emplace_back(std::move(img));
+    cv::namedWindow("Rig panorama", cv::WINDOW_NORMAL);
+    int composed{ 0 };
+    const auto first{ std::chrono::steady_clock::now() };
+    while (!captures.empty() or composed < frames) {
+        bool complete{ true };
+        for (size_t i{ 0 }; i < captures.size(); ++i) {
+            complete = captures[i].read(frame_set[i]) and complete;
+        }
+        if (!complete) {
+            break;
         }
-        if (temp.size() < 2) {
-            std::cerr << "Not enough images, Stitcher requires at least 2 images!\n";
-            return;
+        cv::imshow("Rig panorama", rig.compose(frame_set));
+        ++composed;
+        if (cv::waitKey(1) == 27) {
+            break;
         }
-        std::swap(temp, images_);
     }
+    const double seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - first).count() };
+    rig.getTimer().print();
+    std::println("{} frame sets, {:.1f} fps including capture and display", composed, composed / seconds);
+    cv::destroyAllWindows();
+}
 
-    std::optional<cv::Mat> createStitcher() {
-        cv::Mat output;
-        stitcher_ = cv::Stitcher::create(mode_);
-        auto status{ stitcher_->stitch(images_, output) };
+int main(int argc, char** argv) {
+    std::filesystem::path path{ "../data/images/scene" };
+    const std::string_view mode{ argc > 1 ? argv[1] : "" };
+
+    // "incremental": stitches all but the last image, then adds it, the second registration reuses the cache
+    if (mode == "incremental") {
+        auto files{ listImages(path) };
+        const auto last{ files.back() };
+        files.pop_back();
+        const std::filesystem::path cache_path{ "panorama_incremental_cache.yml.gz" };
+        std::filesystem::remove(cache_path);
+
+        Stitcher s{ files, PanoramaSettings{}, cache_path };
+        s.createStitcher();
+        s.addImage(last);
+        auto stiched{ s.createStitcher() };
+        if (stiched.has_value()) {
+            cv::namedWindow("Stitched", cv::WINDOW_NORMAL);
+            cv::imshow("Stitched", stiched.value());
+            cv::waitKey(0);
+            cv::destroyAllWindows();
+        }
+        return 0;
+    }
 
-        if (status != cv::Stitcher::OK) {
-            std::cerr << "Can't stitch images!\n";
-            return std::nullopt;
+    // "tiled [dir] [output] [budget MB]": out-of-core compositing to a Deep Zoom tile pyramid
+    if (mode == "tiled") {
+        if (argc > 2) {
+            path = argv[2];
+        }
+        const std::filesystem::path output{ argc > 3 ? argv[3] : "panorama" };
+        const size_t budget{ (argc > 4 ? std::stoull(argv[4]) : 512) << 20 };
+        Stitcher s{ path };
+        if (const auto size{ s.createTiledPanorama(output, budget) }) {
+            std::println("Wrote {}.dzi ({}x{})", output.string(), size->width, size->height);
         }
+        return 0;
+    }
 
-        return output;
+    // "video [calibration dir] [camera videos...]": calibrate once, then remap + blend every frame set
+    if (mode == "video") {
+        if (argc > 2) {
+            path = argv[2];
+        }
+        std::vector<std::filesystem::path> videos(argv + std::min(argc, 3), argv + argc);
+        videoPanorama(path, videos);
+        return 0;
     }
 
-private:
-    std::vector<cv::Mat> images_;
-    cv::Stitcher::Mode mode_;
-    cv::Ptr<cv::Stitcher> stitcher_;
-    static inline std::unordered_set<std::string> valid_extensions_{ ".jpg", ".jpeg", ".png" };
-};
+    // "benchmark [dir] [runs]": cv::Stitcher defaults, then lower resolutions, the other feature finders and
+    // sequence matching
+    if (mode == "benchmark") {
+        if (argc > 2) {
+            path = argv[2];
+        }
+        const int runs{ argc > 3 ? std::stoi(argv[3]) : 3 };
+        const PanoramaSettings defaults;
+        auto with = [&](auto&& change) {
+            PanoramaSettings settings{ defaults };
+            change(settings);
+            return settings;
+        };
+        benchmark(path, {
+            defaults,
+            with([](auto& s) { s.registration_mp = 0.3; }),
+            with([](auto& s) { s.seam_mp = 0.05; }),
+            with([](auto& s) { s.compose_mp = 1.0; }),
+            with([](auto& s) { s.finder = "akaze"; }),
+            with([](auto& s) { s.finder = "sift"; }),
+            with([](auto& s) { s.match_window = 2; }),
+            with([](auto& s) { s.match_window = 2; s.loop_closure = true; }),
+        }, runs);
+        return 0;
+    }
 
-int main() {
-    std::filesystem::path path{ "../data/images/scene" };
+    auto start{ std::chrono::steady_clock::now() };
     Stitcher s{ path };
+    size_t work_bytes{ 0 }, full_bytes{ 0 };
+    for (const auto& image : s.getImages()) {
+        work_bytes += image.work.total() * image.work.elemSize();
+        full_bytes += static_cast<size_t>(image.full_size.area()) * 3;
+    }
+    std::println("Loaded {} images in {:.2f} ms, registration copies {:.1f} MB (full resolution {:.1f} MB)",
+        s.getImages().size(),
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+        work_bytes / 1048576.0,
+        full_bytes / 1048576.0);
 
     std::string win_name{ "Stitched" };
     cv::namedWindow(win_name, cv::WINDOW_NORMAL);
@@ -114,4 +221,4 @@ int main() {
     cv::destroyAllWindows();
 
     return 0;
-}
\ No newline at end of file
+}
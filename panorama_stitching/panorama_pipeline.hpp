@@ -0,0 +1,594 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <opencv2/stitching.hpp>
+#include <opencv2/stitching/detail/blenders.hpp>
+#include <opencv2/stitching/detail/exposure_compensate.hpp>
+#include <opencv2/stitching/detail/matchers.hpp>
+#include <opencv2/stitching/detail/motion_estimators.hpp>
+#include <opencv2/stitching/detail/seam_finders.hpp>
+#include <opencv2/stitching/detail/warpers.hpp>
+#include <opencv2/stitching/warpers.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <optional>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "image_source.hpp"
+#include "process_memory.hpp"
+#include "registration_cache.hpp"
+#include "stage_timer.hpp"
+
+// Working resolutions in megapixels (compositing <= 0 keeps the input resolution) and the feature finder,
+// defaults are those of cv::Stitcher
+struct PanoramaSettings {
+    cv::Stitcher::Mode mode{ cv::Stitcher::PANORAMA };
+    double registration_mp{ 0.6 };
+    double seam_mp{ 0.1 };
+    double compose_mp{ -1.0 };
+    // "orb", "akaze" or "sift"
+    std::string finder{ "orb" };
+    // Inputs form a sequence, in natural file name order or by capture time (EXIF, else modification time).
+    // Only images at most `match_window` apart are matched (0 matches every pair), O(n * k) instead of O(n^2),
+    // `loop_closure` also matches the first and last `match_window` images with each other for 360° sets.
+    bool capture_time_order{ false };
+    int match_window{ 0 };
+    bool loop_closure{ false };
+
+    cv::Ptr<cv::Feature2D> createFinder() const {
+        if (finder == "orb") {
+            return cv::ORB::create();
+        }
+        if (finder == "akaze") {
+            return cv::AKAZE::create();
+        }
+        if (finder == "sift") {
+            return cv::SIFT::create();
+        }
+        throw std::invalid_argument(std::format("Unknown feature finder: {}", finder));
+    }
+
+    // Everything registration results depend on, names the entries of a RegistrationCache
+    std::string signature() const {
+        return std::format("mode={} registration_mp={} finder={}", static_cast<int>(mode), registration_mp, finder);
+    }
+};
+
+// Wall-clock time of every stage (StageTimer), the resident memory when it ends and the peak while it ran.
+// Stages must not nest, each one restarts the peak.
+class StageProfile {
+public:
+    class Scope {
+    public:
+        Scope(StageProfile& profile, std::string_view stage) : profile_(profile), stage_(stage),
+            timer_((playground::resetPeakMemory(), profile.timer_.measure(stage))) {}
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope() {
+            profile_.record(stage_, playground::memoryUsage());
+        }
+
+    private:
+        StageProfile& profile_;
+        std::string_view stage_;
+        playground::StageTimer::Scope timer_;
+    };
+
+    [[nodiscard]] Scope measure(std::string_view stage) {
+        return Scope{ *this, stage };
+    }
+
+    double totalMs() const {
+        double total{ 0.0 };
+        for (const auto& stage : stages_) {
+            total += stageMs(stage.name);
+        }
+        return total;
+    }
+
+    void print() const {
+        const double total{ totalMs() };
+        std::println("{:<24} {:>6} {:>10} {:>7} {:>10} {:>10}", "stage", "calls", "total ms", "share", "RSS MB", "peak MB");
+        for (const auto& stage : stages_) {
+            const double ms{ stageMs(stage.name) };
+            std::println("{:<24} {:>6} {:>10.2f} {:>6.1f}% {:>10.1f} {:>10.1f}",
+                stage.name, timer_.samples(stage.name).size(), ms, total > 0.0 ? 100.0 * ms / total : 0.0,
+                stage.rss / 1048576.0, stage.peak / 1048576.0);
+        }
+        std::println("{:<24} {:>6} {:>10.2f}", "total", "", total);
+    }
+
+private:
+    struct Stage {
+        std::string name;
+        // RSS after the last call, highest peak over all calls
+        size_t rss{};
+        size_t peak{};
+    };
+    playground::StageTimer timer_;
+    std::vector<Stage> stages_;
+
+    double stageMs(std::string_view stage) const {
+        double sum{ 0.0 };
+        for (double ms : timer_.samples(stage)) {
+            sum += ms;
+        }
+        return sum;
+    }
+
+    void record(std::string_view name, const playground::MemoryUsage& usage) {
+        auto it{ std::ranges::find(stages_, name, &Stage::name) };
+        if (it == stages_.end()) {
+            stages_.push_back({ std::string{ name } });
+            it = std::prev(stages_.end());
+        }
+        it->rss = usage.current;
+        it->peak = std::max(it->peak, usage.peak);
+    }
+};
+
+// The steps of cv::Stitcher::stitch with the same defaults per mode, split so that registration runs on the
+// in-memory work copies and compositing decodes the full-resolution images one at a time.
+//
+// PANORAMA: ORB, BestOf2NearestMatcher, HomographyBasedEstimator, BundleAdjusterRay, horizontal wave
+// correction, spherical warper, block gain compensation. SCANS: affine matcher, estimator and adjuster,
+// affine warper, no exposure compensation. Both use graph-cut seams and multi-band blending.
+class PanoramaPipeline {
+public:
+    explicit PanoramaPipeline(const PanoramaSettings& settings = {}) : mode_(settings.mode),
+        seam_mp_(settings.seam_mp),
+        compose_mp_(settings.compose_mp),
+        match_window_(settings.match_window),
+        loop_closure_(settings.loop_closure) {
+        finder_ = settings.createFinder();
+        if (mode_ == cv::Stitcher::PANORAMA) {
+            matcher_ = cv::makePtr<cv::detail::BestOf2NearestMatcher>(false, match_conf_);
+            estimator_ = cv::makePtr<cv::detail::HomographyBasedEstimator>();
+            adjuster_ = cv::makePtr<cv::detail::BundleAdjusterRay>();
+            warper_creator_ = cv::makePtr<cv::SphericalWarper>();
+            compensator_ = cv::detail::ExposureCompensator::createDefault(cv::detail::ExposureCompensator::GAIN_BLOCKS);
+        }
+        else {
+            matcher_ = cv::makePtr<cv::detail::AffineBestOf2NearestMatcher>(false, false, match_conf_);
+            estimator_ = cv::makePtr<cv::detail::AffineBasedEstimator>();
+            adjuster_ = cv::makePtr<cv::detail::BundleAdjusterAffinePartial>();
+            warper_creator_ = cv::makePtr<cv::AffineWarper>();
+            compensator_ = cv::makePtr<cv::detail::NoExposureCompensator>();
+        }
+        seam_finder_ = cv::makePtr<cv::detail::GraphCutSeamFinder>(cv::detail::GraphCutSeamFinderBase::COST_COLOR);
+    }
+
+    // Features, matches and cameras of images seen before are taken from `cache` when set
+    void setCache(RegistrationCache* cache) {
+        cache_ = cache;
+    }
+
+    // Features, pairwise matches, cameras and bundle adjustment on the work copies. False when fewer than
+    // two images end up in the largest connected component or an estimator fails.
+    bool estimate(const std::vector<SourceImage>& images) {
+        if (images.size() < 2) {
+            return false;
+        }
+        work_scale_ = images.front().work_scale;
+        if (cache_) {
+            cache_->stats() = {};
+        }
+
+        std::vector<cv::detail::ImageFeatures> features;
+        {
+            auto t{ profile_.measure("features") };
+            features = findFeatures(images);
+        }
+        std::vector<cv::detail::MatchesInfo> pairwise;
+        {
+            auto t{ profile_.measure("matching") };
+            pairwise = matchPairs(images, features);
+            // Images that don't connect to the largest group are dropped, as cv::Stitcher does
+            indices_ = cv::detail::leaveBiggestComponent(features, pairwise, conf_thresh_);
+        }
+        if (indices_.size() < 2) {
+            return false;
+        }
+
+        std::vector<uint64_t> hashes;
+        for (int index : indices_) {
+            hashes.push_back(images[index].hash);
+        }
+        if (!estimateCameras(hashes, features, pairwise)) {
+            return false;
+        }
+        if (cache_) {
+            // Stored before wave correction, which is recomputed for every solution
+            cache_->putCameras(hashes, cameras_);
+            cache_->save();
+        }
+
+        std::vector<double> focals;
+        for (const auto& camera : cameras_) {
+            focals.push_back(camera.focal);
+        }
+        std::ranges::sort(focals);
+        warped_image_scale_ = focals.size() % 2 == 1
+            ? focals[focals.size() / 2]
+            : (focals[focals.size() / 2 - 1] + focals[focals.size() / 2]) * 0.5;
+
+        if (mode_ == cv::Stitcher::PANORAMA) {
+            auto t{ profile_.measure("wave correction") };
+            std::vector<cv::Mat> rotations;
+            for (const auto& camera : cameras_) {
+                rotations.push_back(camera.R.clone());
+            }
+            cv::detail::waveCorrect(rotations, cv::detail::WAVE_CORRECT_HORIZ);
+            for (size_t i{ 0 }; i < cameras_.size(); ++i) {
+                cameras_[i].R = rotations[i];
+            }
+        }
+        return true;
+    }
+
+    // Where and how every registered image lands in the panorama at the compositing resolution
+    struct CompositionLayout {
+        double compose_scale{ 1.0 };
+        cv::Ptr<cv::detail::RotationWarper> warper;
+        // Per camera: intrinsics at the compositing scale, size of the (scaled) input, top-left corner and
+        // size of the warped image, seam mask at the seam resolution
+        std::vector<cv::Mat> ks;
+        std::vector<cv::Size> input_sizes;
+        std::vector<cv::Point> corners;
+        std::vector<cv::Size> sizes;
+        std::vector<cv::UMat> seam_masks;
+    };
+
+    // Seams and exposure gains on small copies, then the warped geometry at the compositing resolution.
+    // Leaves the exposure compensator fed for these images.
+    std::optional<CompositionLayout> prepareComposition(const std::vector<SourceImage>& images) {
+        if (cameras_.empty()) {
+            return std::nullopt;
+        }
+        const size_t n{ indices_.size() };
+        const cv::Size full_size{ images[indices_.front()].full_size };
+        const double seam_scale{ std::min(1.0, std::sqrt(seam_mp_ * 1e6 / full_size.area())) };
+        const double seam_work_aspect{ seam_scale / work_scale_ };
+
+        CompositionLayout layout;
+        std::vector<cv::Point> corners(n);
+        std::vector<cv::UMat> images_warped(n);
+        layout.seam_masks.resize(n);
+        {
+            auto t{ profile_.measure("seam warping") };
+            auto warper{ warper_creator_->create(static_cast<float>(warped_image_scale_ * seam_work_aspect)) };
+            for (size_t i{ 0 }; i < n; ++i) {
+                cv::Mat seam_img;
+                cv::resize(images[indices_[i]].work, seam_img, {}, seam_work_aspect, seam_work_aspect, cv::INTER_LINEAR_EXACT);
+                const cv::Mat k{ scaledK(cameras_[i], seam_work_aspect) };
+                corners[i] = warper->warp(seam_img, k, cameras_[i].R, cv::INTER_LINEAR, cv::BORDER_REFLECT, images_warped[i]);
+                const cv::Mat mask(seam_img.size(), CV_8U, cv::Scalar::all(255));
+                warper->warp(mask, k, cameras_[i].R, cv::INTER_NEAREST, cv::BORDER_CONSTANT, layout.seam_masks[i]);
+            }
+        }
+        {
+            auto t{ profile_.measure("exposure compensation") };
+            compensator_->feed(corners, images_warped, layout.seam_masks);
+        }
+        {
+            auto t{ profile_.measure("seam finding") };
+            std::vector<cv::UMat> images_warped_f(n);
+            for (size_t i{ 0 }; i < n; ++i) {
+                images_warped[i].convertTo(images_warped_f[i], CV_32F);
+            }
+            images_warped.clear();
+            seam_finder_->find(images_warped_f, corners, layout.seam_masks);
+        }
+
+        layout.compose_scale = compose_mp_ > 0.0 ? std::min(1.0, std::sqrt(compose_mp_ * 1e6 / full_size.area())) : 1.0;
+        const double compose_work_aspect{ layout.compose_scale / work_scale_ };
+        layout.warper = warper_creator_->create(static_cast<float>(warped_image_scale_ * compose_work_aspect));
+        for (size_t i{ 0 }; i < n; ++i) {
+            layout.ks.push_back(scaledK(cameras_[i], compose_work_aspect));
+            const cv::Size full{ images[indices_[i]].full_size };
+            layout.input_sizes.push_back(std::abs(layout.compose_scale - 1.0) > 1e-1
+                ? cv::Size(cvRound(full.width * layout.compose_scale), cvRound(full.height * layout.compose_scale))
+                : full);
+            const cv::Rect roi{ layout.warper->warpRoi(layout.input_sizes[i], layout.ks[i], cameras_[i].R) };
+            layout.corners.push_back(roi.tl());
+            layout.sizes.push_back(roi.size());
+        }
+        return layout;
+    }
+
+    // Every image is decoded at full resolution, warped, compensated and fed to the blender before the next
+    // one is loaded
+    std::optional<cv::Mat> compose(const std::vector<SourceImage>& images) {
+        auto layout{ prepareComposition(images) };
+        if (!layout) {
+            return std::nullopt;
+        }
+        const size_t n{ indices_.size() };
+        auto blender{ cv::makePtr<cv::detail::MultiBandBlender>(false) };
+        {
+            auto t{ profile_.measure("blending") };
+            blender->prepare(layout->corners, layout->sizes);
+        }
+        for (size_t i{ 0 }; i < n; ++i) {
+            cv::Mat img;
+            {
+                auto t{ profile_.measure("decode") };
+                img = images[indices_[i]].loadFull();
+                if (img.size() != layout->input_sizes[i]) {
+                    cv::resize(img, img, layout->input_sizes[i], 0.0, 0.0, cv::INTER_LINEAR_EXACT);
+                }
+            }
+
+            cv::Mat img_warped, mask_warped;
+            {
+                auto t{ profile_.measure("warping") };
+                layout->warper->warp(img, layout->ks[i], cameras_[i].R, cv::INTER_LINEAR, cv::BORDER_REFLECT, img_warped);
+                const cv::Mat mask(img.size(), CV_8U, cv::Scalar::all(255));
+                layout->warper->warp(mask, layout->ks[i], cameras_[i].R, cv::INTER_NEAREST, cv::BORDER_CONSTANT, mask_warped);
+                img.release();
+            }
+            {
+                auto t{ profile_.measure("exposure compensation") };
+                compensator_->apply(static_cast<int>(i), layout->corners[i], img_warped, mask_warped);
+            }
+
+            auto t{ profile_.measure("blending") };
+            cv::Mat img_warped_s, dilated_mask, seam_mask;
+            img_warped.convertTo(img_warped_s, CV_16S);
+            cv::dilate(layout->seam_masks[i], dilated_mask, cv::Mat{});
+            cv::resize(dilated_mask, seam_mask, mask_warped.size(), 0.0, 0.0, cv::INTER_LINEAR_EXACT);
+            mask_warped &= seam_mask;
+            blender->feed(img_warped_s, mask_warped, layout->corners[i]);
+        }
+
+        auto t{ profile_.measure("blending") };
+        cv::Mat result, result_mask, pano;
+        blender->blend(result, result_mask);
+        result.convertTo(pano, CV_8U);
+        return pano;
+    }
+
+    // Gains of the exposure compensator fed by the last prepareComposition, one map per camera (a single gain
+    // or a grid of blocks), empty without compensation
+    std::vector<cv::Mat> exposureGains() const {
+        std::vector<cv::Mat> gains;
+        compensator_->getMatGains(gains);
+        return gains;
+    }
+
+    // Input positions of the images in the panorama, in camera order
+    const auto& getIndices() const { return indices_; }
+    const auto& getCameras() const { return cameras_; }
+    // Stages of estimate and compose, accumulated over every call on this pipeline
+    const auto& getProfile() const { return profile_; }
+
+private:
+    cv::Stitcher::Mode mode_;
+
+    // Configuration variables
+    double seam_mp_{};
+    double compose_mp_{};
+    int match_window_{};
+    bool loop_closure_{};
+    float match_conf_{ 0.3f };
+    float conf_thresh_{ 1.0f };
+
+    cv::Ptr<cv::Feature2D> finder_;
+    cv::Ptr<cv::detail::FeaturesMatcher> matcher_;
+    cv::Ptr<cv::detail::Estimator> estimator_;
+    cv::Ptr<cv::detail::BundleAdjusterBase> adjuster_;
+    cv::Ptr<cv::WarperCreator> warper_creator_;
+    cv::Ptr<cv::detail::ExposureCompensator> compensator_;
+    cv::Ptr<cv::detail::SeamFinder> seam_finder_;
+    RegistrationCache* cache_{ nullptr };
+    StageProfile profile_;
+
+    // Registration result
+    double work_scale_{ 1.0 };
+    double warped_image_scale_{ 1.0 };
+    std::vector<int> indices_;
+    std::vector<cv::detail::CameraParams> cameras_;
+
+    std::vector<cv::detail::ImageFeatures> findFeatures(const std::vector<SourceImage>& images) {
+        std::vector<cv::detail::ImageFeatures> features(images.size());
+        std::vector<int> missing;
+        std::vector<cv::Mat> work;
+        for (size_t i{ 0 }; i < images.size(); ++i) {
+            const auto* cached{ cache_ ? cache_->features(images[i].hash) : nullptr };
+            if (cached and cached->img_size == images[i].work.size()) {
+                features[i] = *cached;
+                ++cache_->stats().features_reused;
+                continue;
+            }
+            missing.push_back(static_cast<int>(i));
+            work.push_back(images[i].work);
+        }
+
+        if (!work.empty()) {
+            std::vector<cv::detail::ImageFeatures> computed;
+            cv::detail::computeImageFeatures(finder_, work, computed);
+            for (size_t j{ 0 }; j < missing.size(); ++j) {
+                features[missing[j]] = std::move(computed[j]);
+                if (cache_) {
+                    cache_->putFeatures(images[missing[j]].hash, features[missing[j]]);
+                    ++cache_->stats().features_computed;
+                }
+            }
+        }
+        for (size_t i{ 0 }; i < features.size(); ++i) {
+            features[i].img_idx = static_cast<int>(i);
+        }
+        return features;
+    }
+
+    // Whether images `i` < `j` of `n` are close enough in the sequence to be matched
+    bool inWindow(int i, int j, int n) const {
+        return match_window_ <= 0 or j - i <= match_window_ or (loop_closure_ and n - (j - i) <= match_window_);
+    }
+
+    // Only pairs in the sequence window without a cached result go through the matcher, selected with its mask
+    std::vector<cv::detail::MatchesInfo> matchPairs(const std::vector<SourceImage>& images,
+        const std::vector<cv::detail::ImageFeatures>& features) {
+        const int n{ static_cast<int>(images.size()) };
+        cv::Mat_<uchar> mask(n, n, static_cast<uchar>(0));
+        std::vector<std::pair<int, int>> cached;
+        for (int i{ 0 }; i < n; ++i) {
+            for (int j{ i + 1 }; j < n; ++j) {
+                if (!inWindow(i, j, n)) {
+                    continue;
+                }
+                if (cache_ and cache_->matches(images[i].hash, images[j].hash)) {
+                    cached.emplace_back(i, j);
+                }
+                else {
+                    mask(i, j) = 1;
+                }
+            }
+        }
+
+        std::vector<cv::detail::MatchesInfo> pairwise(static_cast<size_t>(n) * n);
+        if (cv::countNonZero(mask) > 0) {
+            (*matcher_)(features, pairwise, mask.getUMat(cv::ACCESS_READ));
+            matcher_->collectGarbage();
+        }
+
+        for (const auto& [i, j] : cached) {
+            auto forward{ *cache_->matches(images[i].hash, images[j].hash) };
+            auto backward{ *cache_->matches(images[j].hash, images[i].hash) };
+            forward.src_img_idx = backward.dst_img_idx = i;
+            forward.dst_img_idx = backward.src_img_idx = j;
+            pairwise[i * n + j] = std::move(forward);
+            pairwise[j * n + i] = std::move(backward);
+            ++cache_->stats().pairs_reused;
+        }
+        if (cache_) {
+            for (int i{ 0 }; i < n; ++i) {
+                for (int j{ i + 1 }; j < n; ++j) {
+                    if (mask(i, j)) {
+                        cache_->putMatches(images[i].hash, images[j].hash, pairwise[i * n + j]);
+                        ++cache_->stats().pairs_matched;
+                    }
+                }
+            }
+        }
+        return pairwise;
+    }
+
+    // The previous solution is reused as is when it covers every image. Otherwise, in PANORAMA mode, images
+    // of the previous solution keep their bundle-adjusted cameras and new ones are chained from their best
+    // connected neighbour, so bundle adjustment starts next to the optimum. Without a usable previous
+    // solution the estimator runs on everything.
+    bool estimateCameras(const std::vector<uint64_t>& hashes, const std::vector<cv::detail::ImageFeatures>& features,
+        const std::vector<cv::detail::MatchesInfo>& pairwise) {
+        const size_t n{ hashes.size() };
+        std::vector<const cv::detail::CameraParams*> previous(n, nullptr);
+        size_t known{ 0 };
+        for (size_t i{ 0 }; i < n and cache_; ++i) {
+            previous[i] = cache_->camera(hashes[i]);
+            known += previous[i] != nullptr;
+        }
+
+        cameras_.assign(n, {});
+        if (known == n) {
+            for (size_t i{ 0 }; i < n; ++i) {
+                cameras_[i] = *previous[i];
+            }
+            cache_->stats().cameras_reused = static_cast<int>(n);
+            return true;
+        }
+
+        if (known == 0 or mode_ != cv::Stitcher::PANORAMA or !chainFromPrevious(previous, features, pairwise)) {
+            cameras_.assign(n, {});
+            if (cache_) {
+                cache_->stats().cameras_reused = cache_->stats().cameras_initialized = 0;
+            }
+            auto t{ profile_.measure("camera estimation") };
+            if (!(*estimator_)(features, pairwise, cameras_)) {
+                return false;
+            }
+            for (auto& camera : cameras_) {
+                cv::Mat r;
+                camera.R.convertTo(r, CV_32F);
+                camera.R = r;
+            }
+        }
+        auto t{ profile_.measure("bundle adjustment") };
+        adjuster_->setConfThresh(conf_thresh_);
+        return (*adjuster_)(features, pairwise, cameras_);
+    }
+
+    // Same relation as cv::detail::HomographyBasedEstimator uses along its spanning tree, with the principal
+    // point at the image center: R_to = R_from * K_from^-1 * H(from -> to)^-1 * K_to
+    bool chainFromPrevious(const std::vector<const cv::detail::CameraParams*>& previous,
+        const std::vector<cv::detail::ImageFeatures>& features, const std::vector<cv::detail::MatchesInfo>& pairwise) {
+        const int n{ static_cast<int>(previous.size()) };
+        std::vector<char> done(n, 0);
+        for (int i{ 0 }; i < n; ++i) {
+            if (previous[i]) {
+                cameras_[i] = *previous[i];
+                done[i] = 1;
+                ++cache_->stats().cameras_reused;
+            }
+        }
+
+        auto centered = [](const cv::detail::CameraParams& c) {
+            return cv::Matx33d{ c.focal, 0, 0, 0, c.focal * c.aspect, 0, 0, 0, 1 };
+        };
+        for (bool progress{ true }; progress;) {
+            progress = false;
+            for (int to{ 0 }; to < n; ++to) {
+                if (done[to]) {
+                    continue;
+                }
+                int from{ -1 };
+                for (int i{ 0 }; i < n; ++i) {
+                    const auto& m{ pairwise[i * n + to] };
+                    if (done[i] and !m.H.empty() and m.confidence > conf_thresh_
+                        and (from < 0 or m.confidence > pairwise[from * n + to].confidence)) {
+                        from = i;
+                    }
+                }
+                if (from < 0) {
+                    continue;
+                }
+
+                auto& camera{ cameras_[to] };
+                camera.focal = cameras_[from].focal;
+                camera.aspect = cameras_[from].aspect;
+                cv::Mat r_from;
+                cameras_[from].R.convertTo(r_from, CV_64F);
+                const cv::Matx33d r{ cv::Matx33d(r_from) * centered(cameras_[from]).inv()
+                    * cv::Matx33d(pairwise[from * n + to].H).inv() * centered(camera) };
+                cv::Mat(r).convertTo(camera.R, CV_32F);
+                camera.ppx = 0.5 * features[to].img_size.width;
+                camera.ppy = 0.5 * features[to].img_size.height;
+                done[to] = 1;
+                progress = true;
+                ++cache_->stats().cameras_initialized;
+            }
+        }
+        return std::ranges::all_of(done, [](char d) { return d != 0; });
+    }
+
+    // Intrinsics of `camera` for images scaled by `aspect` relative to the work copies
+    static cv::Mat scaledK(cv::detail::CameraParams camera, double aspect) {
+        camera.focal *= aspect;
+        camera.ppx *= aspect;
+        camera.ppy *= aspect;
+        cv::Mat k;
+        camera.K().convertTo(k, CV_32F);
+        return k;
+    }
+};
@@ -0,0 +1,192 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <opencv2/stitching/detail/camera.hpp>
+#include <opencv2/stitching/detail/matchers.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <map>
+#include <optional>
+#include <print>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "image_source.hpp"
+
+// Registration results of previous runs keyed by image content: features of every image, matches of every
+// pair and the bundle-adjusted camera of every image of the last solution. Everything is in work-copy
+// coordinates, so entries are only valid for the settings they were computed with, `settings` names them
+// and a cache written with other settings starts empty. Stored with cv::FileStorage (base64 payloads).
+class RegistrationCache {
+public:
+    struct Stats {
+        int features_computed{};
+        int features_reused{};
+        int pairs_matched{};
+        int pairs_reused{};
+        int cameras_reused{};
+        int cameras_initialized{};
+
+        void print() const {
+            std::println("Features: {} computed, {} cached | pairs: {} matched, {} cached | cameras: {} cached, {} from neighbours",
+                features_computed, features_reused, pairs_matched, pairs_reused, cameras_reused, cameras_initialized);
+        }
+    };
+
+    RegistrationCache(std::filesystem::path path, std::string settings)
+        : path_(std::move(path)), settings_(std::move(settings)) {
+        load();
+    }
+
+    const cv::detail::ImageFeatures* features(uint64_t hash) const {
+        auto it{ features_.find(hash) };
+        return it == features_.end() ? nullptr : &it->second;
+    }
+
+    // New features of an image (first time, or at another work size) invalidate its pairs and camera: their
+    // keypoint indices and focal lengths refer to the features they were computed from
+    void putFeatures(uint64_t hash, const cv::detail::ImageFeatures& features) {
+        features_[hash] = features;
+        std::erase_if(pairs_, [hash](const auto& e) { return e.first.first == hash or e.first.second == hash; });
+        cameras_.erase(hash);
+    }
+
+    // Matches from image `a` to image `b`, flipped if they were stored the other way around
+    std::optional<cv::detail::MatchesInfo> matches(uint64_t a, uint64_t b) const {
+        auto it{ pairs_.find(std::minmax(a, b)) };
+        if (it == pairs_.end()) {
+            return std::nullopt;
+        }
+        return a < b ? it->second : flipped(it->second);
+    }
+
+    void putMatches(uint64_t a, uint64_t b, const cv::detail::MatchesInfo& info) {
+        pairs_[std::minmax(a, b)] = a < b ? info : flipped(info);
+    }
+
+    const cv::detail::CameraParams* camera(uint64_t hash) const {
+        auto it{ cameras_.find(hash) };
+        return it == cameras_.end() ? nullptr : &it->second;
+    }
+
+    // Replaces the previous solution
+    void putCameras(const std::vector<uint64_t>& hashes, const std::vector<cv::detail::CameraParams>& cameras) {
+        cameras_.clear();
+        for (size_t i{ 0 }; i < hashes.size(); ++i) {
+            cameras_[hashes[i]] = cameras[i];
+        }
+    }
+
+    Stats& stats() { return stats_; }
+
+    void save() const {
+        cv::FileStorage fs{ path_.string(), cv::FileStorage::WRITE | cv::FileStorage::BASE64 };
+        fs << "settings" << settings_;
+
+        fs << "images" << "[";
+        for (const auto& [hash, f] : features_) {
+            fs << "{" << "hash" << toHex(hash) << "size" << f.img_size;
+            cv::write(fs, "keypoints", f.keypoints);
+            fs << "descriptors" << f.descriptors.getMat(cv::ACCESS_READ) << "}";
+        }
+        fs << "]";
+
+        fs << "pairs" << "[";
+        for (const auto& [key, m] : pairs_) {
+            fs << "{" << "a" << toHex(key.first) << "b" << toHex(key.second);
+            cv::write(fs, "matches", m.matches);
+            fs << "inliers" << cv::Mat(m.inliers_mask, true) << "num_inliers" << m.num_inliers
+                << "H" << m.H << "confidence" << m.confidence << "}";
+        }
+        fs << "]";
+
+        fs << "cameras" << "[";
+        for (const auto& [hash, c] : cameras_) {
+            fs << "{" << "hash" << toHex(hash) << "focal" << c.focal << "aspect" << c.aspect
+                << "ppx" << c.ppx << "ppy" << c.ppy << "R" << c.R << "t" << c.t << "}";
+        }
+        fs << "]";
+    }
+
+private:
+    std::filesystem::path path_;
+    std::string settings_;
+    std::map<uint64_t, cv::detail::ImageFeatures> features_;
+    std::map<std::pair<uint64_t, uint64_t>, cv::detail::MatchesInfo> pairs_;
+    std::map<uint64_t, cv::detail::CameraParams> cameras_;
+    Stats stats_;
+
+    static std::string toHex(uint64_t value) {
+        return std::format("{:016x}", value);
+    }
+
+    static uint64_t fromHex(const std::string& text) {
+        return std::stoull(text, nullptr, 16);
+    }
+
+    // The same pair seen from the other image, as cv::detail::FeaturesMatcher fills the dual entry
+    static cv::detail::MatchesInfo flipped(const cv::detail::MatchesInfo& info) {
+        cv::detail::MatchesInfo dual{ info };
+        std::swap(dual.src_img_idx, dual.dst_img_idx);
+        if (!info.H.empty()) {
+            dual.H = info.H.inv();
+        }
+        for (auto& m : dual.matches) {
+            std::swap(m.queryIdx, m.trainIdx);
+        }
+        return dual;
+    }
+
+    void load() {
+        if (!std::filesystem::exists(path_)) {
+            return;
+        }
+        cv::FileStorage fs{ path_.string(), cv::FileStorage::READ };
+        if (!fs.isOpened() or fs["settings"].string() != settings_) {
+            std::println("Registration cache {} is missing or was built with other settings, starting empty", path_.string());
+            return;
+        }
+
+        for (const auto& node : fs["images"]) {
+            cv::detail::ImageFeatures f;
+            node["size"] >> f.img_size;
+            cv::read(node["keypoints"], f.keypoints);
+            cv::Mat descriptors;
+            node["descriptors"] >> descriptors;
+            descriptors.copyTo(f.descriptors);
+            features_[fromHex(node["hash"].string())] = std::move(f);
+        }
+
+        for (const auto& node : fs["pairs"]) {
+            cv::detail::MatchesInfo m;
+            cv::read(node["matches"], m.matches);
+            cv::Mat inliers;
+            node["inliers"] >> inliers;
+            if (!inliers.empty()) {
+                m.inliers_mask.assign(inliers.begin<uchar>(), inliers.end<uchar>());
+            }
+            node["num_inliers"] >> m.num_inliers;
+            node["H"] >> m.H;
+            node["confidence"] >> m.confidence;
+            pairs_[{ fromHex(node["a"].string()), fromHex(node["b"].string()) }] = std::move(m);
+        }
+
+        for (const auto& node : fs["cameras"]) {
+            cv::detail::CameraParams c;
+            node["focal"] >> c.focal;
+            node["aspect"] >> c.aspect;
+            node["ppx"] >> c.ppx;
+            node["ppy"] >> c.ppy;
+            node["R"] >> c.R;
+            node["t"] >> c.t;
+            cameras_[fromHex(node["hash"].string())] = std::move(c);
+        }
+    }
+};
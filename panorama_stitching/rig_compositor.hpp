@@ -0,0 +1,177 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <opencv2/stitching/detail/blenders.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <format>
+#include <stdexcept>
+#include <vector>
+
+#include "image_source.hpp"
+#include "panorama_pipeline.hpp"
+#include "stage_timer.hpp"
+
+// Panorama of a fixed multi-camera rig. The geometry never changes, so registration, seams and exposure
+// gains are computed once from a calibration frame set, and everything compose needs is cached per camera:
+// fixed-point remap tables from the full-resolution frame straight into its panorama rectangle and a feather
+// weight map with the seam mask and the exposure gain folded in. Every synchronized frame set then costs one
+// remap per camera (in parallel across cameras) and a weighted sum (in parallel across panorama rows).
+//
+// Feather blending instead of the multi-band blender of PanoramaPipeline::compose: its weights are fixed per
+// pixel and can be cached, the pyramids of multi-band blending would have to be rebuilt for every frame.
+class RigCompositor {
+public:
+    // Registers `calibration` (one image per camera, in camera order) with `pipeline` and caches the maps.
+    // False when registration fails. Cameras left out of the registration are ignored in compose.
+    bool calibrate(PanoramaPipeline& pipeline, const std::vector<SourceImage>& calibration) {
+        cameras_.clear();
+        if (!pipeline.estimate(calibration)) {
+            return false;
+        }
+        auto layout{ pipeline.prepareComposition(calibration) };
+        if (!layout) {
+            return false;
+        }
+        const auto& indices{ pipeline.getIndices() };
+        const auto& params{ pipeline.getCameras() };
+        const auto gains{ pipeline.exposureGains() };
+        const size_t n{ indices.size() };
+
+        cameras_.resize(n);
+        std::vector<cv::UMat> masks(n);
+        std::vector<cv::Point> corners(n);
+        for (size_t i{ 0 }; i < n; ++i) {
+            auto& camera{ cameras_[i] };
+            camera.input = indices[i];
+            camera.frame_size = calibration[indices[i]].full_size;
+
+            cv::Mat xmap, ymap;
+            camera.roi = layout->warper->buildMaps(layout->input_sizes[i], layout->ks[i], params[i].R, xmap, ymap);
+            // The maps address the input at the compositing scale, sample the full-resolution frame instead
+            const double sx{ static_cast<double>(camera.frame_size.width) / layout->input_sizes[i].width };
+            const double sy{ static_cast<double>(camera.frame_size.height) / layout->input_sizes[i].height };
+            xmap.convertTo(xmap, CV_32F, sx, 0.5 * (sx - 1.0));
+            ymap.convertTo(ymap, CV_32F, sy, 0.5 * (sy - 1.0));
+
+            cv::Mat mask;
+            cv::remap(cv::Mat(camera.frame_size, CV_8U, cv::Scalar::all(255)), mask, xmap, ymap, cv::INTER_NEAREST,
+                cv::BORDER_CONSTANT);
+            cv::Mat dilated_seam, seam;
+            cv::dilate(layout->seam_masks[i], dilated_seam, cv::Mat{});
+            cv::resize(dilated_seam, seam, mask.size(), 0.0, 0.0, cv::INTER_LINEAR_EXACT);
+            mask &= seam;
+            mask.copyTo(masks[i]);
+            corners[i] = camera.roi.tl();
+
+            cv::convertMaps(xmap, ymap, camera.map1, camera.map2, CV_16SC2);
+            camera.warped.create(camera.roi.size(), CV_8UC3);
+        }
+
+        // Normalized over all cameras, so the weighted sum needs no division per frame
+        std::vector<cv::UMat> weights;
+        dst_roi_ = cv::detail::FeatherBlender{}.createWeightMaps(masks, corners, weights);
+        for (size_t i{ 0 }; i < n; ++i) {
+            auto& camera{ cameras_[i] };
+            weights[i].copyTo(camera.weight);
+            if (i < gains.size() and !gains[i].empty()) {
+                cv::Mat gain;
+                gains[i].convertTo(gain, CV_32F);
+                if (gain.channels() > 1) {
+                    // Per-channel gains are averaged, the cached weight is a single channel
+                    cv::transform(gain, gain, cv::Matx<float, 1, 3>(1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 3.0f));
+                }
+                cv::resize(gain, gain, camera.weight.size(), 0.0, 0.0, cv::INTER_LINEAR);
+                camera.weight = camera.weight.mul(gain);
+            }
+            camera.roi -= dst_roi_.tl();
+        }
+        result_.create(dst_roi_.size(), CV_8UC3);
+        return true;
+    }
+
+    // `frames[i]` comes from camera i, in the order of the calibration set, at the calibration resolution.
+    // The returned panorama is overwritten by the next call.
+    const cv::Mat& compose(const std::vector<cv::Mat>& frames) {
+        for (const auto& camera : cameras_) {
+            const cv::Mat& frame{ frames.at(camera.input) };
+            if (frame.size() != camera.frame_size or frame.type() != CV_8UC3) {
+                throw std::runtime_error(std::format("Camera {} frame is {}x{}, calibrated for {}x{} BGR", camera.input,
+                    frame.cols, frame.rows, camera.frame_size.width, camera.frame_size.height));
+            }
+        }
+        {
+            auto t{ timer_.measure("remap") };
+            cv::parallel_for_(cv::Range(0, static_cast<int>(cameras_.size())), [&](const cv::Range& range) {
+                for (int i{ range.start }; i < range.end; ++i) {
+                    auto& camera{ cameras_[i] };
+                    cv::remap(frames[camera.input], camera.warped, camera.map1, camera.map2, cv::INTER_LINEAR, cv::BORDER_REFLECT);
+                }
+            });
+        }
+
+        auto t{ timer_.measure("blend") };
+        cv::parallel_for_(cv::Range(0, result_.rows), [&](const cv::Range& range) {
+            std::vector<float> sum(static_cast<size_t>(result_.cols) * 3);
+            for (int y{ range.start }; y < range.end; ++y) {
+                std::ranges::fill(sum, 0.0f);
+                for (const auto& camera : cameras_) {
+                    if (y < camera.roi.y or y >= camera.roi.br().y) {
+                        continue;
+                    }
+                    const auto* pixel{ camera.warped.ptr<uchar>(y - camera.roi.y) };
+                    const auto* weight{ camera.weight.ptr<float>(y - camera.roi.y) };
+                    float* out{ sum.data() + 3 * camera.roi.x };
+                    for (int x{ 0 }; x < camera.roi.width; ++x) {
+                        out[3 * x] += weight[x] * pixel[3 * x];
+                        out[3 * x + 1] += weight[x] * pixel[3 * x + 1];
+                        out[3 * x + 2] += weight[x] * pixel[3 * x + 2];
+                    }
+                }
+                auto* row{ result_.ptr<uchar>(y) };
+                for (size_t k{ 0 }; k < sum.size(); ++k) {
+                    row[k] = cv::saturate_cast<uchar>(sum[k]);
+                }
+            }
+        });
+        return result_;
+    }
+
+    size_t cameraCount() const { return cameras_.size(); }
+    cv::Size size() const { return dst_roi_.size(); }
+    // Remap tables, weights and warp buffers held for all cameras
+    size_t cachedBytes() const {
+        size_t bytes{ 0 };
+        for (const auto& camera : cameras_) {
+            for (const cv::Mat* m : { &camera.map1, &camera.map2, &camera.weight, &camera.warped }) {
+                bytes += m->total() * m->elemSize();
+            }
+        }
+        return bytes;
+    }
+
+    const auto& getTimer() const { return timer_; }
+
+private:
+    struct Camera {
+        // Position in the calibration set
+        int input{};
+        cv::Size frame_size;
+        // Warped rectangle in panorama coordinates
+        cv::Rect roi;
+        cv::Mat map1, map2;
+        // Feather weight x exposure gain, 0 outside the seam mask
+        cv::Mat weight;
+        cv::Mat warped;
+    };
+
+    std::vector<Camera> cameras_;
+    cv::Rect dst_roi_;
+    cv::Mat result_;
+    playground::StageTimer timer_;
+};
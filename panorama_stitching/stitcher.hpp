@@ -0,0 +1,138 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/stitching.hpp>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <print>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "image_source.hpp"
+#include "panorama_pipeline.hpp"
+#include "tiled_compositor.hpp"
+
+class Stitcher {
+public:
+    // An empty `cache_path` registers everything from scratch on every stitch
+    Stitcher(const std::filesystem::path& path, const PanoramaSettings& settings = {},
+        std::filesystem::path cache_path = "panorama_cache.yml.gz")
+        : Stitcher(sequence(path, settings), settings, std::move(cache_path)) {}
+
+    Stitcher(const std::vector<std::filesystem::path>& files, const PanoramaSettings& settings,
+        std::filesystem::path cache_path)
+        : settings_(settings), cache_path_(std::move(cache_path)) {
+        images_ = loadForRegistration(files, settings_.registration_mp);
+
+        if (images_.size() < 2) {
+            throw std::runtime_error("Stitcher requires at least 2 images!\n");
+        }
+    }
+
+    void setMode(const cv::Stitcher::Mode& mode) {
+        settings_.mode = mode;
+        // Cached results depend on the mode
+        cache_.reset();
+    }
+
+    void setNewImages(const std::filesystem::path& path) {
+        if (!std::filesystem::exists(path) or !std::filesystem::is_directory(path)) {
+            std::cout << std::format("Invalid path: {}\n", path.string());
+            return;
+        }
+
+        auto temp{ loadForRegistration(sequence(path, settings_), settings_.registration_mp) };
+        if (temp.size() < 2) {
+            std::cerr << "Not enough images, Stitcher requires at least 2 images!\n";
+            return;
+        }
+        std::swap(temp, images_);
+    }
+
+    // Adds one image to the current set, at the work scale of the images already loaded
+    void addImage(const std::filesystem::path& file) {
+        auto loaded{ loadForRegistration({ file }, settings_.registration_mp, images_.front().work_scale) };
+        if (loaded.empty()) {
+            return;
+        }
+        images_.push_back(std::move(loaded.front()));
+    }
+
+    std::optional<cv::Mat> createStitcher() {
+        if (!registerImages()) {
+            return std::nullopt;
+        }
+        auto pano{ pipeline_->compose(images_) };
+        if (verbose_) {
+            pipeline_->getProfile().print();
+        }
+        return pano;
+    }
+
+    // Same registration, but the panorama is rendered tile by tile within `memory_budget` bytes and streamed to
+    // `output`.dzi instead of being returned. Returns its size.
+    std::optional<cv::Size> createTiledPanorama(const std::filesystem::path& output, size_t memory_budget) {
+        if (!registerImages()) {
+            return std::nullopt;
+        }
+        TiledCompositor compositor{ memory_budget };
+        auto size{ compositor.compose(*pipeline_, images_, output) };
+        pipeline_->getProfile().print();
+        compositor.getTimer().print();
+        return size;
+    }
+
+    const auto& getImages() const { return images_; }
+    // Registration time, cache statistics and the stage profile are printed after every stitch unless disabled
+    void setVerbose(bool verbose) { verbose_ = verbose; }
+
+    // Image files of `dir` in the order the pipeline treats as the sequence
+    static std::vector<std::filesystem::path> sequence(const std::filesystem::path& dir, const PanoramaSettings& settings) {
+        auto files{ listImages(dir) };
+        if (settings.capture_time_order) {
+            sortByCaptureTime(files);
+        }
+        return files;
+    }
+
+private:
+    // Registration copies, full resolution is decoded again for compositing
+    std::vector<SourceImage> images_;
+    PanoramaSettings settings_;
+    std::unique_ptr<PanoramaPipeline> pipeline_;
+    // Features, matches and cameras by image content, shared by every stitch of this object and across runs
+    std::filesystem::path cache_path_;
+    std::unique_ptr<RegistrationCache> cache_;
+    bool verbose_{ true };
+
+    bool registerImages() {
+        if (!cache_ and !cache_path_.empty()) {
+            cache_ = std::make_unique<RegistrationCache>(cache_path_, settings_.signature());
+        }
+        pipeline_ = std::make_unique<PanoramaPipeline>(settings_);
+        pipeline_->setCache(cache_.get());
+
+        auto start{ std::chrono::steady_clock::now() };
+        const bool registered{ pipeline_->estimate(images_) };
+        if (verbose_) {
+            std::println("Registration of {} images: {:.2f} ms",
+                images_.size(), std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        if (cache_ and verbose_) {
+            cache_->stats().print();
+        }
+        if (!registered) {
+            std::cerr << "Can't stitch images!\n";
+        }
+        return registered;
+    }
+};
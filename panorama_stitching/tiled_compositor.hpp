@@ -0,0 +1,442 @@
+//
+// Created by Michał Maj on 18/10/2026.
+//
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <opencv2/stitching/detail/blenders.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "image_source.hpp"
+#include "panorama_pipeline.hpp"
+#include "stage_timer.hpp"
+
+// Full-resolution inputs shared by the tile workers. Decoded on first use and kept while they fit in
+// `capacity` bytes, least recently used unpinned images are dropped first. An image is pinned from get()
+// until its Pin goes away, a worker needing room that only pinned images hold waits for them to be released.
+// An image being decoded by one worker is waited for by the others instead of being decoded twice.
+class SourceCache {
+public:
+    // Keeps one decoded image in the cache while it's used
+    class Pin {
+    public:
+        Pin(Pin&& other) noexcept : cache_(std::exchange(other.cache_, nullptr)), index_(other.index_), image_(other.image_) {}
+        Pin& operator=(Pin&&) = delete;
+
+        ~Pin() {
+            if (cache_) {
+                cache_->release(index_);
+            }
+        }
+
+        const cv::Mat& operator*() const { return *image_; }
+        const cv::Mat* operator->() const { return image_; }
+
+    private:
+        friend class SourceCache;
+        Pin(SourceCache& cache, int index) : cache_(&cache), index_(index) {}
+
+        SourceCache* cache_{};
+        int index_{};
+        const cv::Mat* image_{};
+    };
+
+    SourceCache(const std::vector<SourceImage>& images, size_t capacity) : images_(images), capacity_(capacity) {}
+
+    Pin get(int index) {
+        std::shared_future<cv::Mat> image;
+        std::promise<cv::Mat> decode;
+        bool owner{ false };
+        {
+            std::unique_lock lock{ mutex_ };
+            const size_t bytes{ static_cast<size_t>(images_[index].full_size.area()) * 3 };
+            // An image larger than the whole cache is decoded once nothing else is left in it
+            room_.wait(lock, [&] { return entries_.contains(index) or makeRoom(bytes) or entries_.empty(); });
+            auto it{ entries_.find(index) };
+            if (it == entries_.end()) {
+                it = entries_.emplace(index, Entry{ decode.get_future().share(), bytes }).first;
+                bytes_ += bytes;
+                ++decodes_;
+                owner = true;
+            }
+            ++it->second.pins;
+            it->second.last_use = ++clock_;
+            image = it->second.image;
+        }
+        Pin pin{ *this, index };
+        if (owner) {
+            try {
+                decode.set_value(images_[index].loadFull());
+            }
+            catch (...) {
+                decode.set_exception(std::current_exception());
+            }
+        }
+        // A pinned entry isn't erased, so its image stays where it is
+        pin.image_ = &image.get();
+        return pin;
+    }
+
+    size_t decodes() const { return decodes_; }
+
+private:
+    struct Entry {
+        std::shared_future<cv::Mat> image;
+        size_t bytes{};
+        uint64_t last_use{};
+        // Holders of a Pin, the decoding worker included
+        int pins{};
+    };
+
+    const std::vector<SourceImage>& images_;
+    size_t capacity_{};
+    std::mutex mutex_;
+    std::condition_variable room_;
+    std::map<int, Entry> entries_;
+    size_t bytes_{ 0 };
+    uint64_t clock_{ 0 };
+    std::atomic<size_t> decodes_{ 0 };
+
+    void release(int index) {
+        std::lock_guard lock{ mutex_ };
+        if (--entries_.at(index).pins == 0) {
+            room_.notify_all();
+        }
+    }
+
+    // Drops unpinned images until `bytes` more fit, false if the pinned ones leave no room. Called with the lock held.
+    bool makeRoom(size_t bytes) {
+        while (bytes_ + bytes > capacity_) {
+            auto victim{ entries_.end() };
+            for (auto it{ entries_.begin() }; it != entries_.end(); ++it) {
+                if (it->second.pins == 0 and (victim == entries_.end() or it->second.last_use < victim->second.last_use)) {
+                    victim = it;
+                }
+            }
+            if (victim == entries_.end()) {
+                return false;
+            }
+            bytes_ -= victim->second.bytes;
+            entries_.erase(victim);
+        }
+        return true;
+    }
+};
+
+// Out-of-core compositing for panoramas that don't fit in memory. The output is rendered in square tiles,
+// each one multi-band blended on its own from only the inputs that overlap it (plus a margin, so tile
+// edges don't show), warped straight from the full-resolution images through a coarse grid of backward
+// mapped points. Finished tiles are streamed to a Deep Zoom image (`<output>.dzi` and `<output>_files/`),
+// whose coarser levels are then built from the tiles on disk, so no stage ever holds the whole panorama.
+//
+// `memory_budget` covers the tile workers and the decoded inputs they share: as many workers run (up to the
+// number of threads) as fit together with one decoded input each, the rest of the budget caches inputs.
+class TiledCompositor {
+public:
+    explicit TiledCompositor(size_t memory_budget = size_t{ 512 } << 20,
+        int tile_size = 1024,
+        int margin = 64,
+        std::string format = "jpg"
+    ) :
+        memory_budget_(memory_budget),
+        tile_size_(tile_size),
+        margin_(margin),
+        format_(std::move(format)) {}
+
+    // Panorama of the images registered by `pipeline`, written as `output`.dzi. Returns the panorama size.
+    std::optional<cv::Size> compose(PanoramaPipeline& pipeline, const std::vector<SourceImage>& images,
+        const std::filesystem::path& output) {
+        auto layout{ pipeline.prepareComposition(images) };
+        if (!layout) {
+            return std::nullopt;
+        }
+        const auto& indices{ pipeline.getIndices() };
+        const auto& cameras{ pipeline.getCameras() };
+        const auto gains{ pipeline.exposureGains() };
+
+        std::vector<Input> inputs(indices.size());
+        cv::Rect panorama;
+        size_t largest{ 0 };
+        for (size_t i{ 0 }; i < inputs.size(); ++i) {
+            auto& input{ inputs[i] };
+            input.index = indices[i];
+            input.k = layout->ks[i];
+            input.r = cameras[i].R;
+            input.roi = cv::Rect{ layout->corners[i], layout->sizes[i] };
+            const cv::Size full{ images[input.index].full_size };
+            input.scale = { static_cast<double>(full.width) / layout->input_sizes[i].width,
+                static_cast<double>(full.height) / layout->input_sizes[i].height };
+            input.full_size = full;
+            cv::dilate(layout->seam_masks[i], input.seam, cv::Mat{});
+            if (i < gains.size() and !gains[i].empty()) {
+                gains[i].convertTo(input.gain, CV_32F);
+            }
+            panorama = i == 0 ? input.roi : (panorama | input.roi);
+            largest = std::max(largest, static_cast<size_t>(full.area()) * 3);
+        }
+
+        const int extended{ tile_size_ + 2 * margin_ };
+        // Warp maps, masks, 32F and 16S copies of one input plus the blender pyramids, about 64 bytes a pixel
+        const size_t tile_bytes{ static_cast<size_t>(extended) * extended * 64 };
+        const int workers{ std::clamp(static_cast<int>(memory_budget_ / (tile_bytes + largest)), 1,
+            static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))) };
+        const size_t cache_capacity{ memory_budget_ > workers * tile_bytes ? memory_budget_ - workers * tile_bytes : 0 };
+        if (memory_budget_ < tile_bytes + largest) {
+            std::println("Memory budget {} MB is below one tile worker with one input ({} MB)",
+                memory_budget_ >> 20, (tile_bytes + largest) >> 20);
+        }
+
+        const auto files{ std::filesystem::path{ output }.concat("_files") };
+        std::filesystem::remove_all(files);
+        const int max_level{ static_cast<int>(std::ceil(std::log2(std::max(panorama.width, panorama.height)))) };
+        std::filesystem::create_directories(files / std::to_string(max_level));
+
+        SourceCache cache{ images, cache_capacity };
+        const int cols{ (panorama.width + tile_size_ - 1) / tile_size_ };
+        const int rows{ (panorama.height + tile_size_ - 1) / tile_size_ };
+        {
+            auto t{ timer_.measure("tiles") };
+            // Row-major order, so neighbouring workers share the decoded inputs
+            std::atomic<int> next{ 0 };
+            std::exception_ptr failure;
+            std::mutex failure_mutex;
+            {
+                std::vector<std::jthread> threads;
+                for (int w{ 0 }; w < workers; ++w) {
+                    threads.emplace_back([&] {
+                        try {
+                            for (int tile{ next++ }; tile < cols * rows; tile = next++) {
+                                const cv::Rect rect{ panorama.x + tile % cols * tile_size_, panorama.y + tile / cols * tile_size_,
+                                    std::min(tile_size_, panorama.br().x - (panorama.x + tile % cols * tile_size_)),
+                                    std::min(tile_size_, panorama.br().y - (panorama.y + tile / cols * tile_size_)) };
+                                if (!writeTile(files, max_level, tile % cols, tile / cols, renderTile(rect, inputs, cache, *layout->warper))) {
+                                    throw std::runtime_error(std::format("Can't write tiles to: {}", files.string()));
+                                }
+                            }
+                        }
+                        catch (...) {
+                            std::lock_guard lock{ failure_mutex };
+                            failure = failure ? failure : std::current_exception();
+                            next = cols * rows;
+                        }
+                    });
+                }
+            }
+            if (failure) {
+                std::rethrow_exception(failure);
+            }
+        }
+        {
+            auto t{ timer_.measure("pyramid") };
+            buildPyramid(files, max_level, panorama.size());
+        }
+
+        std::ofstream{ std::filesystem::path{ output }.concat(".dzi") } << std::format(
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" Format=\"{}\" Overlap=\"0\" TileSize=\"{}\">\n"
+            "  <Size Width=\"{}\" Height=\"{}\"/>\n"
+            "</Image>\n", format_, tile_size_, panorama.width, panorama.height);
+
+        std::println("{}x{} panorama in {} tiles ({} levels), {} workers, input cache {} MB, {} decodes of {} inputs",
+            panorama.width, panorama.height, cols * rows, max_level + 1, workers, cache_capacity >> 20,
+            cache.decodes(), inputs.size());
+        return panorama.size();
+    }
+
+    const auto& getTimer() const { return timer_; }
+
+private:
+    // Configuration variables
+    size_t memory_budget_{};
+    int tile_size_{};
+    int margin_{};
+    std::string format_;
+    // Spacing of the backward mapped points, interpolated in between
+    static constexpr int grid_step_{ 16 };
+
+    playground::StageTimer timer_;
+    // RotationWarper::warpPointBackward sets the camera on the shared warper for every point
+    std::mutex warper_mutex_;
+
+    struct Input {
+        int index{};
+        cv::Mat k, r;
+        // Warped rectangle in panorama coordinates
+        cv::Rect roi;
+        // Full resolution / compositing resolution
+        cv::Point2d scale;
+        cv::Size full_size;
+        // Dilated seam mask at the seam resolution and exposure gains, both stretched over `roi`
+        cv::Mat seam;
+        cv::Mat gain;
+    };
+
+    cv::Mat renderTile(const cv::Rect& rect, const std::vector<Input>& inputs, SourceCache& cache,
+        cv::detail::RotationWarper& warper) {
+        const cv::Rect extended{ rect.x - margin_, rect.y - margin_, rect.width + 2 * margin_, rect.height + 2 * margin_ };
+        cv::detail::MultiBandBlender blender{ false };
+        bool prepared{ false };
+        for (const auto& input : inputs) {
+            const cv::Rect region{ extended & input.roi };
+            if (region.empty()) {
+                continue;
+            }
+            if (!prepared) {
+                blender.prepare(extended);
+                prepared = true;
+            }
+
+            cv::Mat xmap, ymap, mask;
+            backwardMaps(warper, input, region, xmap, ymap, mask);
+            cv::Mat warped;
+            {
+                // Held only while this input is warped, so a worker pins one decoded image at a time
+                const auto source{ cache.get(input.index) };
+                cv::remap(*source, warped, xmap, ymap, cv::INTER_LINEAR, cv::BORDER_REFLECT);
+            }
+            mask &= stretch(input.seam, input.roi, region, cv::BORDER_CONSTANT);
+
+            cv::Mat warped_s;
+            if (!input.gain.empty()) {
+                cv::Mat gain{ stretch(input.gain, input.roi, region, cv::BORDER_REPLICATE) };
+                if (gain.channels() == 1) {
+                    cv::merge(std::vector<cv::Mat>(3, gain), gain);
+                }
+                warped.convertTo(warped, CV_32F);
+                cv::multiply(warped, gain, warped);
+            }
+            warped.convertTo(warped_s, CV_16S);
+            blender.feed(warped_s, mask, region.tl());
+        }
+
+        cv::Mat tile(rect.size(), CV_8UC3, cv::Scalar::all(0));
+        if (prepared) {
+            cv::Mat result, result_mask;
+            blender.blend(result, result_mask);
+            result(cv::Rect{ rect.x - extended.x, rect.y - extended.y, rect.width, rect.height }).convertTo(tile, CV_8U);
+        }
+        return tile;
+    }
+
+    // Full-resolution source coordinates of every pixel of `region`, bilinear between points mapped back
+    // through the warper every `grid_step_` pixels. `mask` marks pixels that land inside the source.
+    void backwardMaps(cv::detail::RotationWarper& warper, const Input& input, const cv::Rect& region,
+        cv::Mat& xmap, cv::Mat& ymap, cv::Mat& mask) {
+        const int gw{ (region.width - 1) / grid_step_ + 2 };
+        const int gh{ (region.height - 1) / grid_step_ + 2 };
+        cv::Mat_<cv::Point2f> grid(gh, gw);
+        std::unique_lock lock{ warper_mutex_ };
+        for (int gy{ 0 }; gy < gh; ++gy) {
+            for (int gx{ 0 }; gx < gw; ++gx) {
+                const cv::Point2f p{ warper.warpPointBackward(
+                    cv::Point2f(static_cast<float>(region.x + gx * grid_step_), static_cast<float>(region.y + gy * grid_step_)),
+                    input.k, input.r) };
+                // Compositing resolution to full resolution, pixel centers aligned
+                grid(gy, gx) = { static_cast<float>((p.x + 0.5) * input.scale.x - 0.5),
+                    static_cast<float>((p.y + 0.5) * input.scale.y - 0.5) };
+            }
+        }
+        lock.unlock();
+
+        xmap.create(region.size(), CV_32F);
+        ymap.create(region.size(), CV_32F);
+        mask.create(region.size(), CV_8U);
+        const float w_max{ input.full_size.width - 0.5f }, h_max{ input.full_size.height - 0.5f };
+        for (int y{ 0 }; y < region.height; ++y) {
+            const int gy{ y / grid_step_ };
+            const float fy{ static_cast<float>(y % grid_step_) / grid_step_ };
+            auto* xs{ xmap.ptr<float>(y) };
+            auto* ys{ ymap.ptr<float>(y) };
+            auto* m{ mask.ptr<uchar>(y) };
+            for (int x{ 0 }; x < region.width; ++x) {
+                const int gx{ x / grid_step_ };
+                const float fx{ static_cast<float>(x % grid_step_) / grid_step_ };
+                const cv::Point2f top{ grid(gy, gx) * (1.0f - fx) + grid(gy, gx + 1) * fx };
+                const cv::Point2f bottom{ grid(gy + 1, gx) * (1.0f - fx) + grid(gy + 1, gx + 1) * fx };
+                const cv::Point2f p{ top * (1.0f - fy) + bottom * fy };
+                xs[x] = p.x;
+                ys[x] = p.y;
+                m[x] = p.x >= -0.5f and p.x < w_max and p.y >= -0.5f and p.y < h_max ? 255 : 0;
+            }
+        }
+    }
+
+    // The part `region` of `map` resized over `roi`, as cv::resize would (pixel centers aligned)
+    static cv::Mat stretch(const cv::Mat& map, const cv::Rect& roi, const cv::Rect& region, int border) {
+        const double sx{ static_cast<double>(map.cols) / roi.width };
+        const double sy{ static_cast<double>(map.rows) / roi.height };
+        const cv::Matx23d to_map{ sx, 0.0, sx * (region.x - roi.x + 0.5) - 0.5, 0.0, sy, sy * (region.y - roi.y + 0.5) - 0.5 };
+        cv::Mat stretched;
+        cv::warpAffine(map, stretched, to_map, region.size(), cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, border);
+        return stretched;
+    }
+
+    std::filesystem::path tilePath(const std::filesystem::path& files, int level, int col, int row) const {
+        return files / std::to_string(level) / std::format("{}_{}.{}", col, row, format_);
+    }
+
+    bool writeTile(const std::filesystem::path& files, int level, int col, int row, const cv::Mat& tile) const {
+        return cv::imwrite(tilePath(files, level, col, row).string(), tile, { cv::IMWRITE_JPEG_QUALITY, 90 });
+    }
+
+    // Every level halves the one above, each tile from the (up to) four tiles it covers there, down to 1x1
+    void buildPyramid(const std::filesystem::path& files, int max_level, cv::Size size) const {
+        std::atomic<bool> written{ true };
+        for (int level{ max_level - 1 }; level >= 0; --level) {
+            const cv::Size upper{ size };
+            size = { (size.width + 1) / 2, (size.height + 1) / 2 };
+            std::filesystem::create_directories(files / std::to_string(level));
+            const int cols{ (size.width + tile_size_ - 1) / tile_size_ };
+            const int rows{ (size.height + tile_size_ - 1) / tile_size_ };
+            cv::parallel_for_(cv::Range(0, cols * rows), [&](const cv::Range& range) {
+                for (int tile{ range.start }; tile < range.end; ++tile) {
+                    const int col{ tile % cols }, row{ tile / cols };
+                    const cv::Rect area{ 2 * col * tile_size_, 2 * row * tile_size_,
+                        std::min(2 * tile_size_, upper.width - 2 * col * tile_size_),
+                        std::min(2 * tile_size_, upper.height - 2 * row * tile_size_) };
+                    cv::Mat canvas(area.size(), CV_8UC3, cv::Scalar::all(0));
+                    for (int dy{ 0 }; dy < 2; ++dy) {
+                        for (int dx{ 0 }; dx < 2; ++dx) {
+                            const cv::Point at{ dx * tile_size_, dy * tile_size_ };
+                            if (at.x >= area.width or at.y >= area.height) {
+                                continue;
+                            }
+                            const cv::Mat child{ cv::imread(tilePath(files, level + 1, 2 * col + dx, 2 * row + dy).string()) };
+                            child.copyTo(canvas(cv::Rect{ at, child.size() } & cv::Rect{ {}, area.size() }));
+                        }
+                    }
+                    cv::Mat tile_img;
+                    cv::resize(canvas, tile_img, { std::min(tile_size_, size.width - col * tile_size_),
+                        std::min(tile_size_, size.height - row * tile_size_) }, 0.0, 0.0, cv::INTER_AREA);
+                    written = writeTile(files, level, col, row, tile_img) and written;
+                }
+            });
+        }
+        if (!written) {
+            throw std::runtime_error(std::format("Can't write tiles to: {}", files.string()));
+        }
+    }
+};